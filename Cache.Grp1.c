@@ -5,6 +5,18 @@
 #include <stdbool.h>
 #include <stdint.h>
 #include <limits.h>
+#include <getopt.h>
+#include <signal.h>
+#include <time.h>
+#include <sys/stat.h>
+
+#include "cachesim.h"
+#include "interval.h"
+#include "perf.h"
+#include "trace_index.h"
+#include "results.h"
+#include "import.h"
+#include "follow.h"
 
 /********************************* CLI INPUTS **********************************
  * 
@@ -19,6 +31,110 @@
  * b2:              line size in bytes                EX: 64 (64 Byte lines)
  * victim_size2:    size victim cache (0 is none)     EX: 1024 (1kB)
  * 
+ * options (may appear anywhere on the command line):
+ * --perf[=period]  bracket the block read, decode, address decomposition,
+ *                  lookup and replacement phases with host performance
+ *                  counters, sampling every period-th access (default 1);
+ *                  block reads are always bracketed and averaged per record
+ * --interval=N     snapshot per-level stat deltas every N accesses
+ * --interval-out=F file for interval snapshots (default intervals.bin),
+ *                  convert with interval_export
+ * --hotspots[=K]   profile misses per set and per line/page address and
+ *                  report the hottest of each per level (default K 16)
+ * --threads=T      split the sets of each level across T threads; results
+ *                  are identical to the serial run
+ * --pipeline       run each level on its own thread, fed by the miss
+ *                  stream of the level above
+ * --slices=K       cut the trace into K slices simulated in parallel, each
+ *                  warmed on the records before it
+ * --warmup=W       warmup records per slice (default 100000)
+ * --exact          re-simulate slice boundaries until the result is exact
+ * --reference      also run serially and report the error of the slices
+ * --timing         also time every access and report AMAT, stall cycles
+ *                  and memory-level parallelism; implied by the options
+ *                  below, whose per-level lists are L1,L2
+ * --hit-latency=H  cycles to return data from each level (default 4,12)
+ * --miss-penalty=P cycles each level adds to a miss (default hit latency)
+ * --mshrs=M        outstanding misses per level (default 8,16)
+ * --memory-latency=N  cycles to memory (default 200)
+ * --window=W       reads in flight before issue stalls (default 64, 0 none)
+ * --issue-interval=I  cycles between accesses (default 1)
+ * --l1-stream[=D]  replay the L1 miss stream recorded for this trace, L1
+ *                  configuration and access count from directory D
+ *                  (default streams), or record it if there is none; a
+ *                  replay only simulates L2
+ * --skip=N         start at record N instead of the beginning of the trace
+ * --range=A:B[,C:D...]  simulate records [A,B), [C,D), ... instead of a
+ *                  prefix and report each range and their sum; accesses
+ *                  is ignored
+ * --build-index[=N]  simulate normally and write a block index with a
+ *                  checkpoint of the hierarchy every N records (default
+ *                  1000000); ranges then start from the checkpoint below
+ *                  them, warm and exact, instead of cold
+ * --index=F        block index file (default the trace path + .idx)
+ * --results[=D]    look the run up in the result store in directory D
+ *                  (default results) and print the stored statistics
+ *                  instead of simulating; store the result otherwise
+ * --results-max=KB size bound of the result store (default 65536)
+ * --memory         report the memory the cache model occupies
+ * --index-fn=F1,F2 set index function of each level: bits (default), mod
+ *                  for set counts that are not a power of two, xor for
+ *                  XOR-folded hashing or skew for skewed associativity
+ * --tenants=B2[,B3...]  interleave these benchmarks with the first one,
+ *                  each as its own class of service (the first is class 0)
+ *                  with the class in the top address bits so tenants never
+ *                  share lines; accesses counts the records of all tenants
+ * --quantum=Q      records a tenant runs before the next one (default 64)
+ * --partition=M0[,M1...]  L2 way mask of each class (hex or decimal,
+ *                  default all ways); prints per-class statistics
+ * --umon[=N]       repartition the L2 ways among the classes every N
+ *                  accesses (default 1000000) by the hits utility
+ *                  monitors predict for each
+ * --format=F       benchmark is the path of a trace in format F instead
+ *                  of a name under CacheonlyTraces: din (Dinero), lackey
+ *                  (valgrind lackey), champsim (uncompressed ChampSim),
+ *                  hex (address and r/w per line) or native; - is stdin
+ * --ifetch         keep the instruction fetches of an imported trace as
+ *                  reads
+ * --follow[=MS]    follow a trace that is still being written: simulate
+ *                  records as they are appended and print the statistics
+ *                  at most every MS milliseconds (default 1000) while new
+ *                  ones arrive; accesses 0 follows without a limit. Ends
+ *                  on ctrl-c, when the trace is removed or after
+ * --follow-idle=S  seconds without new records (default never)
+ * --events[=F]     log every miss to F (default events.bin) from a
+ *                  background writer; decode it with event_dump
+ * --event-levels=L1[,L2]  levels to log, 1 is L1 (default all)
+ * --event-types=T[,T...]  fill (replaced an invalid line), evict (a clean
+ *                  one) and/or writeback (a dirty one; default all)
+ * --dram[=P]       model DRAM behind L2: every L2 miss reads its line and
+ *                  every eviction of an L2 line that was written writes
+ *                  one back, through an FR-FCFS controller with open
+ *                  (default) or closed page policy P; prints row
+ *                  buffer, bank conflict, bandwidth and miss latency
+ *                  statistics
+ * --dram-mapping=M page (default, consecutive lines share a row), line
+ *                  (consecutive lines go to different channels and banks)
+ *                  or xor (page with the bank XORed with the row)
+ * --dram-geometry=C,R,B,ROW  channels, ranks per channel, banks per rank
+ *                  and row buffer bytes (default 1,1,8,8192)
+ * --dram-timing=CL,RCD,RP,BURST  DRAM cycles of a column access, row
+ *                  activation, precharge and line transfer (default
+ *                  14,14,14,4)
+ * --dram-queue=N   requests queued per channel (default 32)
+ * --dram-interval=N  DRAM cycles between trace accesses (default 4)
+ * --deadblock=P    predict dead blocks at L2 from the address region and
+ *                  kind of each miss and place fills by policy P: mru
+ *                  (the plain cache, only watching), lru, bip (one fill
+ *                  in 32 at MRU), predict (predicted-dead fills at LRU)
+ *                  or bypass (predicted-dead misses not filled); prints
+ *                  prediction accuracy and the L2 miss rate against a
+ *                  plain L2 run alongside
+ * --deadblock-region=N  signature address regions of 2^N bytes (default 12)
+ * --opt            also simulate Belady's optimal replacement on the same
+ *                  accesses, read into memory, and print its misses as
+ *                  the bound for the LRU results
+ * 
  * *****************************************************************************
 */
 
@@ -39,402 +155,951 @@
  * *****************************************************************************
 */
 
-#define ADDRESS_LEN 32
+// trace records read per fread
+#define TRACE_BLOCK 4096
+// larger blocks amortize the per-block synchronization of the threaded modes
+#define PARALLEL_BLOCK 65536
+// most ranges --range accepts
+#define MAX_RANGES 64
+
+typedef struct
+{
+    uint64_t begin;
+    uint64_t end;
+}trace_range;
 
+void collect_interval(ssize_t[INTERVAL_LEVELS][INTERVAL_FIELDS],const cachesim*);
+void report_hotspots(const cachesim*,unsigned);
+void run_time_sliced(cachesim*,FILE*,size_t,const cachesim_slice_config*,int);
+void parse_levels(const char*,unsigned[CACHESIM_MAX_LEVELS]);
+void parse_index_fns(const char*,cachesim_index_fn[CACHESIM_MAX_LEVELS]);
+void parse_masks(const char*,cachesim_partition_config*);
+unsigned parse_event_levels(const char*);
+unsigned parse_event_types(const char*);
+void report_timing(const cachesim_timing*);
+void report_dram(cachesim*);
+void report_deadblock(const cachesim*,const cachesim*,cachesim_insert_policy);
+void report_classes(const cachesim*,char**);
+cachesim_filter* open_l1_stream(cachesim*,const char*,const char*,const char*,unsigned,size_t*);
+unsigned parse_ranges(const char*,trace_range*);
+size_t run_ranges(cachesim*,FILE*,const char*,const char*,const trace_range*,unsigned,cache_stats[2]);
+size_t run_tenants(cachesim*,FILE**,unsigned,size_t,unsigned);
+void publish_stats(const cachesim*);
+void run_follow(cachesim*,const char*,size_t,unsigned,unsigned);
+int run_opt(const cachesim_config*,const char*,size_t,cache_stats[2]);
 
-//counter for LRU 
-ssize_t total_cache_accesses = 0;
-//struct to keep track of total accesses and misses within the cache
+//set by ctrl-c while following a trace
+static volatile sig_atomic_t follow_stop;
 
-// to differentiate the sort of cache that isnt associative
-typedef enum 
+void printResults(int cacheLevel, int hits, int victimHits, int cold, int capacity, int conflict) 
 {
-    direct_mapped = 1,
-    fully_associative,
-    associative
-}cache_type;
+    printf("L%u Cache Stats:\t%x\t%x\t%x\t%x\t%x\n", cacheLevel, hits, victimHits, cold, capacity, conflict);
+    printf("\n");
+}
 
-typedef struct
+char* concat(const char *size1, const char *size2)
 {
-    ssize_t total_accesses;
-    ssize_t hits;
-    ssize_t total_misses;
-    ssize_t cold_misses;
-    ssize_t capacity_misses;
-    ssize_t conflict_misses;
-}cache_stats;
+    char *result = malloc(strlen(size1) + strlen(size2) + 1);
+    strcpy(result, size1);
+    strcat(result, size2);
+    return result;
+}
 
-typedef struct
+/*
+ * copy the running counters of each level into the layout interval.c records
+ */
+void
+collect_interval(ssize_t now[INTERVAL_LEVELS][INTERVAL_FIELDS],const cachesim* sim)
+{
+    for(int l = 0;l < INTERVAL_LEVELS;++l)
+    {
+        cache_stats stats;
+        cachesim_get_stats(sim,l,&stats);
+        now[l][INTERVAL_HITS] = stats.hits;
+        now[l][INTERVAL_MISSES] = stats.total_misses;
+        now[l][INTERVAL_COLD] = stats.cold_misses;
+        now[l][INTERVAL_CAPACITY] = stats.capacity_misses;
+        now[l][INTERVAL_CONFLICT] = stats.conflict_misses;
+    }
+}
+
+/*
+ * print the hottest sets, lines and pages of each level with their share
+ * of that level's misses; line and page counts are sketch estimates
+ */
+void
+report_hotspots(const cachesim* sim,unsigned k)
 {
-    //direct-mapped and fully associative will always have 0 tag
-    unsigned tag;
-    unsigned valid: 1;
-    unsigned dirty: 1;
-    ssize_t last_used_time;
-}cache_line;
+    static const char* kinds[] = {"set", "line", "page"};
+    cachesim_hotspot* hot = malloc(k*sizeof(cachesim_hotspot));
+    if(!hot) { printf("Unable to allocate hotspot report\n"); exit(0); }
+    for(unsigned l = 0;l < cachesim_levels(sim);++l)
+    {
+        cache_stats stats;
+        cachesim_get_stats(sim,l,&stats);
+        printf("L%u miss hotspots (%zd misses):\n",l+1,stats.total_misses);
+        for(int kind = CACHESIM_HOT_SETS;kind <= CACHESIM_HOT_PAGES;++kind)
+        {
+            size_t found = cachesim_hotspots(sim,l,kind,hot,k);
+            for(size_t i = 0;i < found;++i)
+                printf("  %-4s %#10llx\t%llu\t%5.2f%%\n",kinds[kind],(unsigned long long)hot[i].key,
+                        (unsigned long long)hot[i].count,stats.total_misses ? 100.0*hot[i].count/stats.total_misses : 0.0);
+        }
+    }
+    printf("\n");
+    free(hot);
+}
 
 /*
- * structure for direct mapped and fully associative
-*/
+ * load the trace range, simulate it in parallel time slices and report how
+ * the slices went; with reference, rerun serially and print the error
+ */
+void
+run_time_sliced(cachesim* sim,FILE* fin,size_t accesses,const cachesim_slice_config* config,int reference)
+{
+    unsigned char* records = malloc(accesses*CACHESIM_RECORD_SIZE + 1);
+    if(!records)
+    {
+        printf("Unable to allocate trace buffer\n");
+        exit(0);
+    }
+    size_t n = fread(records,CACHESIM_RECORD_SIZE,accesses,fin);
+
+    cachesim_slice_report report;
+    if(cachesim_run_sliced(sim,records,n,config,&report))
+    {
+        printf("Unable to allocate time slices\n");
+        exit(0);
+    }
+    printf("time slices: %u, warmup %zu, %u round(s), %zu records simulated (%.2fx), %s\n",config->slices,
+            config->warmup,report.rounds,report.simulated,n ? (double)report.simulated/n : 0.0,
+            report.exact ? "exact" : "approximate");
+
+    if(reference)
+    {
+        cachesim_config serial_config;
+        cachesim_get_config(sim,&serial_config);
+        cachesim* serial = cachesim_create(&serial_config);
+        cachesim_run_trace(serial,records,n);
+        for(unsigned l = 0;l < serial_config.n_levels;++l)
+        {
+            cache_stats sliced, exact;
+            cachesim_get_stats(sim,l,&sliced);
+            cachesim_get_stats(serial,l,&exact);
+            printf("L%u vs serial: hits %+zd (%+.4f%%)\tmisses %+zd (%+.4f%%)\n",l+1,sliced.hits - exact.hits,
+                    exact.hits ? 100.0*(sliced.hits - exact.hits)/exact.hits : 0.0,sliced.total_misses - exact.total_misses,
+                    exact.total_misses ? 100.0*(sliced.total_misses - exact.total_misses)/exact.total_misses : 0.0);
+        }
+        cachesim_destroy(serial);
+    }
+    free(records);
+}
 
-typedef struct cache_t cache_t;
+/*
+ * comma separated per-level values, L1 first; levels not listed keep theirs
+ */
+void
+parse_levels(const char* list,unsigned values[CACHESIM_MAX_LEVELS])
+{
+    for(unsigned l = 0;l < CACHESIM_MAX_LEVELS && *list;++l)
+    {
+        char* end;
+        values[l] = strtoul(list,&end,0);
+        if(end == list || (*end && *end != ','))
+        {
+            printf("Invalid arguments!");
+            exit(0);
+        }
+        list = *end ? end + 1 : end;
+    }
+}
 
-struct cache_t
+/*
+ * comma separated index function names, L1 first
+ */
+void
+parse_index_fns(const char* list,cachesim_index_fn fns[CACHESIM_MAX_LEVELS])
 {
-    cache_line* lines;
-    cache_t* sets;
-    unsigned n;
-    cache_stats stats;
-    cache_t* victim;
-    cache_type type;
-};
-
-//struct to keep extracted address components
-typedef struct
+    static const char* names[] = {"bits", "mod", "xor", "skew"};
+    for(unsigned l = 0;l < CACHESIM_MAX_LEVELS && *list;++l)
+    {
+        size_t len = strcspn(list,",");
+        unsigned f = 0;
+        while(f < sizeof(names)/sizeof(names[0]) && (strlen(names[f]) != len || strncmp(names[f],list,len)))
+            ++f;
+        if(f == sizeof(names)/sizeof(names[0]))
+        {
+            printf("Invalid arguments!");
+            exit(0);
+        }
+        fns[l] = f;
+        list += list[len] ? len + 1 : len;
+    }
+}
+
+/*
+ * comma separated way masks, class 0 first; sets the class count
+ */
+void
+parse_masks(const char* list,cachesim_partition_config* config)
 {
-    unsigned index;
-    unsigned tag;
-    unsigned fa_tag;
-    unsigned block_offset;
-}address_info;
-
-unsigned get_mask(unsigned);
-unsigned get_address_len(unsigned );
-cache_t* init_assoc_cache(unsigned,unsigned,unsigned);
-cache_t* init_cache(unsigned,unsigned);
-cache_t* init_fa_cache(unsigned);
-void deinit_assoc_cache(cache_t*);
-void deinit_cache(cache_t*);
-int access_cache(cache_t*,address_info,char);
-
-//produce number for masking to get certain bits
+    unsigned c = 0;
+    while(*list)
+    {
+        char* end;
+        if(c == CACHESIM_MAX_CLASSES)
+            break;
+        config->way_mask[c++] = strtoull(list,&end,0);
+        if(end == list || (*end && *end != ','))
+            break;
+        list = *end ? end + 1 : end;
+        if(!*list)
+        {
+            config->n_classes = c;
+            return;
+        }
+    }
+    printf("Invalid arguments!");
+    exit(0);
+}
+
+/*
+ * comma separated level numbers, 1 for L1, as a mask with bit 0 for L1
+ */
 unsigned
-get_mask(unsigned length)
+parse_event_levels(const char* list)
 {
-    unsigned mask = pow(2,length) - 1;
+    unsigned mask = 0;
+    while(*list)
+    {
+        char* end;
+        unsigned level = strtoul(list,&end,0);
+        if(end == list || !level || level > CACHESIM_MAX_LEVELS || (*end && *end != ','))
+        {
+            printf("Invalid arguments!");
+            exit(0);
+        }
+        mask |= 1u << (level - 1);
+        list = *end ? end + 1 : end;
+    }
     return mask;
 }
-//get address bit length
+
+/*
+ * comma separated event type names as a cachesim_event_type mask
+ */
 unsigned
-get_address_len(unsigned address)
+parse_event_types(const char* list)
 {
-    unsigned bits=0;
-    while(address)
+    static const char* names[] = {"fill", "evict", "writeback"};
+    unsigned mask = 0;
+    while(*list)
     {
-        address>>=1;
-        ++bits;
+        size_t len = strcspn(list,",");
+        unsigned t = 0;
+        while(t < sizeof(names)/sizeof(names[0]) && (strlen(names[t]) != len || strncmp(names[t],list,len)))
+            ++t;
+        if(t == sizeof(names)/sizeof(names[0]))
+        {
+            printf("Invalid arguments!");
+            exit(0);
+        }
+        mask |= 1u << t;
+        list += list[len] ? len + 1 : len;
     }
-    return bits;
+    return mask;
+}
+
+void
+report_timing(const cachesim_timing* timing)
+{
+    cachesim_timing_stats stats;
+    cachesim_timing_get_stats(timing,&stats);
+    printf("AMAT: %.2f cycles\tcycles: %llu\tstall cycles: %llu (%.2f%%)\n",stats.amat,
+            (unsigned long long)stats.cycles,(unsigned long long)stats.stall_cycles,
+            stats.cycles ? 100.0*stats.stall_cycles/stats.cycles : 0.0);
+    printf("L1 MSHR misses: %llu\tmerged: %llu\tMLP: %.2f over %llu cycles\tMSHR full: L1 %llu L2 %llu\n\n",
+            (unsigned long long)stats.misses,(unsigned long long)stats.merged,stats.mlp,
+            (unsigned long long)stats.miss_cycles,(unsigned long long)stats.mshr_full[0],
+            (unsigned long long)stats.mshr_full[1]);
 }
 
+void
+report_dram(cachesim* sim)
+{
+    cachesim_dram_stats stats;
+    cachesim_get_dram_stats(sim,&stats);
+    printf("DRAM reads: %llu\twrites: %llu\trow hits: %.2f%%\trow empty: %llu\trow conflicts: %llu\t"
+           "bank conflicts: %llu\n",(unsigned long long)stats.reads,(unsigned long long)stats.writes,
+           100.0*stats.row_hit_rate,(unsigned long long)stats.row_empty,(unsigned long long)stats.row_conflicts,
+           (unsigned long long)stats.bank_conflicts);
+    printf("DRAM bandwidth utilization: %.2f%% over %llu cycles\taverage miss latency: %.1f cycles\t"
+           "queue full: %llu\n\n",100.0*stats.utilization,(unsigned long long)stats.cycles,stats.read_latency,
+           (unsigned long long)stats.queue_full);
+}
 
+/*
+ * predictor statistics and the L2 miss rate against the plain hierarchy
+ * that ran the same accesses
+ */
+void
+report_deadblock(const cachesim* sim,const cachesim* plain,cachesim_insert_policy policy)
+{
+    static const char* policies[] = {"mru", "lru", "bip", "predict", "bypass"};
+    cachesim_deadblock_stats stats;
+    cache_stats L2, base;
+    cachesim_get_deadblock_stats(sim,&stats);
+    cachesim_get_stats(sim,1,&L2);
+    cachesim_get_stats(plain,1,&base);
+    double rate = L2.hits + L2.total_misses ? 100.0*L2.total_misses/(L2.hits + L2.total_misses) : 0;
+    double base_rate = base.hits + base.total_misses ? 100.0*base.total_misses/(base.hits + base.total_misses) : 0;
+    printf("dead-block %s: fills: %llu\tLRU fills: %llu\tbypasses: %llu\tpredicted dead: %llu\t"
+           "dead evictions: %llu\n",policies[policy],
+           (unsigned long long)stats.fills,(unsigned long long)stats.lru_inserts,(unsigned long long)stats.bypasses,
+           (unsigned long long)stats.predicted_dead,(unsigned long long)stats.dead_evictions);
+    printf("dead-block accuracy: %.2f%%\tcoverage: %.2f%%\tL2 miss rate: %.2f%% (plain %.2f%%, %+.2f points, "
+           "%+lld misses)\n\n",100.0*stats.accuracy,100.0*stats.coverage,rate,base_rate,rate - base_rate,
+           (long long)L2.total_misses - (long long)base.total_misses);
+}
 
 /*
- * initializing set-associative cache
+ * accesses, hits and misses of every class with its L2 ways and lines
  */
-cache_t*
-init_assoc_cache(unsigned n_lines, unsigned associativity,unsigned victim)
+void
+report_classes(const cachesim* sim,char** names)
 {
-    cache_t* cache = realloc(NULL,sizeof(cache_t));
-    unsigned n_sets = n_lines/associativity;
-    cache->n = n_sets;
-    cache->sets = malloc(n_sets*sizeof(cache_t));
-    //initialize each set of cache
-    for(int i = 0; i < n_sets;++i)
-    {
-        cache->sets[i].n = associativity;
-        cache->sets[i].lines = malloc(associativity*sizeof(cache_line));
-        // initialize each line of set
-        for(int j = 0;j < associativity; ++j)
-        {
-            cache->sets[i].lines[j].tag = 0;
-            cache->sets[i].lines[j].dirty = 0;
-            cache->sets[i].lines[j].valid = 0;
-            cache->sets[i].lines[j].last_used_time = 0;
-        }
-    }
-    cache->stats.total_accesses = 0;
-    cache->stats.conflict_misses = 0;
-    cache->stats.cold_misses = 0;
-    cache->stats.total_misses = 0;
-    cache->stats.capacity_misses = 0;
-    cache->stats.hits = 0;
-    if(victim)
-        cache->victim = init_cache(victim/n_lines,0);
+    cachesim_class_stats stats;
+    for(unsigned c = 0;!cachesim_get_class_stats(sim,c,&stats);++c)
+    {
+        printf("class %u (%s): L1 hits: %zd\tmiss:%zd\tL2 hits: %zd\tmiss:%zd (%.2f%%)\tways %#llx\tlines %llu\n",c,
+                names[c],stats.stats[0].hits,stats.stats[0].total_misses,stats.stats[1].hits,stats.stats[1].total_misses,
+                stats.stats[1].total_accesses ? 100.0*stats.stats[1].total_misses/stats.stats[1].total_accesses : 0.0,
+                (unsigned long long)stats.way_mask,(unsigned long long)stats.occupancy);
+    }
+    if(cachesim_repartitions(sim))
+        printf("repartitions: %llu\n",(unsigned long long)cachesim_repartitions(sim));
+    printf("\n");
+}
+
+/*
+ * replay the stream matching this trace and L1 from dir, setting left to 0,
+ * or return a recorder that creates it
+ */
+cachesim_filter*
+open_l1_stream(cachesim* sim,const char* dir,const char* name,const char* trace,unsigned accesses,size_t* left)
+{
+    struct stat st;
+    if(stat(trace,&st))
+        return NULL;
+    cachesim_filter_key key = {st.st_size, st.st_mtime, accesses};
+    cachesim_config config;
+    cachesim_get_config(sim,&config);
+    char path[PATH_MAX];
+    snprintf(path,sizeof(path),"%s/%s-%u-%u-%u-%u-%u.l1s",dir,name,config.level[0].size,config.level[0].assoc,
+            config.level[0].line_size,config.level[0].victim_size,accesses);
+
+    if(!cachesim_filter_replay(sim,path,&key))
+    {
+        printf("L1 stream: replayed %s\n",path);
+        *left = 0;
+        return NULL;
+    }
+    mkdir(dir,0777);
+    cachesim_filter* stream = cachesim_filter_record(sim,path,&key);
+    if(!stream)
+        printf("L1 stream: unable to create %s\n",path);
     else
-        cache->victim = NULL;
-    return cache;
+        printf("L1 stream: recording %s\n",path);
+    return stream;
 }
 
 /*
- * freeing memory associative cache
+ * A:B pairs separated by commas; returns how many
  */
-void
-deinit_assoc_cache(cache_t* cache)
+unsigned
+parse_ranges(const char* list,trace_range* ranges)
 {
-    for(int i = 0;i<cache->n;++i)
-        free(cache->sets[i].lines);
-    free(cache->sets);
-    if(cache->victim)
-        deinit_cache(cache->victim);
-    free(cache);
+    unsigned n = 0;
+    while(*list)
+    {
+        char* end;
+        if(n == MAX_RANGES)
+            break;
+        ranges[n].begin = strtoull(list,&end,0);
+        if(*end != ':')
+            break;
+        list = end + 1;
+        ranges[n].end = strtoull(list,&end,0);
+        if(end == list || ranges[n].end <= ranges[n].begin || (*end && *end != ','))
+            break;
+        ++n;
+        list = *end ? end + 1 : end;
+        if(!*list)
+            return n;
+    }
+    printf("Invalid arguments!");
+    exit(0);
 }
 
+/*
+ * simulate each range from the index checkpoint below it (cold without
+ * one), print its stats and sum them into totals; returns the accesses
+ * simulated inside the ranges
+ */
+size_t
+run_ranges(cachesim* sim,FILE* fin,const char* trace,const char* index_path,const trace_range* ranges,unsigned n,
+           cache_stats totals[2])
+{
+    unsigned char* block = malloc(TRACE_BLOCK*CACHESIM_RECORD_SIZE);
+    if(!block) { printf("Unable to allocate trace buffer\n"); exit(0); }
+    trace_index* index = trace_index_open(index_path,trace,sim);
+    size_t simulated = 0;
+    memset(totals,0,2*sizeof(cache_stats));
+    for(unsigned r = 0;r < n;++r)
+    {
+        uint64_t offset = ranges[r].begin*CACHESIM_RECORD_SIZE;
+        uint64_t record = ranges[r].begin;
+        int warm = 0;
+        if(index)
+            warm = trace_index_seek(index,ranges[r].begin,sim,&record,&offset);
+        else
+            cachesim_reset(sim);
+        //a range from the start of the trace is warm by definition
+        warm |= !ranges[r].begin;
+        if(fseeko(fin,offset,SEEK_SET))
+            break;
+
+        cache_stats before[2], after[2];
+        size_t got = TRACE_BLOCK;
+        //fast-forward from the checkpoint, then count the range
+        for(int counting = 0;counting < 2 && got;++counting)
+        {
+            uint64_t until = counting ? ranges[r].end : ranges[r].begin;
+            if(counting)
+            {
+                cachesim_get_stats(sim,0,&before[0]);
+                cachesim_get_stats(sim,1,&before[1]);
+            }
+            while(record < until)
+            {
+                size_t want = until - record < TRACE_BLOCK ? until - record : TRACE_BLOCK;
+                got = fread(block,CACHESIM_RECORD_SIZE,want,fin);
+                cachesim_run_trace(sim,block,got);
+                record += got;
+                if(counting)
+                    simulated += got;
+                if(got < want)
+                {
+                    got = 0;
+                    break;
+                }
+            }
+        }
+        //the trace ended before the range began: nothing was counted
+        if(record < ranges[r].begin)
+        {
+            printf("range %llu-%llu: past the end of the trace (%llu records)\n",
+                    (unsigned long long)ranges[r].begin,(unsigned long long)ranges[r].end,(unsigned long long)record);
+            continue;
+        }
+        cachesim_get_stats(sim,0,&after[0]);
+        cachesim_get_stats(sim,1,&after[1]);
+        for(int l = 0;l < 2;++l)
+        {
+            after[l].hits -= before[l].hits;
+            after[l].total_misses -= before[l].total_misses;
+            after[l].cold_misses -= before[l].cold_misses;
+            totals[l].hits += after[l].hits;
+            totals[l].total_misses += after[l].total_misses;
+            totals[l].cold_misses += after[l].cold_misses;
+        }
+        printf("range %llu-%llu (%s): L1 hits: %zu\tmiss:%zu\tcold:%zu\tL2 hits: %zu\tmiss:%zu\tcold:%zu\n",
+                (unsigned long long)ranges[r].begin,(unsigned long long)record,warm ? "warm" : "cold",
+                after[0].hits,after[0].total_misses,after[0].cold_misses,after[1].hits,after[1].total_misses,
+                after[1].cold_misses);
+    }
+    free(block);
+    trace_index_close(index);
+    return simulated;
+}
 
 /*
- * initializing both-direct mapped and fully-associative
+ * interleave the traces quantum records at a time, each as the class of
+ * its position; the class is XORed into the top 4 address bits so tenants
+ * running the same addresses do not share lines. A tenant whose trace
+ * ends drops out. returns the records simulated
  */
-cache_t*
-init_cache(unsigned n_lines,unsigned victim)
+size_t
+run_tenants(cachesim* sim,FILE** fins,unsigned n,size_t accesses,unsigned quantum)
 {
-    cache_t* cache = realloc(NULL,sizeof(cache_t));
-    cache->n = n_lines;
-    cache->lines = realloc(NULL,n_lines * sizeof(cache_line));
-    for(int i = 0;i<n_lines;++i)
-    {
-        cache->lines[i].tag = 0;
-        cache->lines[i].dirty = 0;
-        cache->lines[i].valid = 0;
-        cache->lines[i].last_used_time = 0;
-    }
-    cache->stats.total_accesses = 0;
-    cache->stats.conflict_misses = 0;
-    cache->stats.cold_misses = 0;
-    cache->stats.total_misses = 0;
-    cache->stats.capacity_misses = 0;
-    cache->stats.hits = 0;
-
-    if(victim)
-        cache->victim = init_cache(victim/n_lines,0);
-    else
-        cache->victim = 0;
-    cache->sets = NULL;
-    return cache;
+    unsigned char* block = malloc((size_t)quantum*CACHESIM_RECORD_SIZE);
+    int* ended = calloc(n,sizeof(int));
+    size_t left = accesses;
+    unsigned active = n;
+    while(left && active)
+    {
+        for(unsigned t = 0;t < n && left;++t)
+        {
+            if(ended[t])
+                continue;
+            size_t want = left < quantum ? left : quantum;
+            size_t got = fread(block,CACHESIM_RECORD_SIZE,want,fins[t]);
+            //byte 3 is the top of the little-endian address
+            for(size_t i = 0;i < got;++i)
+                block[i*CACHESIM_RECORD_SIZE + 3] ^= t << 4;
+            cachesim_set_class(sim,t);
+            cachesim_run_trace(sim,block,got);
+            left -= got;
+            if(got < want)
+            {
+                ended[t] = 1;
+                --active;
+            }
+        }
+    }
+    free(ended);
+    free(block);
+    return accesses - left;
 }
 
 void
-deinit_cache(cache_t* cache)
+publish_stats(const cachesim* sim)
 {
-    free(cache->lines);
-    if(cache->victim)
-        deinit_cache(cache->victim);
-    free(cache);
+    cache_stats L1, L2;
+    cachesim_get_stats(sim,0,&L1);
+    cachesim_get_stats(sim,1,&L2);
+    printf("follow: %llu accesses\tL1 hits: %zd\tmiss:%zd\tL2 hits: %zd\tmiss:%zd\n",
+            (unsigned long long)cachesim_accesses(sim),L1.hits,L1.total_misses,L2.hits,L2.total_misses);
+    fflush(stdout);
 }
 
-void printResults(int cacheLevel, int hits, int victimHits, int cold, int capacity, int conflict) 
+static void
+stop_following(int sig)
 {
-    printf("L%u Cache Stats:\t%x\t%x\t%x\t%x\t%x\n", cacheLevel, hits, victimHits, cold, capacity, conflict);
-    printf("\n");
+    follow_stop = 1;
 }
 
-char* concat(const char *size1, const char *size2)
+static uint64_t
+monotonic_ms(void)
 {
-    char *result = malloc(strlen(size1) + strlen(size2) + 1);
-    strcpy(result, size1);
-    strcat(result, size2);
-    return result;
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC,&ts);
+    return ts.tv_sec*1000ull + ts.tv_nsec/1000000;
+}
+
+/*
+ * keep sim resident and simulate only what is appended to the trace,
+ * publishing the statistics at most every cadence_ms; a restarted trace
+ * resets the hierarchy
+ */
+void
+run_follow(cachesim* sim,const char* path,size_t accesses,unsigned cadence_ms,unsigned idle_s)
+{
+    trace_follow* follow = trace_follow_open(path,0);
+    if(!follow) { printf("Unable to open trace file\n"); exit(0); }
+    unsigned char* block = malloc(PARALLEL_BLOCK*CACHESIM_RECORD_SIZE);
+    if(!block) { printf("Unable to allocate trace buffer\n"); exit(0); }
+    signal(SIGINT,stop_following);
+    uint64_t now = monotonic_ms(), publish = now, last_data = now;
+    int fresh = 0;
+    while(!follow_stop)
+    {
+        size_t want = PARALLEL_BLOCK;
+        if(accesses && accesses - cachesim_accesses(sim) < want)
+            want = accesses - cachesim_accesses(sim);
+        if(!want)
+            break;
+        //wait for the next publication while there is news, else for the idle limit
+        int timeout = -1;
+        if(fresh)
+            timeout = publish > now ? publish - now : 0;
+        else if(idle_s)
+            timeout = last_data + idle_s*1000ull > now ? last_data + idle_s*1000ull - now : 0;
+
+        size_t got;
+        follow_status status = trace_follow_read(follow,block,want,timeout,&got);
+        now = monotonic_ms();
+        if(status == FOLLOW_GONE)
+            break;
+        if(status == FOLLOW_RESTARTED)
+        {
+            printf("follow: trace restarted\n");
+            cachesim_reset(sim);
+            fresh = 0;
+            continue;
+        }
+        if(status == FOLLOW_DATA)
+        {
+            cachesim_run_trace(sim,block,got);
+            fresh = 1;
+            last_data = now;
+        }
+        else if(idle_s && now - last_data >= idle_s*1000ull)
+            break;
+        if(fresh && now >= publish)
+        {
+            publish_stats(sim);
+            fresh = 0;
+            publish = now + cadence_ms;
+        }
+    }
+    if(fresh)
+        publish_stats(sim);
+    signal(SIGINT,SIG_DFL);
+    free(block);
+    trace_follow_close(follow);
 }
 
+/*
+ * Belady's MIN over the first accesses records of the trace; -1 if it
+ * cannot be read into memory or a level is skewed-associative
+ */
 int
-access_cache(cache_t* cache,address_info af,char op)
+run_opt(const cachesim_config* config,const char* path,size_t accesses,cache_stats stats[2])
 {
-    
-    int hit = 0;
-        switch(cache->type)
+    FILE* fin = fopen(path,"rb");
+    if(!fin)
+        return -1;
+    unsigned char* records = malloc(accesses*CACHESIM_RECORD_SIZE + 1);
+    size_t got = records ? fread(records,CACHESIM_RECORD_SIZE,accesses,fin) : 0;
+    fclose(fin);
+    int failed = !records || cachesim_run_opt(config,records,got,stats);
+    free(records);
+    return failed ? -1 : 0;
+}
+
+int 
+main (int argc, char *argv[])
+{
+    static const struct option long_options[] =
+    {
+        {"perf", optional_argument, NULL, 'p'},
+        {"interval", required_argument, NULL, 'i'},
+        {"interval-out", required_argument, NULL, 'I'},
+        {"hotspots", optional_argument, NULL, 'h'},
+        {"threads", required_argument, NULL, 't'},
+        {"pipeline", no_argument, NULL, 'P'},
+        {"slices", required_argument, NULL, 'k'},
+        {"warmup", required_argument, NULL, 'w'},
+        {"exact", no_argument, NULL, 'e'},
+        {"reference", no_argument, NULL, 'r'},
+        {"timing", no_argument, NULL, 'T'},
+        {"hit-latency", required_argument, NULL, 'L'},
+        {"miss-penalty", required_argument, NULL, 'M'},
+        {"mshrs", required_argument, NULL, 'm'},
+        {"memory-latency", required_argument, NULL, 'D'},
+        {"window", required_argument, NULL, 'W'},
+        {"issue-interval", required_argument, NULL, 'n'},
+        {"l1-stream", optional_argument, NULL, 's'},
+        {"skip", required_argument, NULL, 'S'},
+        {"range", required_argument, NULL, 'R'},
+        {"build-index", optional_argument, NULL, 'B'},
+        {"index", required_argument, NULL, 'x'},
+        {"results", optional_argument, NULL, 'c'},
+        {"results-max", required_argument, NULL, 'C'},
+        {"memory", no_argument, NULL, 'a'},
+        {"index-fn", required_argument, NULL, 'f'},
+        {"tenants", required_argument, NULL, 'N'},
+        {"quantum", required_argument, NULL, 'q'},
+        {"partition", required_argument, NULL, 'u'},
+        {"umon", optional_argument, NULL, 'U'},
+        {"format", required_argument, NULL, 'F'},
+        {"ifetch", no_argument, NULL, 'y'},
+        {"follow", optional_argument, NULL, 'o'},
+        {"follow-idle", required_argument, NULL, 'O'},
+        {"events", optional_argument, NULL, 'E'},
+        {"event-levels", required_argument, NULL, 'v'},
+        {"event-types", required_argument, NULL, 'V'},
+        {"opt", no_argument, NULL, 'b'},
+        {"dram", optional_argument, NULL, 'G'},
+        {"dram-mapping", required_argument, NULL, 'g'},
+        {"dram-geometry", required_argument, NULL, 'Y'},
+        {"dram-timing", required_argument, NULL, 'Z'},
+        {"dram-queue", required_argument, NULL, 'Q'},
+        {"dram-interval", required_argument, NULL, 'K'},
+        {"deadblock", required_argument, NULL, 'd'},
+        {"deadblock-region", required_argument, NULL, 'j'},
+        {NULL, 0, NULL, 0}
+    };
+    unsigned perf_period = 0;
+    unsigned interval = 0;
+    const char* interval_path = "intervals.bin";
+    unsigned hotspots = 0;
+    unsigned threads = 1;
+    int pipelined = 0;
+    cachesim_slice_config slice_config = {0, 100000, 0, 0};
+    int reference = 0;
+    int timed = 0, penalty_set = 0;
+    const char* stream_dir = NULL;
+    trace_range ranges[MAX_RANGES];
+    unsigned n_ranges = 0;
+    uint64_t skip = 0;
+    uint64_t index_interval = 0;
+    const char* index_path = NULL;
+    const char* results_dir = NULL;
+    uint64_t results_max = 64ull << 20;
+    int report_memory = 0;
+    cachesim_index_fn index_fns[CACHESIM_MAX_LEVELS] = {CACHESIM_INDEX_BITS};
+    char* tenants[CACHESIM_MAX_CLASSES] = {NULL};
+    unsigned n_tenants = 1;
+    char* tenant_list = NULL;
+    unsigned quantum = 64;
+    int partitioned = 0;
+    int import_format = -1, ifetch = 0;
+    int following = 0;
+    unsigned follow_cadence = 1000, follow_idle = 0;
+    const char* event_path = NULL;
+    unsigned event_levels = ~0u;
+    unsigned event_types = CACHESIM_EVENT_FILL | CACHESIM_EVENT_EVICT | CACHESIM_EVENT_WRITEBACK;
+    int opt_bound = 0;
+    int dram = 0;
+    cachesim_dram_config dram_config = {1, 1, 8, 8192, 32, 0, CACHESIM_DRAM_MAP_PAGE, 14, 14, 14, 4, 4};
+    unsigned dram_values[CACHESIM_MAX_LEVELS];
+    int deadblock = 0;
+    cachesim_deadblock_config deadblock_config = {1, CACHESIM_INSERT_MRU, 12};
+    cachesim_partition_config partition_config;
+    memset(&partition_config,0,sizeof(partition_config));
+    cachesim_timing_config timing_config = {{4, 12}, {0}, {8, 16}, 200, 1, 64};
+    int opt;
+    while((opt = getopt_long(argc,argv,"",long_options,NULL)) != -1)
+    {
+        switch(opt)
         {
-            case(direct_mapped):
-                switch(op)
+            case('p'):
+                perf_period = optarg ? atoi(optarg) : 1;
+                if(!perf_period)
+                    perf_period = 1;
+                break;
+            case('i'):
+                interval = atoi(optarg);
+                break;
+            case('I'):
+                interval_path = optarg;
+                break;
+            case('t'):
+                threads = atoi(optarg);
+                if(!threads)
+                    threads = 1;
+                break;
+            case('P'):
+                pipelined = 1;
+                break;
+            case('k'):
+                slice_config.slices = atoi(optarg);
+                break;
+            case('w'):
+                slice_config.warmup = strtoull(optarg,NULL,0);
+                break;
+            case('e'):
+                slice_config.exact = 1;
+                break;
+            case('r'):
+                reference = 1;
+                break;
+            case('T'):
+                timed = 1;
+                break;
+            case('L'):
+                parse_levels(optarg,timing_config.hit_latency);
+                timed = 1;
+                break;
+            case('M'):
+                parse_levels(optarg,timing_config.miss_penalty);
+                timed = penalty_set = 1;
+                break;
+            case('m'):
+                parse_levels(optarg,timing_config.mshrs);
+                timed = 1;
+                break;
+            case('D'):
+                timing_config.memory_latency = atoi(optarg);
+                timed = 1;
+                break;
+            case('W'):
+                timing_config.window = atoi(optarg);
+                timed = 1;
+                break;
+            case('n'):
+                timing_config.issue_interval = atoi(optarg);
+                timed = 1;
+                break;
+            case('s'):
+                stream_dir = optarg ? optarg : "streams";
+                break;
+            case('S'):
+                skip = strtoull(optarg,NULL,0);
+                break;
+            case('R'):
+                n_ranges = parse_ranges(optarg,ranges);
+                break;
+            case('B'):
+                index_interval = optarg ? strtoull(optarg,NULL,0) : 1000000;
+                if(!index_interval)
+                    index_interval = 1000000;
+                break;
+            case('x'):
+                index_path = optarg;
+                break;
+            case('c'):
+                results_dir = optarg ? optarg : "results";
+                break;
+            case('C'):
+                results_max = strtoull(optarg,NULL,0) << 10;
+                break;
+            case('a'):
+                report_memory = 1;
+                break;
+            case('f'):
+                parse_index_fns(optarg,index_fns);
+                break;
+            case('N'):
+                free(tenant_list);
+                tenant_list = strdup(optarg);
+                n_tenants = 1;
+                for(char* name = strtok(tenant_list,",");name;name = strtok(NULL,","))
+                {
+                    if(n_tenants == CACHESIM_MAX_CLASSES)
+                    {
+                        printf("Invalid arguments!");
+                        exit(0);
+                    }
+                    tenants[n_tenants++] = name;
+                }
+                partitioned = 1;
+                break;
+            case('q'):
+                quantum = atoi(optarg);
+                if(!quantum)
+                    quantum = 1;
+                break;
+            case('u'):
+                parse_masks(optarg,&partition_config);
+                partitioned = 1;
+                break;
+            case('F'):
+                import_format = trace_format_parse(optarg);
+                if(import_format < 0)
+                {
+                    printf("Invalid arguments!");
+                    exit(0);
+                }
+                break;
+            case('y'):
+                ifetch = 1;
+                break;
+            case('o'):
+                following = 1;
+                if(optarg)
+                    follow_cadence = atoi(optarg);
+                break;
+            case('O'):
+                follow_idle = atoi(optarg);
+                break;
+            case('E'):
+                event_path = optarg ? optarg : "events.bin";
+                break;
+            case('v'):
+                event_levels = parse_event_levels(optarg);
+                break;
+            case('V'):
+                event_types = parse_event_types(optarg);
+                break;
+            case('b'):
+                opt_bound = 1;
+                break;
+            case('d'):
+            {
+                static const char* policies[] = {"mru", "lru", "bip", "predict", "bypass"};
+                deadblock = 0;
+                for(unsigned p = 0;p < sizeof(policies)/sizeof(policies[0]);++p)
                 {
-                    case('r'):
-                            if((cache->lines[af.index].valid)&&(cache->lines[af.index].tag == af.tag))
-                            {
-
-                                ++cache->stats.hits;
-                                cache->lines[af.index].last_used_time = total_cache_accesses;
-                                return 1;
-                            }
-                            else
-                            {
-                                if(!cache->lines[af.index].valid)
-                                    ++cache->stats.cold_misses;
-                                if((cache->lines[af.index].valid)&&(cache->lines[af.index].tag != af.tag))
-                                    ++cache->stats.cold_misses;
-                                cache->lines[af.index].valid = 1;
-                                cache->lines[af.index].tag = af.tag;
-                                ++cache->stats.total_misses;
-                                return 0;
-                            }
-                        break;
-                    case('w'):
-                        if((cache->lines[af.index].valid)&&(cache->lines[af.index].tag == af.tag))
-                        {
-                            cache->lines[af.index].dirty = 1;
-                            ++cache->stats.hits;
-                            return 1;
-                        }
-
-                        if(!cache->lines[af.index].valid)
-                            ++cache->stats.cold_misses;
-                        cache->lines[af.index].tag = af.tag;
-                        cache->lines[af.index].dirty = 1;
-                        cache->lines[af.index].valid = 1;
-                        ++cache->stats.total_misses;
-                        return 0;
+                    if(!strcmp(optarg,policies[p]))
+                    {
+                        deadblock_config.policy = p;
+                        deadblock = 1;
+                    }
                 }
+                if(!deadblock)
+                {
+                    printf("Invalid arguments!");
+                    exit(0);
+                }
+                break;
+            }
+            case('j'):
+                deadblock_config.region_bits = atoi(optarg);
                 break;
-            case(associative):
-                switch(op)
+            case('G'):
+                dram = 1;
+                if(optarg && strcmp(optarg,"open") && strcmp(optarg,"closed"))
                 {
-                    case('r'):
-                        for(int set = 0;set < cache->sets[af.index].n; ++set)
-                        {
-                            if((cache->sets[af.index].lines[set].valid)&&(cache->sets[af.index].lines[set].tag == af.tag))
-                            {
-                                // it hit
-                                cache->sets[af.index].lines[set].dirty = 1;
-                                cache->sets[af.index].lines[set].last_used_time = total_cache_accesses;
-                                ++cache->stats.hits;
-                                return 1;
-                            }
-                       }
-                        
-                        //calculate LRU
-                        //
-                        unsigned oldest_block = UINT_MAX;
-                        unsigned oldest_line = 0;
-                        for(int set = 0;set < cache->sets[af.index].n;++set)
-                        {
-                            if(cache->sets[af.index].lines[set].last_used_time < oldest_block)
-                            {
-                                oldest_block = cache->sets[af.index].lines[set].last_used_time;
-                                oldest_line = set;
-                            }
-                        }
-                        if(!cache->sets[af.index].lines[oldest_line].valid)
-                            ++cache->stats.cold_misses;
-                        cache->sets[af.index].lines[oldest_line].tag = af.tag;
-                        cache->sets[af.index].lines[oldest_line].valid = 1;
-                        cache->sets[af.index].lines[oldest_line].dirty = 1;
-                        cache->sets[af.index].lines[oldest_line].last_used_time = total_cache_accesses;
-                        ++cache->stats.total_misses;
-                        return 0;
-                    
-                    case('w'):
-                            for(int set = 0;set < cache->sets[af.index].n;++set)
-                            {
-                                if((cache->sets[af.index].lines[set].valid)&&(cache->sets[af.index].lines[set].tag == af.tag))
-                                {
-                                    cache->sets[af.index].lines[set].dirty = 1;
-                                    ++cache->stats.hits;
-                                    cache->sets[af.index].lines[set].last_used_time = total_cache_accesses;
-                                    return 1;
-                                }
-                            }
-                            if(!hit)
-                            {
-                                unsigned oldest_block = UINT_MAX;
-                                unsigned oldest_line = 0;
-                                for(int set = 0;set<cache->sets[af.index].n;++set)
-                                {
-                                    if(cache->sets[af.index].lines[set].last_used_time < oldest_block)
-                                    {
-                                        oldest_block = cache->sets[af.index].lines[set].last_used_time;
-                                        oldest_line = set;
-                                    }
-                                }
-                            if(!cache->sets[af.index].lines[oldest_line].valid)
-                                ++cache->stats.cold_misses;
-                            cache->sets[af.index].lines[oldest_line].tag = af.tag;
-                            cache->sets[af.index].lines[oldest_line].valid = 1;
-                            cache->sets[af.index].lines[oldest_line].dirty = 1;
-                            cache->sets[af.index].lines[oldest_line].last_used_time = total_cache_accesses;
-                            cache->stats.total_misses++;
-                            return 0;
-                            }
-                        break;
+                    printf("Invalid arguments!");
+                    exit(0);
                 }
+                dram_config.closed_page = optarg && !strcmp(optarg,"closed");
                 break;
-            case(fully_associative):
-                switch(op)
+            case('g'):
+                if(!strcmp(optarg,"page"))
+                    dram_config.mapping = CACHESIM_DRAM_MAP_PAGE;
+                else if(!strcmp(optarg,"line"))
+                    dram_config.mapping = CACHESIM_DRAM_MAP_LINE;
+                else if(!strcmp(optarg,"xor"))
+                    dram_config.mapping = CACHESIM_DRAM_MAP_XOR;
+                else
                 {
-                    case('r'):
-                        for(int line = 0;line < cache->n;++line)
-                        {
-                            if((cache->lines[line].valid)&&(cache->lines[line].tag = af.tag))
-                            {
-                                cache->lines[line].valid = 1;
-                                cache->lines[line].last_used_time = total_cache_accesses;
-                                ++cache->stats.hits;
-                                hit = 1;
-                                return 1;
-                            }
-                        }
-                            unsigned oldest_block = UINT_MAX;
-                            unsigned oldest_line = 0;
-                            for(int line = 0;line < cache->n;++line)
-                            {
-                                if(cache->lines[line].last_used_time < oldest_block)
-                                {
-                                    oldest_block = cache->lines[line].last_used_time;
-                                    oldest_line = line;
-                                }
-                            }
-                            if(!cache->lines[oldest_line].valid)
-                                ++cache->stats.cold_misses;
-                            cache->lines[oldest_line].dirty = 1;
-                            cache->lines[oldest_line].valid = 1;
-                            cache->lines[oldest_line].last_used_time = total_cache_accesses;
-                            ++cache->stats.total_misses;
-                            return 0;
-                    
-
-
-                        break;
-                    case('w'):
-                        for(int line = 0;line < cache->n;++line)
-                        {
-                            if((cache->lines[line].valid)&&(cache->lines[line].tag = af.tag))
-                            {
-                                cache->lines[line].valid = 1;
-                                cache->lines[line].last_used_time = total_cache_accesses;
-                                ++cache->stats.hits;
-                                hit = 1;
-                                return 1;
-                            }
-                        }
-                        if(!hit)
-                        {
-                                unsigned oldest_block = UINT_MAX;
-                                unsigned oldest_line = 0;
-                                for(int line = 0;line < cache->n;++line)
-                                {
-                                    if(cache->lines[line].last_used_time < oldest_block)
-                                    {
-                                        oldest_block = cache->lines[line].last_used_time;
-                                        oldest_line = line;
-                                    }
-                                }
-                                if(!cache->lines[oldest_line].valid)
-                                    ++cache->stats.cold_misses;
-                                cache->lines[oldest_line].dirty = 1;
-                                cache->lines[oldest_line].valid = 1;
-                                cache->lines[oldest_line].last_used_time = total_cache_accesses;
-                                ++cache->stats.total_misses;
-
-                        }
-
-
-                        break;
+                    printf("Invalid arguments!");
+                    exit(0);
                 }
                 break;
+            case('Y'):
+                dram_values[0] = dram_config.channels;
+                dram_values[1] = dram_config.ranks;
+                dram_values[2] = dram_config.banks;
+                dram_values[3] = dram_config.row_bytes;
+                parse_levels(optarg,dram_values);
+                dram_config.channels = dram_values[0];
+                dram_config.ranks = dram_values[1];
+                dram_config.banks = dram_values[2];
+                dram_config.row_bytes = dram_values[3];
+                break;
+            case('Z'):
+                dram_values[0] = dram_config.t_cl;
+                dram_values[1] = dram_config.t_rcd;
+                dram_values[2] = dram_config.t_rp;
+                dram_values[3] = dram_config.t_burst;
+                parse_levels(optarg,dram_values);
+                dram_config.t_cl = dram_values[0];
+                dram_config.t_rcd = dram_values[1];
+                dram_config.t_rp = dram_values[2];
+                dram_config.t_burst = dram_values[3];
+                break;
+            case('Q'):
+                dram_config.queue = atoi(optarg);
+                break;
+            case('K'):
+                dram_config.access_cycles = atoi(optarg);
+                break;
+            case('U'):
+                partition_config.interval = optarg ? strtoull(optarg,NULL,0) : 1000000;
+                if(!partition_config.interval)
+                    partition_config.interval = 1000000;
+                partitioned = 1;
+                break;
+            case('h'):
+                hotspots = optarg ? atoi(optarg) : 16;
+                if(!hotspots)
+                    hotspots = 16;
+                break;
+            default:
+                printf("Invalid arguments!");
+                exit(0);
         }
-    return hit;
-}
+    }
+    //positional arguments follow the options
+    argc -= optind - 1;
+    argv += optind - 1;
 
-int 
-main (int argc, char *argv[])
-{
-    if(argc < 10) 
+    if(argc < 11) 
     {
         printf("Invalid arguments!"); 
         exit(0);
@@ -447,6 +1112,11 @@ main (int argc, char *argv[])
     //assigning cli args
     char* inter = concat("CacheonlyTraces/Traces/", argv[1]);
     benchmark = concat(inter, ".trace");
+    if(import_format >= 0)
+    {
+        free(benchmark);
+        benchmark = concat(argv[1], "");
+    }
     accesses = atoi(argv[2]);
     
     size1 = atoi(argv[3]);
@@ -459,15 +1129,7 @@ main (int argc, char *argv[])
     line_size2 = atoi(argv[9]);
     victim_size2 = atoi(argv[10]);
 
-    unsigned block_offset1 = log2(line_size1);
-    unsigned block_offset2 = log2(line_size2);
-    unsigned total_lines1 = size1/line_size1;
-    unsigned total_lines2 = size2/line_size2;
-    unsigned n_sets1 = total_lines1/assoc1;
-    unsigned n_sets2 = total_lines2/assoc2;
     printf("%s\n",benchmark);
-    //printf("block_offset1 = %i, block_offset2 = %i, total_lines1 = %i, total_lines2 = %i, n_sets1 = %i, \nn_sets2 = %i, tag1 = %i, tag2 = %i\n",
-    //        block_offset1,block_offset2,total_lines1,total_lines2,n_sets1,n_sets2,tag1,tag2);
 
     if((size1 == 0) || (assoc1 == 0) || (line_size1 == 0) || (size2 == 0) || (assoc2 == 0) || (line_size2 == 0)) 
     {
@@ -475,193 +1137,453 @@ main (int argc, char *argv[])
         exit(0);
     }
 
-    // creating fully associative L1 and L2 caches with no victim cache.
-    cache_t* fa_L1 = init_cache(total_lines1,0);
-    cache_t* fa_L2 = init_cache(total_lines2,0);
-    fa_L1->type = fully_associative;
-    fa_L2->type = fully_associative;
+    cachesim_config config;
+    config.n_levels = 2;
+    config.level[0] = (cachesim_level_config){size1, assoc1, line_size1, victim_size1, index_fns[0]};
+    config.level[1] = (cachesim_level_config){size2, assoc2, line_size2, victim_size2, index_fns[1]};
+    cachesim* sim = cachesim_create(&config);
+    if(!sim)
+    {
+        printf("Unable to create cache hierarchy\n");
+        exit(0);
+    }
 
-    cache_t *L1, *L2;
-    if(assoc1-1)
+    if(hotspots && cachesim_enable_hotspots(sim,hotspots))
     {
-        L1 = init_assoc_cache(size1/line_size1,assoc1,victim_size1);
-        L1->type = associative;
+        printf("Unable to allocate hotspot profile\n");
+        exit(0);
     }
-    else
-        L1 = init_cache(size1/line_size1,victim_size1);
-    if(assoc2-1)
+
+    if(slice_config.slices && (hotspots || perf_period || interval || (threads > 1) || pipelined))
     {
-        L2 = init_assoc_cache(size2/line_size2,assoc2,victim_size2);
-        L2->type = associative;
+        printf("--slices cannot be combined with other execution or profiling modes\n");
+        exit(0);
     }
-    else
-        L2 = init_cache(size2/line_size2,victim_size2);
 
-    if((total_lines1 == assoc1)&&(!(assoc1 - 1)))
-        L1->type = fully_associative;
-    else if(!(assoc1-1))
-        L1->type = direct_mapped;
+    cachesim_timing* timing = NULL;
+    if(timed)
+    {
+        if(slice_config.slices || perf_period || (threads > 1) || pipelined)
+        {
+            printf("--timing cannot be combined with --slices, --perf, --threads or --pipeline\n");
+            exit(0);
+        }
+        //a miss spends the lookup time of each level it passes by default
+        if(!penalty_set)
+            memcpy(timing_config.miss_penalty,timing_config.hit_latency,sizeof(timing_config.miss_penalty));
+        timing = cachesim_timing_create(sim,&timing_config);
+        if(!timing)
+        {
+            printf("Unable to allocate timing model\n");
+            exit(0);
+        }
+    }
 
-    if((total_lines2 == assoc2)&&(!(assoc2 - 1)))
-        L2->type = fully_associative;
-    else if(!(assoc2-1))
-        L2->type = direct_mapped;
-    
+    if(stream_dir && (timed || hotspots || perf_period || interval || (threads > 1) || pipelined || slice_config.slices))
+    {
+        printf("--l1-stream cannot be combined with other execution or profiling modes\n");
+        exit(0);
+    }
 
-    unsigned index_bits1=0,index_bits2 =0;
-    unsigned tag_bits1 =0,tag_bits2 = 0;
-    if((!(assoc1-1)))
+    if(skip && !n_ranges)
+    {
+        ranges[0] = (trace_range){skip, skip + accesses};
+        n_ranges = 1;
+    }
+    if((n_ranges || index_interval) && (stream_dir || timed || hotspots || perf_period || interval ||
+                                        (threads > 1) || pipelined || slice_config.slices))
     {
-        if(L1->type==direct_mapped)
+        printf("--skip, --range and --build-index cannot be combined with other execution or profiling modes\n");
+        exit(0);
+    }
+    if(n_ranges && index_interval)
+    {
+        printf("--build-index cannot be combined with --skip or --range\n");
+        exit(0);
+    }
+    //only modes whose output is the plain statistics can be served from the store
+    if(results_dir && (n_ranges || index_interval || stream_dir || timed || hotspots || perf_period || interval ||
+                       slice_config.slices))
+    {
+        printf("--results can only be combined with --threads or --pipeline\n");
+        exit(0);
+    }
+    if(partitioned)
+    {
+        if(n_ranges || index_interval || stream_dir || results_dir || (threads > 1) || pipelined || slice_config.slices)
         {
-            index_bits1 = log2(total_lines1);
-            tag_bits1 = ADDRESS_LEN - block_offset1 - index_bits1;
-        }else
-            tag_bits1 = ADDRESS_LEN - block_offset1;
+            printf("--tenants, --partition and --umon cannot be combined with --threads, --pipeline, --slices, "
+                   "--l1-stream, --skip, --range, --build-index or --results\n");
+            exit(0);
+        }
+        if((n_tenants > 1) && (timed || perf_period || interval))
+        {
+            printf("--tenants cannot be combined with --timing, --perf or --interval\n");
+            exit(0);
+        }
+        //classes follow the tenants, masks given for more classes add empty ones
+        tenants[0] = argv[1];
+        for(unsigned c = n_tenants;c < partition_config.n_classes;++c)
+            tenants[c] = "-";
+        if(partition_config.n_classes < n_tenants)
+            partition_config.n_classes = n_tenants;
+        //the monitors sample about 32 sets, as many as utility-based partitioning needs
+        cachesim_geometry l2;
+        cachesim_get_geometry(sim,1,&l2);
+        partition_config.level = 1;
+        partition_config.sample_shift = l2.index_bits > 5 ? l2.index_bits - 5 : 0;
+        if(cachesim_enable_partitions(sim,&partition_config))
+        {
+            printf("Unable to partition L2: it needs 2 to 64 ways, at least one per class with --umon, and masks "
+                   "within them\n");
+            exit(0);
+        }
+    }
+    //imported traces are read once, front to back
+    if((import_format >= 0) && (n_ranges || index_interval || stream_dir || results_dir || slice_config.slices ||
+                                (n_tenants > 1)))
+    {
+        printf("--format cannot be combined with --slices, --l1-stream, --skip, --range, --build-index, --results "
+               "or --tenants\n");
+        exit(0);
     }
-    unsigned faL1_tag = ADDRESS_LEN - block_offset1;
-    if((!(assoc2-1)))
+    if(following && (import_format >= 0 || partitioned || n_ranges || index_interval || stream_dir || results_dir ||
+                     timed || hotspots || perf_period || interval || (threads > 1) || pipelined || slice_config.slices))
     {
-        if(L2->type==direct_mapped)
+        printf("--follow cannot be combined with other execution or profiling modes\n");
+        exit(0);
+    }
+    //events come from the drivers that run the full hierarchy in access order
+    if(event_path)
+    {
+        if(stream_dir || results_dir || (threads > 1) || slice_config.slices)
         {
-            index_bits2 = log2(total_lines2);
-            tag_bits2 = ADDRESS_LEN - block_offset2 - index_bits2;
-        }else
-            tag_bits2 = ADDRESS_LEN - block_offset2;
+            printf("--events cannot be combined with --threads, --slices, --l1-stream or --results\n");
+            exit(0);
+        }
+        if(cachesim_log_events(sim,event_path,event_levels,event_types))
+        {
+            printf("Unable to open event log %s\n",event_path);
+            exit(0);
+        }
     }
-    unsigned faL2_tag = ADDRESS_LEN - block_offset1;
-    if((assoc1-1))
+    //the controller sees the misses of the drivers that run L2 in access order
+    if(dram)
     {
-        L1->n = n_sets1;
-        index_bits1 = log2(L1->n);
-        tag_bits1 = ADDRESS_LEN - block_offset1 - index_bits1;
+        if(stream_dir || results_dir || n_ranges || index_interval || (threads > 1) || slice_config.slices)
+        {
+            printf("--dram cannot be combined with --threads, --slices, --l1-stream, --skip, --range, "
+                   "--build-index or --results\n");
+            exit(0);
+        }
+        if(cachesim_enable_dram(sim,&dram_config))
+        {
+            printf("Unable to model DRAM: channels, ranks, banks and row size must be powers of two, rows at "
+                   "least a line and the queue at least 1\n");
+            exit(0);
+        }
     }
-    
-    if((assoc2-1))
+    //the plain hierarchy beside it only follows the main loop
+    cachesim* plain = NULL;
+    if(deadblock)
     {
-        L2->n = n_sets2;
-        index_bits2 = log2(L2->n);
-        tag_bits2 = ADDRESS_LEN - block_offset2 - index_bits2;
+        if(partitioned || following || stream_dir || results_dir || n_ranges || index_interval || (threads > 1) ||
+           pipelined || slice_config.slices)
+        {
+            printf("--deadblock cannot be combined with --threads, --pipeline, --slices, --l1-stream, --skip, "
+                   "--range, --build-index, --results, --tenants, --partition, --umon or --follow\n");
+            exit(0);
+        }
+        if(cachesim_enable_deadblock(sim,&deadblock_config) || !(plain = cachesim_create(&config)))
+        {
+            printf("Unable to predict dead blocks: L2 must be set-associative and not skewed, regions at most "
+                   "2^31 bytes\n");
+            exit(0);
+        }
     }
-    
-    printf("index bits1 = %i\tindex bits2 = %i\n",index_bits1,index_bits2);
-    
-
-    
+    //the bound replays the prefix of the native trace the other modes start from
+    if(opt_bound && (import_format >= 0 || following || (n_tenants > 1) || n_ranges || index_interval))
+    {
+        printf("--opt cannot be combined with --format, --follow, --tenants, --skip, --range or --build-index\n");
+        exit(0);
+    }
+    char* default_index = concat(benchmark,".idx");
+    if(!index_path)
+        index_path = default_index;
 
-    FILE* fin;
-    fin = fopen(benchmark, "rb");
-    if(fin == 0) { printf("Unable to open trace file\n"); exit(0); }
-
-    uint32_t address = 0;
-                                
-    char operation = 0;
-
-    for(unsigned int i=0; i<accesses; i++)
-    {
-        address_info L1_info = {0,0,0,0};
-        address_info L2_info = {0,0,0,0};
-        address_info L1af_info = {0,0,0,0};
-        address_info L2af_info = {0,0,0,0};
-//        printf("L1 stats:\nindex length:%x\ntag length: %x\nblock offset: %x\nline size: %x\n",index_bits1,tag_bits1,block_offset1,line_size1);
- //       printf("L2 stats:\nindex length:%x\ntag length: %x\nblock offset: %x\nline size: %x\n",index_bits2,tag_bits2,block_offset2,line_size2);
-        
-        //address is 4 bytes (int)
-        fread(&address, 1, 4, fin);
-        
-        //operation is 1 byte (char)
-        fread(&operation, 1, 1, fin);
-        /* 
-        * the variable ‘address’ now contains the address of the data being
-        * accessed, while the variable ‘operation’ contains the values ‘r’ for
-        * a read or ‘w’ for a write. 
-        */
-        
-        L1_info.block_offset = address & get_mask(block_offset1);
-        L1_info.tag = (address & (get_mask(tag_bits1)<<(block_offset1+index_bits1)))>>(block_offset1+index_bits1);
-        if(index_bits1)
-            L1_info.index = (address & (get_mask(index_bits1)<<block_offset1))>>block_offset1;
-        L1_info.fa_tag = faL1_tag;
-
-        L2_info.block_offset = address & get_mask(block_offset2);
-        L2_info.tag= (address & (get_mask(tag_bits2)<<(block_offset2+index_bits2)))>>(block_offset2+index_bits2);
-        if(index_bits2)
-            L2_info.index = (address & (get_mask(index_bits2)<<block_offset2))>>block_offset2;
-        L2_info.fa_tag = faL2_tag;
-
-        L1af_info.block_offset = L1_info.block_offset;       
-        L1af_info.tag = faL1_tag;
-        L1af_info.fa_tag = faL1_tag;
-        L1af_info.index = 0;
-
-        L2af_info.block_offset = L2_info.block_offset;       
-        L2af_info.tag = faL2_tag;
-        L2af_info.fa_tag = faL2_tag;
-        L2af_info.index = 0;
-
-       // printf("Address:%x\n L1: lines:%u tag: %x, block_offset:%x, index: %x\n L2:tag: %x,block offset %x, index %x\n\n",
-       //        address,L1->n,L1_info.tag,L1_info.block_offset,L1_info.index,L2_info.tag,L2_info.block_offset,L2_info.index);
-        switch(operation)
+    cachesim_parallel* parallel = NULL;
+    if(threads > 1)
+    {
+        if(hotspots || perf_period)
         {
-            case('r'):
-                //if returns successful read
-                access_cache(fa_L1,L1af_info,operation);
-                access_cache(fa_L2,L2af_info,operation);
-                if(access_cache(L1,L1_info,operation))
-                    break;
-                else
-                {
-                    //if missed go through victim cache then L2
-                    //access_cache(L1->victim,L1af_info,operation);
-                    access_cache(L2,L2_info,operation);
-                }
-                break;
-            case('w'):
-                access_cache(fa_L1,L1af_info,operation);
-                access_cache(fa_L2,L2af_info,operation);
-                if(access_cache(L1,L1_info,operation))
-                    break;
-                else
-                {
-                    //if missed go through victim cache then L2
-                    //access_cache(L1->victim,L1af_info,operation);
-                    access_cache(L2,L2_info,operation);
+            printf("--threads cannot be combined with --hotspots or --perf\n");
+            exit(0);
+        }
+        parallel = cachesim_parallel_create(sim,threads);
+        if(!parallel)
+        {
+            printf("Unable to start %u threads (a skewed-associative level cannot be split)\n",threads);
+            exit(0);
+        }
+    }
+    cachesim_pipeline* pipeline = NULL;
+    if(pipelined)
+    {
+        if(parallel || perf_period)
+        {
+            printf("--pipeline cannot be combined with --threads or --perf\n");
+            exit(0);
+        }
+        pipeline = cachesim_pipeline_create(sim);
+        if(!pipeline)
+        {
+            printf("Unable to start the pipeline threads\n");
+            exit(0);
+        }
+    }
 
-                }
+    cachesim_geometry geometry1, geometry2;
+    cachesim_get_geometry(sim,0,&geometry1);
+    cachesim_get_geometry(sim,1,&geometry2);
+    printf("index bits1 = %i\tindex bits2 = %i\n",geometry1.index_bits,geometry2.index_bits);
 
-                break;
+    FILE* fin = NULL;
+    trace_reader* reader = NULL;
+    if(import_format >= 0)
+        reader = trace_reader_open(benchmark,import_format,ifetch);
+    else
+        fin = fopen(benchmark, "rb");
+    if((fin == 0) && (reader == 0)) { printf("Unable to open trace file\n"); exit(0); }
+
+    perf_ctx perf;
+    memset(&perf,0,sizeof(perf));
+    if(perf_period)
+        perf_init(&perf,perf_period);
+
+    interval_ctx intervals;
+    ssize_t interval_now[INTERVAL_LEVELS][INTERVAL_FIELDS];
+    unsigned interval_left = interval;
+    if(interval && interval_open(&intervals,interval_path,interval))
+    {
+        printf("Unable to open interval file %s\n",interval_path);
+        exit(0);
+    }
+
+    /* 
+    * each record is a 4 byte address followed by ‘r’ for a read or ‘w’ for
+    * a write; records are read a block at a time and the block is cut short
+    * at interval boundaries so snapshots land on exact access counts
+    */
+    size_t block_records = (parallel || pipeline) ? PARALLEL_BLOCK : TRACE_BLOCK;
+    unsigned char* block = malloc(block_records*CACHESIM_RECORD_SIZE);
+    size_t left = accesses;
+    if(slice_config.slices)
+    {
+        run_time_sliced(sim,fin,accesses,&slice_config,reference);
+        left = 0;
+    }
+    result_key key;
+    result_value stored;
+    int stored_hit = 0;
+    if(results_dir)
+    {
+        memset(&key,0,sizeof(key));
+        mkdir(results_dir,0777);
+        if(results_trace_hash(results_dir,benchmark,accesses,&key.trace_hash))
+            results_dir = NULL;
+        key.accesses = accesses;
+        key.version = CACHESIM_VERSION;
+        cachesim_get_config(sim,&key.config);
+        if(results_dir && !results_lookup(results_dir,&key,&stored))
+        {
+            stored_hit = 1;
+            left = 0;
         }
-        ++total_cache_accesses;
-        // on read miss, access victim cache THEN L2
-        // on write miss, access L2
-        // check through L1 first 
-        
-        //now, check the address against index_bits1 = log2(ASSOC_cache(L1)->n_sets); the L1 address. If equal, hit. else, got to L1 victim and check
+    }
 
-        //the largest address below the one you need that is multiple of 64 is the cache line
-        //EX: 16384 cache size in bytes, line size of 64B, we have 256 lines. With a
-        
-        //printf("address: %u operation: %c\n", address, operation);
-        //printf("i=%d\n",i);
-        
+    cache_stats range_stats[2];
+    size_t range_accesses = 0;
+    if(n_ranges)
+    {
+        range_accesses = run_ranges(sim,fin,benchmark,index_path,ranges,n_ranges,range_stats);
+        left = 0;
+    }
+    if(index_interval)
+    {
+        if(trace_index_build(index_path,benchmark,sim,index_interval,accesses))
+            printf("Unable to write index %s\n",index_path);
+        left = 0;
+    }
+    if(n_tenants > 1)
+    {
+        FILE* tenant_fins[CACHESIM_MAX_CLASSES] = {fin};
+        for(unsigned t = 1;t < n_tenants;++t)
+        {
+            char* path = malloc(strlen(tenants[t]) + 64);
+            sprintf(path,"CacheonlyTraces/Traces/%s.trace",tenants[t]);
+            tenant_fins[t] = fopen(path,"rb");
+            free(path);
+            if(!tenant_fins[t])
+            {
+                printf("Unable to open trace file\n");
+                exit(0);
+            }
+        }
+        run_tenants(sim,tenant_fins,n_tenants,accesses,quantum);
+        for(unsigned t = 1;t < n_tenants;++t)
+            fclose(tenant_fins[t]);
+        left = 0;
+    }
+    if(following)
+    {
+        run_follow(sim,benchmark,accesses,follow_cadence,follow_idle);
+        left = 0;
+    }
+    cachesim_filter* stream = NULL;
+    if(stream_dir)
+        stream = open_l1_stream(sim,stream_dir,argv[1],benchmark,accesses,&left);
+    while(left)
+    {
+        size_t want = left < block_records ? left : block_records;
+        if(interval && (want > interval_left))
+            want = interval_left;
+        if(perf_period)
+            perf_read_begin(&perf);
+        size_t got = reader ? trace_reader_read(reader,block,want) : fread(block,CACHESIM_RECORD_SIZE,want,fin);
+        if(perf_period)
+            perf_read_end(&perf,got);
+        if(parallel)
+        {
+            if(got && !cachesim_parallel_run_trace(parallel,block,got))
+            {
+                printf("Unable to allocate --threads work buffers\n");
+                exit(0);
+            }
+        }
+        else if(pipeline)
+            cachesim_pipeline_run_trace(pipeline,block,got);
+        else if(timing)
+            cachesim_run_trace_timed(sim,timing,block,got);
+        else if(stream)
+            cachesim_run_trace_filtered(sim,stream,block,got);
+        else if(perf_period)
+            cachesim_run_trace_perf(sim,block,got,&perf);
+        else
+            cachesim_run_trace(sim,block,got);
+        if(plain)
+            cachesim_run_trace(plain,block,got);
+        left -= got;
+        if(interval && !(interval_left -= got))
+        {
+            collect_interval(interval_now,sim);
+            interval_snapshot(&intervals,cachesim_accesses(sim),interval_now);
+            interval_left = interval;
+        }
+        //trace ended before the requested number of accesses
+        if(got < want)
+            break;
+    }
+    free(block);
+    if(fin)
+        fclose(fin);
+    if(reader)
+    {
+        if(trace_reader_rejected(reader))
+            printf("skipped %llu malformed trace lines\n",(unsigned long long)trace_reader_rejected(reader));
+        trace_reader_close(reader);
+    }
+    if(stream && cachesim_filter_close(stream,sim))
+        printf("L1 stream: unable to write the stream\n");
+    if(results_dir && !stored_hit)
+    {
+        memset(&stored,0,sizeof(stored));
+        stored.accesses = cachesim_accesses(sim);
+        for(unsigned l = 0;l < cachesim_levels(sim);++l)
+            cachesim_get_stats(sim,l,&stored.stats[l]);
+        results_store(results_dir,&key,&stored,results_max);
+    }
+    cachesim_parallel_destroy(parallel);
+    cachesim_pipeline_destroy(pipeline);
+    cache_stats opt_stats[2];
+    int opt_failed = opt_bound && run_opt(&config,benchmark,accesses,opt_stats);
+    if(interval)
+    {
+        collect_interval(interval_now,sim);
+        interval_close(&intervals,cachesim_accesses(sim),interval_now);
     }
-    fclose(fin);
     free(inter);
     free(benchmark);
-    printf("total cache accesses:%zu\n",total_cache_accesses);
-    printf("L1 hits: %zu\tmiss:%zu\tcold:%zu\nL2:hits: %zu\tmiss:%zu\tcold:%zu\n\n",L1->stats.hits,
-            L1->stats.total_misses,L1->stats.cold_misses,L2->stats.hits,L2->stats.total_misses,L2->stats.cold_misses);
-    deinit_cache(fa_L1);
-    deinit_cache(fa_L2);
-    if(L1->type == associative)
-        deinit_assoc_cache(L1);
-    else
-        deinit_cache(L1);
+    free(default_index);
 
-    if(L2->type == associative)
-        deinit_assoc_cache(L2);
-    else
-        deinit_cache(L2);
+    cache_stats L1, L2;
+    size_t total_accesses = cachesim_accesses(sim);
+    cachesim_get_stats(sim,0,&L1);
+    cachesim_get_stats(sim,1,&L2);
+    if(n_ranges)
+    {
+        L1 = range_stats[0];
+        L2 = range_stats[1];
+        total_accesses = range_accesses;
+    }
+    if(stored_hit)
+    {
+        L1 = stored.stats[0];
+        L2 = stored.stats[1];
+        total_accesses = stored.accesses;
+    }
+    printf("total cache accesses:%zu\n",total_accesses);
+    printf("L1 hits: %zu\tmiss:%zu\tcold:%zu\nL2:hits: %zu\tmiss:%zu\tcold:%zu\n\n",L1.hits,
+            L1.total_misses,L1.cold_misses,L2.hits,L2.total_misses,L2.cold_misses);
+    if(report_memory)
+    {
+        static const char* pages[] = {"4kB pages", "transparent huge pages", "explicit huge pages"};
+        cachesim_memory memory;
+        cachesim_get_memory(sim,&memory);
+        printf("model memory: %zu bytes used, %zu reserved, %s\n\n",memory.used,memory.reserved,
+                pages[memory.huge_pages]);
+    }
+    if(opt_bound && opt_failed)
+        printf("OPT: unable to read the trace into memory or a level is skewed-associative\n\n");
+    else if(opt_bound)
+    {
+        printf("OPT L1 hits: %zd\tmiss:%zd\tcold:%zd\t(%.1f%% of LRU misses)\n",opt_stats[0].hits,
+                opt_stats[0].total_misses,opt_stats[0].cold_misses,
+                L1.total_misses ? 100.0*opt_stats[0].total_misses/L1.total_misses : 100.0);
+        printf("OPT L2 hits: %zd\tmiss:%zd\tcold:%zd\t(%.1f%% of LRU misses)\n\n",opt_stats[1].hits,
+                opt_stats[1].total_misses,opt_stats[1].cold_misses,
+                L2.total_misses ? 100.0*opt_stats[1].total_misses/L2.total_misses : 100.0);
+    }
+    if(partitioned)
+        report_classes(sim,tenants);
+    if(event_path)
+    {
+        uint64_t events;
+        if(cachesim_log_close(sim,&events))
+            printf("event log: unable to write %s\n\n",event_path);
+        else
+            printf("event log: %llu events in %s\n\n",(unsigned long long)events,event_path);
+    }
+    if(dram)
+        report_dram(sim);
+    if(deadblock)
+    {
+        report_deadblock(sim,plain,deadblock_config.policy);
+        cachesim_destroy(plain);
+    }
+    if(timing)
+    {
+        report_timing(timing);
+        cachesim_timing_destroy(timing);
+    }
+    if(hotspots)
+        report_hotspots(sim,hotspots);
+    if(perf_period)
+    {
+        perf_report(&perf);
+        perf_deinit(&perf);
+    }
+    cachesim_destroy(sim);
+    free(tenant_list);
 
     return 0;
 }
@@ -0,0 +1,118 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "allassoc.h"
+
+struct all_assoc
+{
+    unsigned line_bits;
+    unsigned min_set_bits;
+    unsigned n_counts;          // set counts 2^min_set_bits ... 2^max_set_bits
+    unsigned max_ways;
+    uint32_t** stacks;          // [count][set*max_ways + depth], most recent first
+    uint8_t** depth;            // [count][set] lines in each stack
+    uint64_t* hits;             // [count*max_ways + d] accesses found at depth d
+    uint64_t accesses;
+};
+
+all_assoc*
+all_assoc_create(unsigned line_bits,unsigned min_set_bits,unsigned max_set_bits,unsigned max_ways)
+{
+    if(min_set_bits > max_set_bits || max_set_bits > 24 || !max_ways || max_ways > 255 || line_bits > 31)
+        return NULL;
+    all_assoc* a = calloc(1,sizeof(all_assoc));
+    if(!a)
+        return NULL;
+    a->line_bits = line_bits;
+    a->min_set_bits = min_set_bits;
+    a->n_counts = max_set_bits - min_set_bits + 1;
+    a->max_ways = max_ways;
+    a->stacks = calloc(a->n_counts,sizeof(uint32_t*));
+    a->depth = calloc(a->n_counts,sizeof(uint8_t*));
+    a->hits = calloc((size_t)a->n_counts*max_ways,sizeof(uint64_t));
+    if(!a->stacks || !a->depth || !a->hits)
+    {
+        all_assoc_destroy(a);
+        return NULL;
+    }
+    for(unsigned c = 0;c < a->n_counts;++c)
+    {
+        size_t sets = (size_t)1 << (min_set_bits + c);
+        a->stacks[c] = malloc(sets*max_ways*sizeof(uint32_t));
+        a->depth[c] = calloc(sets,sizeof(uint8_t));
+        if(!a->stacks[c] || !a->depth[c])
+        {
+            all_assoc_destroy(a);
+            return NULL;
+        }
+    }
+    return a;
+}
+
+void
+all_assoc_destroy(all_assoc* a)
+{
+    if(!a)
+        return;
+    for(unsigned c = 0;a->stacks && c < a->n_counts;++c)
+    {
+        free(a->stacks[c]);
+        free(a->depth[c]);
+    }
+    free(a->stacks);
+    free(a->depth);
+    free(a->hits);
+    free(a);
+}
+
+void
+all_assoc_access(all_assoc* a,uint32_t address)
+{
+    uint32_t line = a->line_bits < 32 ? address >> a->line_bits : 0;
+    ++a->accesses;
+    for(unsigned c = 0;c < a->n_counts;++c)
+    {
+        uint32_t set = line & ((1u << (a->min_set_bits + c)) - 1);
+        uint32_t* stack = a->stacks[c] + (size_t)set*a->max_ways;
+        uint8_t* n = &a->depth[c][set];
+        unsigned d = 0;
+        while(d < *n && stack[d] != line)
+            ++d;
+        if(d < *n)
+        {
+            ++a->hits[c*a->max_ways + d];
+            // already most recent here, so in every larger set count as well
+            if(!d)
+            {
+                for(unsigned k = c + 1;k < a->n_counts;++k)
+                    ++a->hits[k*a->max_ways];
+                return;
+            }
+        }
+        else if(*n < a->max_ways)
+            ++*n;
+        else
+            d = a->max_ways - 1;
+        memmove(stack + 1,stack,d*sizeof(uint32_t));
+        stack[0] = line;
+    }
+}
+
+uint64_t
+all_assoc_hits(const all_assoc* a,unsigned set_bits,unsigned ways)
+{
+    if(set_bits < a->min_set_bits || set_bits - a->min_set_bits >= a->n_counts || ways > a->max_ways)
+        return 0;
+    const uint64_t* hits = a->hits + (set_bits - a->min_set_bits)*a->max_ways;
+    uint64_t total = 0;
+    for(unsigned d = 0;d < ways;++d)
+        total += hits[d];
+    return total;
+}
+
+uint64_t
+all_assoc_accesses(const all_assoc* a)
+{
+    return a->accesses;
+}
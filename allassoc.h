@@ -0,0 +1,32 @@
+#ifndef ALLASSOC_H
+#define ALLASSOC_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * All-associativity simulation (Hill and Smith): one pass over a trace
+ * gives the LRU hits of every cache with 2^k sets, min_set_bits <= k <=
+ * max_set_bits, and 1 to max_ways ways, for one line size and bit-selection
+ * indexing.
+ *
+ * Each set count keeps a recency stack per set, truncated at max_ways; an
+ * access found at depth d hits in every cache of that set count with more
+ * than d ways. With bit selection the sets of 2^(k+1) refine those of 2^k,
+ * so a line's depth never grows with the set count: an access at the top
+ * of a stack is at the top of every larger set count's stack too and the
+ * pass stops there.
+ */
+
+typedef struct all_assoc all_assoc;
+
+// NULL if the set count range or ways are invalid or memory runs out
+all_assoc* all_assoc_create(unsigned,unsigned,unsigned,unsigned);
+void all_assoc_destroy(all_assoc*);
+void all_assoc_access(all_assoc*,uint32_t);
+
+// hits of the cache with 2^set_bits sets and ways ways, 0 outside the range
+uint64_t all_assoc_hits(const all_assoc*,unsigned,unsigned);
+uint64_t all_assoc_accesses(const all_assoc*);
+
+#endif
@@ -0,0 +1,70 @@
+#include <stdint.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#include "arena.h"
+
+#define ARENA_ALIGN 16
+
+int
+arena_init(cache_arena* arena,size_t size)
+{
+    memset(arena,0,sizeof(cache_arena));
+    if(size < ARENA_HUGE_PAGE/2)
+    {
+        // a huge page would mostly sit empty
+        size = (size + 4095) & ~(size_t)4095;
+        void* base = mmap(NULL,size,PROT_READ | PROT_WRITE,MAP_PRIVATE | MAP_ANONYMOUS,-1,0);
+        if(base == MAP_FAILED)
+            return -1;
+        arena->base = base;
+        arena->size = size;
+        return 0;
+    }
+    size = (size + ARENA_HUGE_PAGE - 1) & ~(size_t)(ARENA_HUGE_PAGE - 1);
+
+#ifdef MAP_HUGETLB
+    void* base = mmap(NULL,size,PROT_READ | PROT_WRITE,MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB,-1,0);
+    if(base != MAP_FAILED)
+    {
+        arena->base = base;
+        arena->size = size;
+        arena->pages = ARENA_EXPLICIT_HUGE;
+        return 0;
+    }
+#endif
+
+    // over-map by one huge page and trim so the arena starts 2MB aligned
+    unsigned char* raw = mmap(NULL,size + ARENA_HUGE_PAGE,PROT_READ | PROT_WRITE,MAP_PRIVATE | MAP_ANONYMOUS,-1,0);
+    if(raw == MAP_FAILED)
+        return -1;
+    unsigned char* aligned = (unsigned char*)(((uintptr_t)raw + ARENA_HUGE_PAGE - 1) & ~(uintptr_t)(ARENA_HUGE_PAGE - 1));
+    if(aligned > raw)
+        munmap(raw,aligned - raw);
+    munmap(aligned + size,raw + ARENA_HUGE_PAGE - aligned);
+    arena->base = aligned;
+    arena->size = size;
+#ifdef MADV_HUGEPAGE
+    if(!madvise(aligned,size,MADV_HUGEPAGE))
+        arena->pages = ARENA_TRANSPARENT_HUGE;
+#endif
+    return 0;
+}
+
+void*
+arena_alloc(cache_arena* arena,size_t size)
+{
+    size_t at = (arena->used + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+    if(at + size > arena->size)
+        return NULL;
+    arena->used = at + size;
+    return arena->base + at;
+}
+
+void
+arena_release(cache_arena* arena)
+{
+    if(arena->base)
+        munmap(arena->base,arena->size);
+    memset(arena,0,sizeof(cache_arena));
+}
@@ -0,0 +1,38 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+/*
+ * Bump allocator for the model state of one hierarchy.
+ *
+ * The whole arena is one anonymous mapping sized up front: explicit huge
+ * pages when the system has them reserved, otherwise normal pages aligned
+ * to 2MB with transparent huge pages requested. Arenas under 1MB use
+ * normal pages only. Memory comes back zeroed,
+ * allocations are never freed individually and releasing the arena is a
+ * single munmap.
+ */
+
+#define ARENA_HUGE_PAGE (2u << 20)
+
+typedef enum
+{
+    ARENA_SMALL_PAGES = 0,
+    ARENA_TRANSPARENT_HUGE,
+    ARENA_EXPLICIT_HUGE
+}arena_pages;
+
+typedef struct
+{
+    unsigned char* base;
+    size_t size;            // mapped bytes
+    size_t used;
+    arena_pages pages;
+}cache_arena;
+
+int arena_init(cache_arena*,size_t);
+void* arena_alloc(cache_arena*,size_t);
+void arena_release(cache_arena*);
+
+#endif
@@ -0,0 +1,687 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <limits.h>
+
+#include "cache.h"
+
+//produce number for masking to get certain bits
+unsigned
+get_mask(unsigned length)
+{
+    unsigned mask = pow(2,length) - 1;
+    return mask;
+}
+//get address bit length
+unsigned
+get_address_len(unsigned address)
+{
+    unsigned bits=0;
+    while(address)
+    {
+        address>>=1;
+        ++bits;
+    }
+    return bits;
+}
+
+
+
+// arena bytes for n bytes of one allocation, rounded as arena_alloc does
+static size_t
+padded(size_t n)
+{
+    return (n + 15) & ~(size_t)15;
+}
+
+/*
+ * arena bytes init_assoc_cache (associativity > 1) or init_cache takes
+ */
+size_t
+cache_bytes(unsigned n_lines,unsigned associativity,unsigned victim)
+{
+    size_t bytes = padded(sizeof(cache_t)) + padded(n_lines*sizeof(cache_line));
+    if(associativity > 1)
+        bytes += padded((n_lines/associativity)*sizeof(cache_t));
+    if(victim)
+        bytes += cache_bytes(victim/n_lines,1,0);
+    return bytes;
+}
+
+/*
+ * initializing set-associative cache; the arena hands out zeroed memory,
+ * so every line starts invalid with no stats. The lines of all sets are
+ * one contiguous array, set by set
+ */
+cache_t*
+init_assoc_cache(cache_arena* arena,unsigned n_lines, unsigned associativity,unsigned victim)
+{
+    cache_t* cache = arena_alloc(arena,sizeof(cache_t));
+    unsigned n_sets = n_lines/associativity;
+    cache_t* sets = arena_alloc(arena,n_sets*sizeof(cache_t));
+    cache_line* lines = arena_alloc(arena,(size_t)n_sets*associativity*sizeof(cache_line));
+    if(!cache || !sets || !lines)
+        return NULL;
+    cache->n = n_sets;
+    cache->lines = NULL;
+    cache->sets = sets;
+    //initialize each set of cache
+    for(int i = 0; i < n_sets;++i)
+    {
+        cache->sets[i].n = associativity;
+        cache->sets[i].lines = lines + (size_t)i*associativity;
+    }
+    if(victim && !(cache->victim = init_cache(arena,victim/n_lines,0)))
+        return NULL;
+    return cache;
+}
+
+/*
+ * initializing both-direct mapped and fully-associative
+ */
+cache_t*
+init_cache(cache_arena* arena,unsigned n_lines,unsigned victim)
+{
+    cache_t* cache = arena_alloc(arena,sizeof(cache_t));
+    cache_line* lines = arena_alloc(arena,n_lines*sizeof(cache_line));
+    if(!cache || !lines)
+        return NULL;
+    cache->n = n_lines;
+    cache->lines = lines;
+    if(victim && !(cache->victim = init_cache(arena,victim/n_lines,0)))
+        return NULL;
+    cache->sets = NULL;
+    return cache;
+}
+
+static size_t
+shadow_map_size(unsigned n_lines)
+{
+    size_t size = 16;
+    while(size < 2*(size_t)n_lines)
+        size *= 2;
+    return size;
+}
+
+/*
+ * arena bytes init_shadow_cache takes
+ */
+size_t
+shadow_bytes(unsigned n_lines)
+{
+    return cache_bytes(n_lines,1,0) + padded(sizeof(shadow_order)) + padded(shadow_map_size(n_lines)*sizeof(uint32_t)) +
+           2*padded(n_lines*sizeof(uint32_t));
+}
+
+static void shadow_rebuild(cache_t*);
+
+/*
+ * fully associative shadow of a level: LRU over all its lines, with the
+ * lookup and LRU order kept beside the lines
+ */
+cache_t*
+init_shadow_cache(cache_arena* arena,unsigned n_lines)
+{
+    cache_t* cache = init_cache(arena,n_lines,0);
+    if(!cache)
+        return NULL;
+    shadow_order* order = arena_alloc(arena,sizeof(shadow_order));
+    size_t map_size = shadow_map_size(n_lines);
+    if(!order || !(order->map = arena_alloc(arena,map_size*sizeof(uint32_t))) ||
+       !(order->prev = arena_alloc(arena,n_lines*sizeof(uint32_t))) ||
+       !(order->next = arena_alloc(arena,n_lines*sizeof(uint32_t))))
+        return NULL;
+    order->mask = map_size - 1;
+    cache->type = fully_associative;
+    cache->order = order;
+    shadow_rebuild(cache);
+    return cache;
+}
+
+#define SHADOW_NONE UINT32_MAX
+
+static inline size_t
+shadow_hash(unsigned tag,size_t mask)
+{
+    return ((uint64_t)tag*0x9e3779b97f4a7c15ull >> 32) & mask;
+}
+
+// slot of the valid line with this tag, or of the empty slot where it would go
+static inline size_t
+shadow_find(const cache_t* cache,unsigned tag)
+{
+    const shadow_order* o = cache->order;
+    size_t i = shadow_hash(tag,o->mask);
+    while(o->map[i] && cache->lines[o->map[i] - 1].tag != tag)
+        i = (i + 1) & o->mask;
+    return i;
+}
+
+// remove the entry at slot i, shifting later entries of its probe run back
+static void
+shadow_erase(cache_t* cache,size_t i)
+{
+    shadow_order* o = cache->order;
+    size_t j = i;
+    for(;;)
+    {
+        j = (j + 1) & o->mask;
+        if(!o->map[j])
+            break;
+        size_t home = shadow_hash(cache->lines[o->map[j] - 1].tag,o->mask);
+        // the entry at j may move to i if i lies cyclically in [home, j)
+        if((j > i && (home <= i || home > j)) || (j < i && home <= i && home > j))
+        {
+            o->map[i] = o->map[j];
+            i = j;
+        }
+    }
+    o->map[i] = 0;
+}
+
+static inline void
+shadow_unlink(shadow_order* o,uint32_t x)
+{
+    if(o->prev[x] != SHADOW_NONE)
+        o->next[o->prev[x]] = o->next[x];
+    else
+        o->lru = o->next[x];
+    if(o->next[x] != SHADOW_NONE)
+        o->prev[o->next[x]] = o->prev[x];
+    else
+        o->mru = o->prev[x];
+}
+
+static inline void
+shadow_push_mru(shadow_order* o,uint32_t x)
+{
+    o->prev[x] = o->mru;
+    o->next[x] = SHADOW_NONE;
+    if(o->mru != SHADOW_NONE)
+        o->next[o->mru] = x;
+    else
+        o->lru = x;
+    o->mru = x;
+}
+
+// LRU order: invalid lines first, then by last use, ties by position
+static inline int
+shadow_before(const cache_line* lines,uint32_t a,uint32_t b)
+{
+    if(lines[a].valid != lines[b].valid)
+        return lines[b].valid;
+    if(lines[a].last_used_time != lines[b].last_used_time)
+        return lines[a].last_used_time < lines[b].last_used_time;
+    return a < b;
+}
+
+static void
+sift_down(const cache_line* lines,uint32_t* heap,size_t n,size_t i)
+{
+    for(;;)
+    {
+        size_t largest = i, l = 2*i + 1, r = 2*i + 2;
+        if(l < n && shadow_before(lines,heap[largest],heap[l]))
+            largest = l;
+        if(r < n && shadow_before(lines,heap[largest],heap[r]))
+            largest = r;
+        if(largest == i)
+            return;
+        uint32_t t = heap[i];
+        heap[i] = heap[largest];
+        heap[largest] = t;
+        i = largest;
+    }
+}
+
+/*
+ * derive lookup and LRU order from the lines, after a reset or a load;
+ * the map doubles as the sort buffer before it is filled
+ */
+static void
+shadow_rebuild(cache_t* cache)
+{
+    shadow_order* o = cache->order;
+    uint32_t* sorted = o->map;
+    size_t n = cache->n;
+    for(size_t i = 0;i < n;++i)
+        sorted[i] = i;
+    for(size_t i = n/2;i-- > 0;)
+        sift_down(cache->lines,sorted,n,i);
+    for(size_t end = n;end-- > 1;)
+    {
+        uint32_t t = sorted[0];
+        sorted[0] = sorted[end];
+        sorted[end] = t;
+        sift_down(cache->lines,sorted,end,0);
+    }
+    o->mru = o->lru = SHADOW_NONE;
+    for(size_t i = 0;i < n;++i)
+        shadow_push_mru(o,sorted[i]);
+    memset(o->map,0,(o->mask + 1)*sizeof(uint32_t));
+    for(uint32_t x = 0;x < n;++x)
+        if(cache->lines[x].valid)
+            o->map[shadow_find(cache,cache->lines[x].tag)] = x + 1;
+}
+
+static int
+shadow_access(cache_t* cache,address_info af,char op,ssize_t now)
+{
+    shadow_order* o = cache->order;
+    size_t i = shadow_find(cache,af.tag);
+    if(o->map[i])
+    {
+        uint32_t x = o->map[i] - 1;
+        cache->lines[x].dirty |= op == 'w';
+        cache->lines[x].last_used_time = now;
+        shadow_unlink(o,x);
+        shadow_push_mru(o,x);
+        ++cache->stats.hits;
+        return 1;
+    }
+    uint32_t x = o->lru;
+    cache_line* line = &cache->lines[x];
+    cache->evicted = *line;
+    if(line->valid)
+    {
+        shadow_erase(cache,shadow_find(cache,line->tag));
+        i = shadow_find(cache,af.tag);
+    }
+    else
+        ++cache->stats.cold_misses;
+    line->tag = af.tag;
+    line->valid = 1;
+    line->dirty = op == 'w';
+    line->last_used_time = now;
+    o->map[i] = x + 1;
+    shadow_unlink(o,x);
+    shadow_push_mru(o,x);
+    ++cache->stats.total_misses;
+    return 0;
+}
+
+/*
+ * invalidate every line and clear the stats, keeping the allocation
+ */
+void
+reset_cache(cache_t* cache)
+{
+    if(cache->sets)
+    {
+        for(int i = 0;i < cache->n;++i)
+            memset(cache->sets[i].lines,0,cache->sets[i].n*sizeof(cache_line));
+    }
+    else
+        memset(cache->lines,0,cache->n*sizeof(cache_line));
+    memset(&cache->stats,0,sizeof(cache_stats));
+    if(cache->order)
+        shadow_rebuild(cache);
+    if(cache->victim)
+        reset_cache(cache->victim);
+}
+
+/*
+ * copy the line state of src into dst; both must have the same geometry
+ */
+void
+copy_cache_state(cache_t* dst,const cache_t* src)
+{
+    if(src->sets)
+    {
+        for(int i = 0;i < src->n;++i)
+            memcpy(dst->sets[i].lines,src->sets[i].lines,src->sets[i].n*sizeof(cache_line));
+    }
+    else
+        memcpy(dst->lines,src->lines,src->n*sizeof(cache_line));
+    dst->stats = src->stats;
+    if(src->order)
+    {
+        shadow_order* o = dst->order;
+        memcpy(o->map,src->order->map,(o->mask + 1)*sizeof(uint32_t));
+        memcpy(o->prev,src->order->prev,src->n*sizeof(uint32_t));
+        memcpy(o->next,src->order->next,src->n*sizeof(uint32_t));
+        o->mru = src->order->mru;
+        o->lru = src->order->lru;
+    }
+    if(src->victim)
+        copy_cache_state(dst->victim,src->victim);
+}
+
+/*
+ * bytes save_cache_state writes for this cache
+ */
+size_t
+cache_state_size(const cache_t* cache)
+{
+    size_t size = sizeof(cache_stats);
+    if(cache->sets)
+    {
+        for(int i = 0;i < cache->n;++i)
+            size += cache->sets[i].n*sizeof(cache_line);
+    }
+    else
+        size += cache->n*sizeof(cache_line);
+    return cache->victim ? size + cache_state_size(cache->victim) : size;
+}
+
+/*
+ * serialize line state and stats; returns the end of what was written
+ */
+unsigned char*
+save_cache_state(const cache_t* cache,unsigned char* out)
+{
+    memcpy(out,&cache->stats,sizeof(cache_stats));
+    out += sizeof(cache_stats);
+    if(cache->sets)
+    {
+        for(int i = 0;i < cache->n;++i)
+        {
+            memcpy(out,cache->sets[i].lines,cache->sets[i].n*sizeof(cache_line));
+            out += cache->sets[i].n*sizeof(cache_line);
+        }
+    }
+    else
+    {
+        memcpy(out,cache->lines,cache->n*sizeof(cache_line));
+        out += cache->n*sizeof(cache_line);
+    }
+    return cache->victim ? save_cache_state(cache->victim,out) : out;
+}
+
+const unsigned char*
+load_cache_state(cache_t* cache,const unsigned char* in)
+{
+    memcpy(&cache->stats,in,sizeof(cache_stats));
+    in += sizeof(cache_stats);
+    if(cache->sets)
+    {
+        for(int i = 0;i < cache->n;++i)
+        {
+            memcpy(cache->sets[i].lines,in,cache->sets[i].n*sizeof(cache_line));
+            in += cache->sets[i].n*sizeof(cache_line);
+        }
+    }
+    else
+    {
+        memcpy(cache->lines,in,cache->n*sizeof(cache_line));
+        in += cache->n*sizeof(cache_line);
+    }
+    if(cache->order)
+        shadow_rebuild(cache);
+    return cache->victim ? load_cache_state(cache->victim,in) : in;
+}
+
+static int
+lines_equal(const cache_line* a,const cache_line* b,unsigned n)
+{
+    for(unsigned i = 0;i < n;++i)
+    {
+        if((a[i].tag != b[i].tag) || (a[i].valid != b[i].valid) || (a[i].dirty != b[i].dirty) ||
+           (a[i].last_used_time != b[i].last_used_time))
+            return 0;
+    }
+    return 1;
+}
+
+/*
+ * compare line state (not stats) of two caches with the same geometry
+ */
+int
+cache_state_equal(const cache_t* a,const cache_t* b)
+{
+    if(a->sets)
+    {
+        for(int i = 0;i < a->n;++i)
+            if(!lines_equal(a->sets[i].lines,b->sets[i].lines,a->sets[i].n))
+                return 0;
+    }
+    else if(!lines_equal(a->lines,b->lines,a->n))
+        return 0;
+    return a->victim ? cache_state_equal(a->victim,b->victim) : 1;
+}
+
+int
+access_cache(cache_t* cache,address_info af,char op,ssize_t now)
+{
+    
+    int hit = 0;
+        // under way partitioning only the ways of alloc_mask are replacement candidates
+        switch(cache->type)
+        {
+            case(direct_mapped):
+                switch(op)
+                {
+                    case('r'):
+                            if((cache->lines[af.index].valid)&&(cache->lines[af.index].tag == af.tag))
+                            {
+
+                                ++cache->stats.hits;
+                                cache->lines[af.index].last_used_time = now;
+                                return 1;
+                            }
+                            else
+                            {
+                                cache->evicted = cache->lines[af.index];
+                                if(!cache->lines[af.index].valid)
+                                    ++cache->stats.cold_misses;
+                                if((cache->lines[af.index].valid)&&(cache->lines[af.index].tag != af.tag))
+                                    ++cache->stats.cold_misses;
+                                cache->lines[af.index].valid = 1;
+                                cache->lines[af.index].tag = af.tag;
+                                cache->lines[af.index].dirty = 0;
+                                ++cache->stats.total_misses;
+                                return 0;
+                            }
+                        break;
+                    case('w'):
+                        if((cache->lines[af.index].valid)&&(cache->lines[af.index].tag == af.tag))
+                        {
+                            cache->lines[af.index].dirty = 1;
+                            ++cache->stats.hits;
+                            return 1;
+                        }
+
+                        cache->evicted = cache->lines[af.index];
+                        if(!cache->lines[af.index].valid)
+                            ++cache->stats.cold_misses;
+                        cache->lines[af.index].tag = af.tag;
+                        cache->lines[af.index].dirty = 1;
+                        cache->lines[af.index].valid = 1;
+                        ++cache->stats.total_misses;
+                        return 0;
+                }
+                break;
+            case(associative):
+                switch(op)
+                {
+                    case('r'):
+                        for(int set = 0;set < cache->sets[af.index].n; ++set)
+                        {
+                            if((cache->sets[af.index].lines[set].valid)&&(cache->sets[af.index].lines[set].tag == af.tag))
+                            {
+                                // it hit
+                                cache->sets[af.index].lines[set].last_used_time = now;
+                                ++cache->stats.hits;
+                                return 1;
+                            }
+                       }
+                        
+                        //calculate LRU
+                        //
+                        unsigned oldest_block = UINT_MAX;
+                        unsigned oldest_line = 0;
+                        for(int set = 0;set < cache->sets[af.index].n;++set)
+                        {
+                            if((cache->sets[af.index].lines[set].last_used_time < oldest_block) &&
+                               (!cache->alloc_mask || ((cache->alloc_mask >> set) & 1)))
+                            {
+                                oldest_block = cache->sets[af.index].lines[set].last_used_time;
+                                oldest_line = set;
+                            }
+                        }
+                        cache->evicted = cache->sets[af.index].lines[oldest_line];
+                        if(!cache->sets[af.index].lines[oldest_line].valid)
+                            ++cache->stats.cold_misses;
+                        cache->sets[af.index].lines[oldest_line].tag = af.tag;
+                        cache->sets[af.index].lines[oldest_line].owner = cache->alloc_class;
+                        cache->sets[af.index].lines[oldest_line].valid = 1;
+                        cache->sets[af.index].lines[oldest_line].dirty = 0;
+                        cache->sets[af.index].lines[oldest_line].last_used_time = now;
+                        ++cache->stats.total_misses;
+                        return 0;
+                    
+                    case('w'):
+                            for(int set = 0;set < cache->sets[af.index].n;++set)
+                            {
+                                if((cache->sets[af.index].lines[set].valid)&&(cache->sets[af.index].lines[set].tag == af.tag))
+                                {
+                                    cache->sets[af.index].lines[set].dirty = 1;
+                                    ++cache->stats.hits;
+                                    cache->sets[af.index].lines[set].last_used_time = now;
+                                    return 1;
+                                }
+                            }
+                            if(!hit)
+                            {
+                                unsigned oldest_block = UINT_MAX;
+                                unsigned oldest_line = 0;
+                                for(int set = 0;set<cache->sets[af.index].n;++set)
+                                {
+                                    if((cache->sets[af.index].lines[set].last_used_time < oldest_block) &&
+                                       (!cache->alloc_mask || ((cache->alloc_mask >> set) & 1)))
+                                    {
+                                        oldest_block = cache->sets[af.index].lines[set].last_used_time;
+                                        oldest_line = set;
+                                    }
+                                }
+                            cache->evicted = cache->sets[af.index].lines[oldest_line];
+                            if(!cache->sets[af.index].lines[oldest_line].valid)
+                                ++cache->stats.cold_misses;
+                            cache->sets[af.index].lines[oldest_line].tag = af.tag;
+                            cache->sets[af.index].lines[oldest_line].owner = cache->alloc_class;
+                            cache->sets[af.index].lines[oldest_line].valid = 1;
+                            cache->sets[af.index].lines[oldest_line].dirty = 1;
+                            cache->sets[af.index].lines[oldest_line].last_used_time = now;
+                            cache->stats.total_misses++;
+                            return 0;
+                            }
+                        break;
+                }
+                break;
+            case(skewed_associative):
+            {
+                // way w of the line lives in set skew_index(line, w)
+                unsigned ways = cache->sets[0].n;
+                unsigned bits = __builtin_ctz(cache->n);
+                cache_line* victim = NULL;
+                for(unsigned w = 0;w < ways;++w)
+                {
+                    cache_line* line = &cache->sets[skew_index(af.tag,w,bits)].lines[w];
+                    if(line->valid && line->tag == af.tag)
+                    {
+                        line->dirty |= op == 'w';
+                        line->last_used_time = now;
+                        ++cache->stats.hits;
+                        return 1;
+                    }
+                    if((!victim || line->last_used_time < victim->last_used_time) &&
+                       (!cache->alloc_mask || ((cache->alloc_mask >> w) & 1)))
+                        victim = line;
+                }
+                cache->evicted = *victim;
+                if(!victim->valid)
+                    ++cache->stats.cold_misses;
+                victim->tag = af.tag;
+                victim->owner = cache->alloc_class;
+                victim->valid = 1;
+                victim->dirty = op == 'w';
+                victim->last_used_time = now;
+                ++cache->stats.total_misses;
+                return 0;
+            }
+            case(fully_associative):
+                if(cache->order)
+                    return shadow_access(cache,af,op,now);
+                switch(op)
+                {
+                    case('r'):
+                        for(int line = 0;line < cache->n;++line)
+                        {
+                            if((cache->lines[line].valid)&&(cache->lines[line].tag == af.tag))
+                            {
+                                cache->lines[line].valid = 1;
+                                cache->lines[line].last_used_time = now;
+                                ++cache->stats.hits;
+                                hit = 1;
+                                return 1;
+                            }
+                        }
+                            unsigned oldest_block = UINT_MAX;
+                            unsigned oldest_line = 0;
+                            for(int line = 0;line < cache->n;++line)
+                            {
+                                if(cache->lines[line].last_used_time < oldest_block)
+                                {
+                                    oldest_block = cache->lines[line].last_used_time;
+                                    oldest_line = line;
+                                }
+                            }
+                            cache->evicted = cache->lines[oldest_line];
+                            if(!cache->lines[oldest_line].valid)
+                                ++cache->stats.cold_misses;
+                            cache->lines[oldest_line].tag = af.tag;
+                            cache->lines[oldest_line].dirty = 0;
+                            cache->lines[oldest_line].valid = 1;
+                            cache->lines[oldest_line].last_used_time = now;
+                            ++cache->stats.total_misses;
+                            return 0;
+                    
+
+
+                        break;
+                    case('w'):
+                        for(int line = 0;line < cache->n;++line)
+                        {
+                            if((cache->lines[line].valid)&&(cache->lines[line].tag == af.tag))
+                            {
+                                cache->lines[line].valid = 1;
+                                cache->lines[line].dirty = 1;
+                                cache->lines[line].last_used_time = now;
+                                ++cache->stats.hits;
+                                hit = 1;
+                                return 1;
+                            }
+                        }
+                        if(!hit)
+                        {
+                                unsigned oldest_block = UINT_MAX;
+                                unsigned oldest_line = 0;
+                                for(int line = 0;line < cache->n;++line)
+                                {
+                                    if(cache->lines[line].last_used_time < oldest_block)
+                                    {
+                                        oldest_block = cache->lines[line].last_used_time;
+                                        oldest_line = line;
+                                    }
+                                }
+                                cache->evicted = cache->lines[oldest_line];
+                                if(!cache->lines[oldest_line].valid)
+                                    ++cache->stats.cold_misses;
+                                cache->lines[oldest_line].tag = af.tag;
+                                cache->lines[oldest_line].dirty = 1;
+                                cache->lines[oldest_line].valid = 1;
+                                cache->lines[oldest_line].last_used_time = now;
+                                ++cache->stats.total_misses;
+
+                        }
+
+
+                        break;
+                }
+                break;
+        }
+    return hit;
+}
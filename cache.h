@@ -0,0 +1,278 @@
+#ifndef CACHE_H
+#define CACHE_H
+
+#include <stdint.h>
+#include <string.h>
+#include <sys/types.h>
+
+#include "cachesim.h"
+#include "perf.h"
+#include "hotspot.h"
+#include "partition.h"
+#include "eventlog.h"
+#include "dram.h"
+#include "deadblock.h"
+#include "arena.h"
+
+/*
+ * internal model of libcachesim: single cache levels and the hierarchy
+ * state behind the opaque cachesim handle
+ */
+
+#define ADDRESS_LEN 32
+// records decoded per cachesim_access_batch call by the trace drivers that need hit levels
+#define TRACE_BATCH 1024
+
+// to differentiate the sort of cache that isnt associative
+typedef enum
+{
+    direct_mapped = 1,
+    fully_associative,
+    associative,
+    skewed_associative      // tags are whole line addresses, sets are per-way hashes
+}cache_type;
+
+typedef struct
+{
+    //direct-mapped and fully associative will always have 0 tag
+    unsigned tag;
+    unsigned valid: 1;
+    unsigned dirty: 1;      // written since it was filled
+    unsigned owner: 4;      // class of service that filled the line
+    ssize_t last_used_time;
+}cache_line;
+
+/*
+ * structure for direct mapped and fully associative
+*/
+
+typedef struct cache_t cache_t;
+
+/*
+ * lookup and LRU order of a fully associative shadow, so an access costs
+ * a hash probe instead of a scan of every line
+ */
+typedef struct
+{
+    uint32_t* map;          // line + 1 by tag hash, linear probing, 0 is empty; valid lines only
+    size_t mask;
+    uint32_t* prev;         // doubly linked LRU order over all lines, invalid ones at the LRU end
+    uint32_t* next;
+    uint32_t mru;
+    uint32_t lru;
+}shadow_order;
+
+struct cache_t
+{
+    cache_line* lines;
+    cache_t* sets;
+    unsigned n;
+    cache_stats stats;
+    cache_t* victim;
+    cache_type type;
+    uint64_t alloc_mask;    // ways a fill may take under way partitioning, 0 for all
+    unsigned alloc_class;   // owner recorded in the lines it fills
+    cache_line evicted;     // the line the last miss replaced, for the event log
+    shadow_order* order;    // fully associative shadows only, NULL to scan the lines
+};
+
+//struct to keep extracted address components
+typedef struct
+{
+    unsigned index;
+    unsigned tag;
+    unsigned fa_tag;
+    unsigned block_offset;
+}address_info;
+
+//masks and shifts of one level, computed once when the hierarchy is created
+typedef struct
+{
+    cachesim_geometry g;
+    cachesim_index_fn index_fn;
+    unsigned offset_mask;
+    unsigned index_mask;
+    unsigned tag_mask;
+    unsigned tag_shift;
+    uint64_t mod_magic;     // 2^64/n_sets rounded up, for MODULO
+}level_geometry;
+
+__extension__ typedef unsigned __int128 cache_u128;
+
+/*
+ * x % d and x / d for the d of magic = UINT64_MAX/d + 1 (d > 1), with
+ * multiplications only (Lemire, Kaser and Kurz)
+ */
+static inline uint32_t
+fast_mod(uint32_t x,uint64_t magic,uint32_t d)
+{
+    return ((cache_u128)(magic*x)*d) >> 64;
+}
+
+static inline uint32_t
+fast_div(uint32_t x,uint64_t magic)
+{
+    return ((cache_u128)magic*x) >> 64;
+}
+
+// every index_bits wide slice of the line address XORed together
+static inline unsigned
+xor_fold(uint32_t line,unsigned bits,unsigned mask)
+{
+    unsigned index = 0;
+    if(!bits)
+        return 0;
+    for(;line;line = bits < ADDRESS_LEN ? line >> bits : 0)
+        index ^= line & mask;
+    return index;
+}
+
+// set of way w for a line in a skewed-associative cache of 2^bits sets
+static inline unsigned
+skew_index(uint32_t line,unsigned w,unsigned bits)
+{
+    if(!bits)
+        return 0;
+    uint32_t high = bits < ADDRESS_LEN ? line >> bits : 0;
+    uint32_t k = 0x9e3779b1u + 2*w*0x85ebca6bu;   // odd and distinct per way
+    return (line ^ ((high*k) >> (ADDRESS_LEN - bits))) & ((1u << bits) - 1);
+}
+
+struct cachesim
+{
+    cache_arena arena;      // every cache_t and line of the hierarchy
+    unsigned n_levels;
+    cachesim_config config;
+    cache_t* levels[CACHESIM_MAX_LEVELS];
+    cache_t* fa[CACHESIM_MAX_LEVELS];   // fully associative shadow of each level
+    level_geometry geom[CACHESIM_MAX_LEVELS];
+    hotspot_profile* profile[CACHESIM_MAX_LEVELS];  // NULL unless profiling
+    partition_state* part;              // NULL unless way partitioning
+    event_log* log;                     // NULL unless logging miss events
+    dram_model* dram;                   // NULL unless modelling DRAM
+    deadblock_state* dead;              // NULL unless predicting dead blocks
+    ssize_t clock;                      // accesses simulated so far, drives LRU
+};
+
+unsigned get_mask(unsigned);
+unsigned get_address_len(unsigned );
+size_t cache_bytes(unsigned,unsigned,unsigned);
+size_t shadow_bytes(unsigned);
+cache_t* init_assoc_cache(cache_arena*,unsigned,unsigned,unsigned);
+cache_t* init_cache(cache_arena*,unsigned,unsigned);
+cache_t* init_shadow_cache(cache_arena*,unsigned);
+void reset_cache(cache_t*);
+void copy_cache_state(cache_t*,const cache_t*);
+int cache_state_equal(const cache_t*,const cache_t*);
+size_t cache_state_size(const cache_t*);
+unsigned char* save_cache_state(const cache_t*,unsigned char*);
+const unsigned char* load_cache_state(cache_t*,const unsigned char*);
+int access_cache(cache_t*,address_info,char,ssize_t);
+int deadblock_access(deadblock_state*,cache_t*,address_info,uint32_t,char,ssize_t);
+
+/*
+ * split address into the components used by level geometry l
+ */
+static inline void
+decompose_address(const level_geometry* l,uint32_t address,address_info* info,address_info* fa_info)
+{
+    info->block_offset = address & l->offset_mask;
+    info->fa_tag = l->g.block_offset_bits < ADDRESS_LEN ? address >> l->g.block_offset_bits : 0;
+    switch(l->index_fn)
+    {
+        case(CACHESIM_INDEX_BITS):
+            info->tag = (address & l->tag_mask) >> l->tag_shift;
+            info->index = (address >> l->g.block_offset_bits) & l->index_mask;
+            break;
+        case(CACHESIM_INDEX_MODULO):
+            info->tag = fast_div(info->fa_tag,l->mod_magic);
+            info->index = fast_mod(info->fa_tag,l->mod_magic,l->g.n_sets);
+            break;
+        case(CACHESIM_INDEX_XOR):
+            // the low bits follow from index and tag, so the tag is unchanged
+            info->tag = (address & l->tag_mask) >> l->tag_shift;
+            info->index = xor_fold(info->fa_tag,l->g.index_bits,l->index_mask);
+            break;
+        case(CACHESIM_INDEX_SKEWED):
+            info->tag = info->fa_tag;
+            info->index = skew_index(info->fa_tag,0,l->g.index_bits);
+            break;
+    }
+
+    fa_info->block_offset = info->block_offset;
+    fa_info->tag = info->fa_tag;
+    fa_info->fa_tag = info->fa_tag;
+    fa_info->index = 0;
+}
+
+/*
+ * log a miss of level l if the filter selects it; fa_hit tells whether the
+ * level's fully associative shadow hit
+ */
+static inline void
+log_miss(event_log* log,const cache_t* cache,unsigned l,ssize_t time,uint32_t address,const address_info* info,
+         char op,int fa_hit)
+{
+    const cache_line* evicted = &cache->evicted;
+    unsigned type = !evicted->valid ? CACHESIM_EVENT_FILL : evicted->dirty ? CACHESIM_EVENT_WRITEBACK :
+                    CACHESIM_EVENT_EVICT;
+    if(!((log->levels >> l) & 1) || !(log->types & type))
+        return;
+    cachesim_event e;
+    e.access = time;
+    e.address = address;
+    e.set = info->index;
+    e.evicted_tag = evicted->valid ? evicted->tag : 0;
+    e.level = l;
+    e.type = type;
+    e.miss_class = !evicted->valid ? CACHESIM_MISS_COLD : fa_hit ? CACHESIM_MISS_CONFLICT : CACHESIM_MISS_CAPACITY;
+    e.op = op;
+    event_push(log,l,&e);
+}
+
+// byte address of the line with this tag in set index, inverse of decompose_address
+static inline uint32_t
+line_address(const level_geometry* l,unsigned tag,unsigned index)
+{
+    uint32_t line;
+    switch(l->index_fn)
+    {
+        case(CACHESIM_INDEX_MODULO):
+            line = tag*l->g.n_sets + index;
+            break;
+        case(CACHESIM_INDEX_XOR):
+            // the index is the low slice XORed with the folded tag
+            line = (tag << l->g.index_bits) | (index ^ xor_fold(tag,l->g.index_bits,l->index_mask));
+            break;
+        case(CACHESIM_INDEX_SKEWED):
+            line = tag;
+            break;
+        default:
+            line = l->g.index_bits < ADDRESS_LEN ? (tag << l->g.index_bits) | index : index;
+            break;
+    }
+    return l->g.block_offset_bits < ADDRESS_LEN ? line << l->g.block_offset_bits : 0;
+}
+
+/*
+ * a miss in the last level: read the line from DRAM, and write back the
+ * line it replaced if that line was written while cached
+ */
+static inline void
+dram_miss(dram_model* dram,const cache_t* cache,const level_geometry* geom,ssize_t time,uint32_t address,
+          const address_info* info)
+{
+    dram_push(dram,time,address,0);
+    if(cache->evicted.valid && cache->evicted.dirty)
+        dram_push(dram,time,line_address(geom,cache->evicted.tag,info->index),1);
+}
+
+static inline void
+decode_record(const unsigned char* record,uint32_t* address,char* op)
+{
+    //address is 4 bytes (int), operation is 1 byte (char)
+    memcpy(address,record,4);
+    *op = record[4];
+}
+
+#endif
@@ -0,0 +1,590 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <stdint.h>
+
+#include "cache.h"
+
+/*
+ * build the level, its fully associative shadow and its address split
+ * the same way the original single-file simulator did
+ */
+static int
+create_level(cachesim* sim,unsigned l)
+{
+    const cachesim_level_config* c = &sim->config.level[l];
+    level_geometry* geom = &sim->geom[l];
+    unsigned total_lines = c->size/c->line_size;
+    unsigned block_offset = log2(c->line_size);
+    unsigned index_bits = 0, tag_bits = 0;
+    cache_t* cache;
+
+    if(c->assoc-1)
+    {
+        cache = init_assoc_cache(&sim->arena,total_lines,c->assoc,c->victim_size);
+        if(!cache)
+            return -1;
+        cache->type = associative;
+        index_bits = log2(cache->n);
+        tag_bits = ADDRESS_LEN - block_offset - index_bits;
+    }
+    else
+    {
+        cache = init_cache(&sim->arena,total_lines,c->victim_size);
+        if(!cache)
+            return -1;
+        if(total_lines == 1)
+        {
+            cache->type = fully_associative;
+            tag_bits = ADDRESS_LEN - block_offset;
+        }
+        else
+        {
+            cache->type = direct_mapped;
+            index_bits = log2(total_lines);
+            tag_bits = ADDRESS_LEN - block_offset - index_bits;
+        }
+    }
+    sim->levels[l] = cache;
+
+    // creating fully associative shadow with no victim cache.
+    sim->fa[l] = init_shadow_cache(&sim->arena,total_lines);
+    if(!sim->fa[l])
+        return -1;
+
+    geom->g.n_lines = total_lines;
+    geom->g.n_sets = cache->type == associative ? cache->n : (cache->type == direct_mapped ? total_lines : 1);
+    geom->g.block_offset_bits = block_offset;
+    geom->g.index_bits = index_bits;
+    geom->g.tag_bits = tag_bits;
+    geom->offset_mask = get_mask(block_offset);
+    geom->index_mask = get_mask(index_bits);
+    geom->tag_shift = block_offset + index_bits;
+    geom->tag_mask = geom->tag_shift < ADDRESS_LEN ? get_mask(tag_bits) << geom->tag_shift : 0;
+
+    geom->index_fn = c->index_fn;
+    switch(c->index_fn)
+    {
+        case(CACHESIM_INDEX_BITS):
+        case(CACHESIM_INDEX_XOR):
+            break;
+        case(CACHESIM_INDEX_MODULO):
+            // a single set needs no index
+            if(geom->g.n_sets < 2)
+            {
+                geom->index_fn = CACHESIM_INDEX_BITS;
+                break;
+            }
+            geom->mod_magic = UINT64_MAX/geom->g.n_sets + 1;
+            geom->g.index_bits = get_address_len(geom->g.n_sets - 1);
+            break;
+        case(CACHESIM_INDEX_SKEWED):
+            if(cache->type != associative || (cache->n & (cache->n - 1)))
+                return -1;
+            cache->type = skewed_associative;
+            geom->g.tag_bits = ADDRESS_LEN - block_offset;
+            break;
+        default:
+            return -1;
+    }
+    return 0;
+}
+
+cachesim*
+cachesim_create(const cachesim_config* config)
+{
+    if(!config->n_levels || config->n_levels > CACHESIM_MAX_LEVELS)
+        return NULL;
+    for(unsigned l = 0;l < config->n_levels;++l)
+    {
+        const cachesim_level_config* c = &config->level[l];
+        if((c->size == 0) || (c->assoc == 0) || (c->line_size == 0))
+            return NULL;
+    }
+
+    // size the arena for every level and shadow so creation never runs out
+    size_t bytes = 0;
+    for(unsigned l = 0;l < config->n_levels;++l)
+    {
+        const cachesim_level_config* c = &config->level[l];
+        unsigned total_lines = c->size/c->line_size;
+        if(!total_lines || total_lines < c->assoc)
+            return NULL;
+        bytes += cache_bytes(total_lines,c->assoc,c->victim_size) + shadow_bytes(total_lines);
+    }
+
+    cachesim* sim = calloc(1,sizeof(cachesim));
+    if(!sim)
+        return NULL;
+    if(arena_init(&sim->arena,bytes))
+    {
+        free(sim);
+        return NULL;
+    }
+    sim->n_levels = config->n_levels;
+    sim->config = *config;
+    // unused levels are zeroed so configurations compare with memcmp
+    memset(&sim->config.level[sim->n_levels],0,(CACHESIM_MAX_LEVELS - sim->n_levels)*sizeof(cachesim_level_config));
+    for(unsigned l = 0;l < sim->n_levels;++l)
+    {
+        if(create_level(sim,l))
+        {
+            cachesim_destroy(sim);
+            return NULL;
+        }
+    }
+    return sim;
+}
+
+void
+cachesim_destroy(cachesim* sim)
+{
+    if(!sim)
+        return;
+    // the whole model is one mapping
+    arena_release(&sim->arena);
+    for(unsigned l = 0;l < sim->n_levels;++l)
+        hotspot_destroy(sim->profile[l]);
+    partition_destroy(sim->part);
+    if(sim->log)
+        event_log_close(sim->log,NULL);
+    dram_destroy(sim->dram);
+    deadblock_destroy(sim->dead);
+    free(sim);
+}
+
+void
+cachesim_reset(cachesim* sim)
+{
+    for(unsigned l = 0;l < sim->n_levels;++l)
+    {
+        reset_cache(sim->levels[l]);
+        reset_cache(sim->fa[l]);
+        if(sim->profile[l])
+            hotspot_reset(sim->profile[l]);
+    }
+    if(sim->part)
+        partition_reset(sim->part);
+    if(sim->dram)
+        dram_reset(sim->dram);
+    if(sim->dead)
+        deadblock_reset(sim->dead);
+    sim->clock = 0;
+}
+
+void
+cachesim_clear_stats(cachesim* sim)
+{
+    for(unsigned l = 0;l < sim->n_levels;++l)
+    {
+        memset(&sim->levels[l]->stats,0,sizeof(cache_stats));
+        memset(&sim->fa[l]->stats,0,sizeof(cache_stats));
+    }
+    if(sim->part)
+        memset(sim->part->stats,0,sizeof(sim->part->stats));
+    if(sim->dram)
+    {
+        dram_flush(sim->dram,1);
+        dram_clear_stats(sim->dram);
+    }
+    if(sim->dead)
+        memset(&sim->dead->stats,0,sizeof(sim->dead->stats));
+}
+
+int
+cachesim_copy_state(cachesim* dst,const cachesim* src)
+{
+    if(memcmp(&dst->config,&src->config,sizeof(cachesim_config)))
+        return -1;
+    for(unsigned l = 0;l < src->n_levels;++l)
+    {
+        copy_cache_state(dst->levels[l],src->levels[l]);
+        copy_cache_state(dst->fa[l],src->fa[l]);
+    }
+    dst->clock = src->clock;
+    return 0;
+}
+
+int
+cachesim_state_equal(const cachesim* a,const cachesim* b)
+{
+    if(memcmp(&a->config,&b->config,sizeof(cachesim_config)))
+        return 0;
+    for(unsigned l = 0;l < a->n_levels;++l)
+    {
+        if(!cache_state_equal(a->levels[l],b->levels[l]) || !cache_state_equal(a->fa[l],b->fa[l]))
+            return 0;
+    }
+    return 1;
+}
+
+size_t
+cachesim_state_size(const cachesim* sim)
+{
+    size_t size = sizeof(uint64_t);
+    for(unsigned l = 0;l < sim->n_levels;++l)
+        size += cache_state_size(sim->levels[l]) + cache_state_size(sim->fa[l]);
+    return size;
+}
+
+void
+cachesim_save_state(const cachesim* sim,void* buffer)
+{
+    unsigned char* out = buffer;
+    uint64_t clock = sim->clock;
+    memcpy(out,&clock,sizeof(clock));
+    out += sizeof(clock);
+    for(unsigned l = 0;l < sim->n_levels;++l)
+    {
+        out = save_cache_state(sim->levels[l],out);
+        out = save_cache_state(sim->fa[l],out);
+    }
+}
+
+int
+cachesim_load_state(cachesim* sim,const void* buffer,size_t size)
+{
+    if(size != cachesim_state_size(sim))
+        return -1;
+    const unsigned char* in = buffer;
+    uint64_t clock;
+    memcpy(&clock,in,sizeof(clock));
+    in += sizeof(clock);
+    for(unsigned l = 0;l < sim->n_levels;++l)
+    {
+        in = load_cache_state(sim->levels[l],in);
+        in = load_cache_state(sim->fa[l],in);
+    }
+    sim->clock = clock;
+    return 0;
+}
+
+/*
+ * class statistics and utility monitoring of an access that hit level,
+ * then a repartition if one is due
+ */
+static void
+partition_access(cachesim* sim,const address_info* info,unsigned level)
+{
+    partition_state* p = sim->part;
+    unsigned l = p->config.level;
+    partition_count(p,level,sim->n_levels);
+    if(level >= l)
+        umon_access(p,info[l].index,info[l].tag);
+    if(p->config.interval && sim->clock + 1 >= p->next)
+    {
+        partition_rebalance(p);
+        sim->levels[l]->alloc_mask = p->config.way_mask[p->cls];
+        p->next += p->config.interval;
+    }
+}
+
+/*
+ * one access through the hierarchy: every fully associative shadow sees the
+ * access, then L1, L2, ... until a level hits
+ * returns the level that hit or n_levels when it went to memory
+ */
+static inline unsigned
+simulate_access(cachesim* sim,uint32_t address,char op,perf_ctx* perf)
+{
+    address_info info[CACHESIM_MAX_LEVELS];
+    address_info fa_info[CACHESIM_MAX_LEVELS];
+    unsigned level = sim->n_levels;
+    unsigned fa_hits = 0;
+
+    for(unsigned l = 0;l < sim->n_levels;++l)
+        decompose_address(&sim->geom[l],address,&info[l],&fa_info[l]);
+    if(perf)
+        perf_mark(perf,PERF_DECOMPOSE);
+
+    if((op == 'r') || (op == 'w'))
+    {
+        for(unsigned l = 0;l < sim->n_levels;++l)
+        {
+            int hit = access_cache(sim->fa[l],fa_info[l],op,sim->clock);
+            fa_hits |= hit << l;
+            if(perf)
+                perf_mark(perf,hit ? PERF_LOOKUP : PERF_REPLACE);
+        }
+        //if missed go through next level
+        for(unsigned l = 0;l < sim->n_levels;++l)
+        {
+            int hit = sim->dead && l == sim->dead->config.level ?
+                      deadblock_access(sim->dead,sim->levels[l],info[l],address,op,sim->clock) :
+                      access_cache(sim->levels[l],info[l],op,sim->clock);
+            if(perf)
+                perf_mark(perf,hit ? PERF_LOOKUP : PERF_REPLACE);
+            if(hit)
+            {
+                level = l;
+                break;
+            }
+            if(sim->profile[l])
+                hotspot_miss(sim->profile[l],info[l].index,address);
+            //a bypassed miss replaced no line, so it is no event
+            if(sim->log && !(sim->dead && l == sim->dead->config.level && sim->dead->bypassed))
+                log_miss(sim->log,sim->levels[l],l,sim->clock,address,&info[l],op,(fa_hits >> l) & 1);
+        }
+        if(sim->dram && level == sim->n_levels)
+            dram_miss(sim->dram,sim->levels[level - 1],&sim->geom[level - 1],sim->clock,address,&info[level - 1]);
+        if(sim->part)
+            partition_access(sim,info,level);
+    }
+    ++sim->clock;
+    return level;
+}
+
+size_t
+cachesim_access_batch(cachesim* sim,const uint32_t* addresses,const char* ops,size_t n,unsigned char* hit_level)
+{
+    if(hit_level)
+    {
+        for(size_t i = 0;i < n;++i)
+            hit_level[i] = simulate_access(sim,addresses[i],ops[i],NULL);
+    }
+    else
+    {
+        for(size_t i = 0;i < n;++i)
+            simulate_access(sim,addresses[i],ops[i],NULL);
+    }
+    return n;
+}
+
+size_t
+cachesim_run_trace(cachesim* sim,const unsigned char* records,size_t n)
+{
+    for(size_t i = 0;i < n;++i)
+    {
+        uint32_t address;
+        char op;
+        decode_record(records + i*CACHESIM_RECORD_SIZE,&address,&op);
+        simulate_access(sim,address,op,NULL);
+    }
+    return n;
+}
+
+size_t
+cachesim_run_trace_perf(cachesim* sim,const unsigned char* records,size_t n,perf_ctx* perf)
+{
+    for(size_t i = 0;i < n;++i)
+    {
+        uint32_t address;
+        char op;
+        perf_begin(perf,sim->clock);
+        decode_record(records + i*CACHESIM_RECORD_SIZE,&address,&op);
+        perf_mark(perf,PERF_DECODE);
+        simulate_access(sim,address,op,perf);
+    }
+    return n;
+}
+
+int
+cachesim_get_stats(const cachesim* sim,unsigned level,cache_stats* stats)
+{
+    if(level >= sim->n_levels)
+        return -1;
+    *stats = sim->levels[level]->stats;
+    return 0;
+}
+
+int
+cachesim_get_shadow_stats(const cachesim* sim,unsigned level,cache_stats* stats)
+{
+    if(level >= sim->n_levels)
+        return -1;
+    *stats = sim->fa[level]->stats;
+    return 0;
+}
+
+int
+cachesim_get_geometry(const cachesim* sim,unsigned level,cachesim_geometry* geometry)
+{
+    if(level >= sim->n_levels)
+        return -1;
+    *geometry = sim->geom[level].g;
+    return 0;
+}
+
+void
+cachesim_get_config(const cachesim* sim,cachesim_config* config)
+{
+    *config = sim->config;
+}
+
+void
+cachesim_get_memory(const cachesim* sim,cachesim_memory* memory)
+{
+    memory->used = sim->arena.used;
+    memory->reserved = sim->arena.size;
+    memory->huge_pages = sim->arena.pages;
+}
+
+unsigned
+cachesim_levels(const cachesim* sim)
+{
+    return sim->n_levels;
+}
+
+uint64_t
+cachesim_accesses(const cachesim* sim)
+{
+    return sim->clock;
+}
+
+int
+cachesim_enable_hotspots(cachesim* sim,unsigned top_k)
+{
+    for(unsigned l = 0;l < sim->n_levels;++l)
+    {
+        if(sim->profile[l])
+            continue;
+        sim->profile[l] = hotspot_create(sim->geom[l].g.n_sets,sim->geom[l].g.block_offset_bits,top_k);
+        if(!sim->profile[l])
+            return -1;
+    }
+    return 0;
+}
+
+size_t
+cachesim_hotspots(const cachesim* sim,unsigned level,cachesim_hotspot_kind kind,cachesim_hotspot* out,size_t n)
+{
+    if(level >= sim->n_levels || !sim->profile[level])
+        return 0;
+    const hotspot_profile* p = sim->profile[level];
+    size_t found;
+    switch(kind)
+    {
+        case(CACHESIM_HOT_SETS):
+            return hotspot_top_sets(p,out,n);
+        case(CACHESIM_HOT_LINES):
+            found = cm_top(&p->lines,out,n);
+            for(size_t i = 0;i < found;++i)
+                out[i].key <<= p->block_offset_bits;
+            return found;
+        case(CACHESIM_HOT_PAGES):
+            found = cm_top(&p->pages,out,n);
+            for(size_t i = 0;i < found;++i)
+                out[i].key <<= HOTSPOT_PAGE_BITS;
+            return found;
+    }
+    return 0;
+}
+
+int
+cachesim_enable_partitions(cachesim* sim,const cachesim_partition_config* config)
+{
+    if(config->level >= sim->n_levels)
+        return -1;
+    cache_t* cache = sim->levels[config->level];
+    if(cache->type != associative && cache->type != skewed_associative)
+        return -1;
+    partition_state* p = partition_create(config,sim->config.level[config->level].assoc,cache->n);
+    if(!p)
+        return -1;
+    // a new configuration replaces the old one, lines keep their owners
+    partition_destroy(sim->part);
+    sim->part = p;
+    p->next = sim->clock + config->interval;
+    return cachesim_set_class(sim,0);
+}
+
+int
+cachesim_set_class(cachesim* sim,unsigned cls)
+{
+    partition_state* p = sim->part;
+    if(!p || cls >= p->config.n_classes)
+        return -1;
+    cache_t* cache = sim->levels[p->config.level];
+    p->cls = cls;
+    cache->alloc_mask = p->config.way_mask[cls];
+    cache->alloc_class = cls;
+    return 0;
+}
+
+int
+cachesim_get_class_stats(const cachesim* sim,unsigned cls,cachesim_class_stats* out)
+{
+    const partition_state* p = sim->part;
+    if(!p || cls >= p->config.n_classes)
+        return -1;
+    memcpy(out->stats,p->stats[cls],sizeof(out->stats));
+    out->way_mask = p->config.way_mask[cls];
+    out->occupancy = 0;
+    const cache_t* cache = sim->levels[p->config.level];
+    for(unsigned i = 0;i < cache->n;++i)
+        for(unsigned w = 0;w < cache->sets[i].n;++w)
+            out->occupancy += cache->sets[i].lines[w].valid && cache->sets[i].lines[w].owner == cls;
+    return 0;
+}
+
+uint64_t
+cachesim_repartitions(const cachesim* sim)
+{
+    return sim->part ? sim->part->repartitions : 0;
+}
+
+int
+cachesim_log_events(cachesim* sim,const char* path,unsigned level_mask,unsigned type_mask)
+{
+    if(sim->log)
+        return -1;
+    sim->log = event_log_open(path,&sim->config,level_mask,type_mask);
+    return sim->log ? 0 : -1;
+}
+
+int
+cachesim_log_close(cachesim* sim,uint64_t* events)
+{
+    if(!sim->log)
+        return -1;
+    int failed = event_log_close(sim->log,events);
+    sim->log = NULL;
+    return failed;
+}
+
+int
+cachesim_enable_dram(cachesim* sim,const cachesim_dram_config* config)
+{
+    if(sim->dram)
+        return -1;
+    sim->dram = dram_create(config,sim->geom[sim->n_levels - 1].g.block_offset_bits);
+    return sim->dram ? 0 : -1;
+}
+
+int
+cachesim_get_dram_stats(cachesim* sim,cachesim_dram_stats* stats)
+{
+    dram_model* d = sim->dram;
+    if(!d)
+        return -1;
+    dram_flush(d,1);
+    *stats = d->stats;
+    uint64_t requests = stats->row_hits + stats->row_empty + stats->row_conflicts;
+    stats->row_hit_rate = requests ? (double)stats->row_hits/requests : 0;
+    stats->utilization = stats->cycles ? (double)stats->busy_cycles/((double)stats->cycles*d->config.channels) : 0;
+    stats->read_latency = stats->reads ? (double)d->latency/stats->reads : 0;
+    return 0;
+}
+
+int
+cachesim_enable_deadblock(cachesim* sim,const cachesim_deadblock_config* config)
+{
+    if(sim->dead || config->level >= sim->n_levels || sim->levels[config->level]->type != associative)
+        return -1;
+    cache_t* cache = sim->levels[config->level];
+    sim->dead = deadblock_create(config,sim->config.level[config->level].assoc,cache->n);
+    return sim->dead ? 0 : -1;
+}
+
+int
+cachesim_get_deadblock_stats(const cachesim* sim,cachesim_deadblock_stats* stats)
+{
+    if(!sim->dead)
+        return -1;
+    *stats = sim->dead->stats;
+    uint64_t judged = stats->true_dead + stats->false_dead;
+    stats->accuracy = judged ? (double)stats->true_dead/judged : 0;
+    stats->coverage = stats->dead_evictions ? (double)stats->true_dead/stats->dead_evictions : 0;
+    return 0;
+}
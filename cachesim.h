@@ -0,0 +1,519 @@
+#ifndef CACHESIM_H
+#define CACHESIM_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+/*
+ * libcachesim: the cache hierarchy model behind Cache.Grp1 as a library.
+ *
+ * A cachesim holds every piece of simulation state, so any number of them
+ * can live in one process and each can be driven from its own thread.
+ * Nothing in the library prints or exits; errors are reported through
+ * return values.
+ *
+ *   cachesim_config cfg = {2, {{16384, 2, 64, 0}, {524288, 8, 64, 0}}};
+ *   cachesim* sim = cachesim_create(&cfg);
+ *   cachesim_access_batch(sim, addresses, ops, n, NULL);
+ *   cachesim_get_stats(sim, 0, &l1_stats);
+ *   cachesim_destroy(sim);
+ */
+
+#define CACHESIM_VERSION 3   // bumped whenever a change alters simulation results
+#define CACHESIM_MAX_LEVELS 4
+#define CACHESIM_RECORD_SIZE 5  // trace record: 4 byte little-endian address, 1 byte 'r'/'w'
+
+//struct to keep track of total accesses and misses within the cache
+typedef struct
+{
+    ssize_t total_accesses;
+    ssize_t hits;
+    ssize_t total_misses;
+    ssize_t cold_misses;
+    ssize_t capacity_misses;
+    ssize_t conflict_misses;
+}cache_stats;
+
+/*
+ * how a level maps line addresses to sets
+ *   BITS    the low bits of the line address (sets beyond the largest power
+ *           of two below the set count go unused)
+ *   MODULO  line address modulo the set count, by multiplication, for any
+ *           set count such as those of 12- or 20-way caches
+ *   XOR     the line address folded onto the index bits with XOR, like
+ *           hashed LLC set indexing
+ *   SKEWED  skewed-associative: each way has its own hash of the line
+ *           address; needs 2+ ways and a power-of-two set count
+ */
+typedef enum
+{
+    CACHESIM_INDEX_BITS = 0,
+    CACHESIM_INDEX_MODULO,
+    CACHESIM_INDEX_XOR,
+    CACHESIM_INDEX_SKEWED
+}cachesim_index_fn;
+
+typedef struct
+{
+    unsigned size;          // bytes
+    unsigned assoc;         // ways, 1 is direct mapped
+    unsigned line_size;     // bytes
+    unsigned victim_size;   // bytes, 0 is none
+    cachesim_index_fn index_fn; // how addresses map to sets
+}cachesim_level_config;
+
+typedef struct
+{
+    unsigned n_levels;      // L1 first
+    cachesim_level_config level[CACHESIM_MAX_LEVELS];
+}cachesim_config;
+
+// derived address split of one level
+typedef struct
+{
+    unsigned n_lines;
+    unsigned n_sets;
+    unsigned block_offset_bits;
+    unsigned index_bits;
+    unsigned tag_bits;
+}cachesim_geometry;
+
+// a set index, line address or page address and its miss count
+typedef struct
+{
+    uint64_t key;
+    uint64_t count;
+}cachesim_hotspot;
+
+typedef enum
+{
+    CACHESIM_HOT_SETS = 0,
+    CACHESIM_HOT_LINES,     // keys are line-aligned byte addresses
+    CACHESIM_HOT_PAGES      // keys are 4kB-aligned byte addresses
+}cachesim_hotspot_kind;
+
+// memory of the model state; huge_pages is 0 none, 1 transparent, 2 explicit
+typedef struct
+{
+    size_t used;
+    size_t reserved;
+    int huge_pages;
+}cachesim_memory;
+
+typedef struct cachesim cachesim;
+
+// returns NULL if the configuration is invalid or memory runs out
+cachesim* cachesim_create(const cachesim_config*);
+void cachesim_destroy(cachesim*);
+
+// invalidate every line and clear all statistics, keeping the geometry
+void cachesim_reset(cachesim*);
+
+// clear statistics only, keeping the cache contents (e.g. after warmup)
+void cachesim_clear_stats(cachesim*);
+
+/*
+ * copy contents, stats and access clock between two hierarchies created
+ * from the same configuration (-1 otherwise); state_equal compares the
+ * contents and clock-stamped LRU state but not the stats
+ */
+int cachesim_copy_state(cachesim*,const cachesim*);
+int cachesim_state_equal(const cachesim*,const cachesim*);
+
+/*
+ * serialize contents, stats and access clock into state_size bytes; load
+ * takes the bytes saved from a hierarchy of the same configuration by the
+ * same build (-1 on a size mismatch)
+ */
+size_t cachesim_state_size(const cachesim*);
+void cachesim_save_state(const cachesim*,void*);
+int cachesim_load_state(cachesim*,const void*,size_t);
+
+/*
+ * simulate n accesses in order; ops are 'r' or 'w' (anything else only
+ * advances the access clock). If hit_level is not NULL it receives, per
+ * access, the index of the level that hit or n_levels for a memory access.
+ * returns the number of accesses simulated
+ */
+size_t cachesim_access_batch(cachesim*,const uint32_t*,const char*,size_t,unsigned char*);
+
+// same as above on n raw CACHESIM_RECORD_SIZE trace records
+size_t cachesim_run_trace(cachesim*,const unsigned char*,size_t);
+
+// level is 0 for L1; returns -1 for a level the hierarchy does not have
+int cachesim_get_stats(const cachesim*,unsigned,cache_stats*);
+// the level's fully associative LRU shadow, of the same capacity, sees every access
+int cachesim_get_shadow_stats(const cachesim*,unsigned,cache_stats*);
+int cachesim_get_geometry(const cachesim*,unsigned,cachesim_geometry*);
+void cachesim_get_config(const cachesim*,cachesim_config*);
+void cachesim_get_memory(const cachesim*,cachesim_memory*);
+unsigned cachesim_levels(const cachesim*);
+uint64_t cachesim_accesses(const cachesim*);
+
+/*
+ * set-partitioned parallel simulation: the sets of every level are split
+ * across threads (the caller is one of them) and results match the serial
+ * run exactly. Not available while hotspot profiling, way partitioning,
+ * the event log, DRAM or dead-block prediction is enabled or for a
+ * skewed-associative level (NULL, as when memory or threads run out).
+ * The hierarchy must not be used directly while the parallel handle runs.
+ * run_trace returns the records simulated, 0 if its buffers for n records
+ * can not be allocated.
+ */
+typedef struct cachesim_parallel cachesim_parallel;
+cachesim_parallel* cachesim_parallel_create(cachesim*,unsigned);
+size_t cachesim_parallel_run_trace(cachesim_parallel*,const unsigned char*,size_t);
+void cachesim_parallel_destroy(cachesim_parallel*);
+
+/*
+ * pipelined simulation: each level below L1 runs on its own thread and
+ * consumes the miss stream of the level above through a lock-free ring.
+ * The caller runs L1; run_trace returns once all levels are drained, and
+ * results match the serial run exactly. NULL with way partitioning or
+ * dead-block prediction, or when memory or threads run out.
+ */
+typedef struct cachesim_pipeline cachesim_pipeline;
+cachesim_pipeline* cachesim_pipeline_create(cachesim*);
+size_t cachesim_pipeline_run_trace(cachesim_pipeline*,const unsigned char*,size_t);
+void cachesim_pipeline_destroy(cachesim_pipeline*);
+
+/*
+ * time-sliced simulation of n trace records: the range is cut into
+ * `slices` parts simulated in parallel on private hierarchies, each warmed
+ * on the `warmup` records before it. With exact set, slice boundaries are
+ * re-simulated from their predecessor's end state until nothing changes
+ * (at most max_rounds rounds, 0 for no limit). Merged stats and the last
+ * slice's end state land in sim, as if the range had run serially.
+ * returns -1 if memory runs out or way partitioning, the event log, DRAM
+ * or dead-block prediction is enabled
+ */
+typedef struct
+{
+    unsigned slices;
+    size_t warmup;
+    int exact;
+    unsigned max_rounds;
+}cachesim_slice_config;
+
+typedef struct
+{
+    unsigned rounds;        // parallel rounds, 1 without exact
+    size_t simulated;       // records simulated including warmup and fix-ups
+    int exact;              // the merged result equals the serial run
+}cachesim_slice_report;
+
+int cachesim_run_sliced(cachesim*,const unsigned char*,size_t,const cachesim_slice_config*,cachesim_slice_report*);
+
+/*
+ * conflict hotspot profiling: exact per-set miss counts plus count-min
+ * estimates of the top_k most missed lines and pages of every level.
+ * Enable before simulating; returns -1 if memory runs out
+ */
+int cachesim_enable_hotspots(cachesim*,unsigned);
+
+// copies up to n hotspots of the level, hottest first; returns how many
+size_t cachesim_hotspots(const cachesim*,unsigned,cachesim_hotspot_kind,cachesim_hotspot*,size_t);
+
+/*
+ * miss event log: one fixed-size record per miss of the selected levels
+ * and event types, written to a file by a background thread. Each level
+ * hands its events to the writer through its own lock-free ring, so the
+ * simulating thread (in pipelined runs, the thread of the level) only
+ * stores the record; it waits only while the writer is a full ring
+ * behind. The file is a cachesim_event_header followed by the events,
+ * in access order within a level but interleaved between levels.
+ * Events are logged by the serial and pipelined drivers; the parallel
+ * and time-sliced modes refuse a logging hierarchy. A miss that dead-block
+ * prediction bypasses replaces nothing and is not logged.
+ */
+#define CACHESIM_EVENT_MAGIC "CSEV"
+#define CACHESIM_EVENT_VERSION 1
+
+// what a miss did to the line it replaced
+typedef enum
+{
+    CACHESIM_EVENT_FILL = 1,        // filled an invalid line
+    CACHESIM_EVENT_EVICT = 2,       // evicted a clean line
+    CACHESIM_EVENT_WRITEBACK = 4    // evicted a line written since its fill
+}cachesim_event_type;
+
+// cold: the line was invalid; capacity or conflict by the level's fully associative shadow
+typedef enum
+{
+    CACHESIM_MISS_COLD = 0,
+    CACHESIM_MISS_CAPACITY,
+    CACHESIM_MISS_CONFLICT
+}cachesim_miss_class;
+
+typedef struct
+{
+    uint64_t access;        // access index
+    uint32_t address;
+    uint32_t set;
+    uint32_t evicted_tag;   // tag of the replaced line, 0 for a fill
+    uint8_t level;          // 0 is L1
+    uint8_t type;           // cachesim_event_type
+    uint8_t miss_class;     // cachesim_miss_class
+    uint8_t op;             // 'r' or 'w'
+}cachesim_event;
+
+typedef struct
+{
+    char magic[4];
+    uint32_t version;
+    uint32_t event_size;
+    uint32_t reserved;
+    cachesim_config config;
+}cachesim_event_header;
+
+/*
+ * log the misses of the levels in level_mask (bit 0 is L1) whose type is
+ * in type_mask to path; -1 if the file or the writer cannot be created
+ */
+int cachesim_log_events(cachesim*,const char*,unsigned,unsigned);
+
+// drain and close the log; -1 if writing failed. events receives how many were written
+int cachesim_log_close(cachesim*,uint64_t*);
+
+/*
+ * Belady's MIN/OPT bound for a configuration over n trace records held in
+ * memory: every level evicts the line whose next use lies furthest ahead
+ * in the stream reaching it, which is the miss stream of the optimal level
+ * above. stats receives one entry per level; capacity and conflict misses
+ * are not split. Victim caches are ignored. -1 for a skewed-associative
+ * level, n of 2^32 - 1 or more, or out of memory
+ */
+int cachesim_run_opt(const cachesim_config*,const unsigned char*,size_t,cache_stats*);
+
+/*
+ * way partitioning of one set-associative level, in the manner of cache
+ * allocation technology: every access belongs to a class of service
+ * (cachesim_set_class, 0 until set) and may only fill the ways of its
+ * class mask at the partitioned level, while hits are found in any way.
+ * Accesses, hits and misses are also counted per class at every level.
+ * With a repartition interval, utility monitors (per-class LRU shadow tags
+ * of one set in 2^sample_shift, counting hits per stack position) hand
+ * the ways out again every interval accesses to maximize the hits they
+ * predict, each class keeping at least one way. Enable before simulating;
+ * not available with the parallel, pipelined or time-sliced modes.
+ */
+#define CACHESIM_MAX_CLASSES 16
+
+typedef struct
+{
+    unsigned level;         // partitioned level, 0 is L1
+    unsigned n_classes;
+    uint64_t way_mask[CACHESIM_MAX_CLASSES];   // ways each class may fill, 0 is all
+    uint64_t interval;      // accesses between repartitions, 0 keeps the masks
+    unsigned sample_shift;  // monitors sample one set in 2^sample_shift
+}cachesim_partition_config;
+
+typedef struct
+{
+    cache_stats stats[CACHESIM_MAX_LEVELS];    // accesses, hits and misses of the class
+    uint64_t way_mask;      // ways it may fill now
+    uint64_t occupancy;     // lines of the partitioned level it filled
+}cachesim_class_stats;
+
+/*
+ * returns -1 for a level that is not set-associative or has more than 64
+ * ways, a mask without any way of the level, more classes than ways with
+ * repartitioning, or if memory runs out
+ */
+int cachesim_enable_partitions(cachesim*,const cachesim_partition_config*);
+
+// class of the following accesses; -1 for a class partitioning does not have
+int cachesim_set_class(cachesim*,unsigned);
+int cachesim_get_class_stats(const cachesim*,unsigned,cachesim_class_stats*);
+uint64_t cachesim_repartitions(const cachesim*);
+
+/*
+ * timing model: an event-driven latency layer over the functional
+ * simulation. Accesses issue in order, one per issue_interval cycles; a
+ * miss holds an MSHR at every level it misses in until its data returns,
+ * later accesses to a line with an outstanding miss wait for that miss
+ * instead of allocating, and issue stalls while L1 has no free MSHR or the
+ * oldest of the last `window` reads has not completed. Writes are posted
+ * and never hold up issue beyond their MSHR.
+ */
+typedef struct
+{
+    unsigned hit_latency[CACHESIM_MAX_LEVELS];  // cycles to return data from a level
+    unsigned miss_penalty[CACHESIM_MAX_LEVELS]; // cycles a level adds to an access that misses it
+    unsigned mshrs[CACHESIM_MAX_LEVELS];        // outstanding misses per level, 0 is blocking (1)
+    unsigned memory_latency;                    // cycles
+    unsigned issue_interval;                    // cycles between accesses, 0 is 1
+    unsigned window;                            // reads in flight, 0 is unlimited
+}cachesim_timing_config;
+
+typedef struct
+{
+    uint64_t accesses;
+    uint64_t cycles;            // until the last access completed
+    uint64_t stall_cycles;      // cycles beyond one access per issue interval
+    uint64_t latency;           // summed issue-to-completion latency
+    double amat;                // average memory access time, latency/accesses
+    uint64_t misses;            // L1 misses that allocated an MSHR
+    uint64_t merged;            // accesses that waited on an outstanding miss
+    uint64_t miss_cycles;       // cycles with at least one L1 miss outstanding
+    double mlp;                 // average L1 misses outstanding during miss_cycles
+    uint64_t mshr_full[CACHESIM_MAX_LEVELS];    // misses that waited for an MSHR
+}cachesim_timing_stats;
+
+typedef struct cachesim_timing cachesim_timing;
+
+// returns NULL if memory runs out
+cachesim_timing* cachesim_timing_create(const cachesim*,const cachesim_timing_config*);
+void cachesim_timing_destroy(cachesim_timing*);
+
+// time one access that the functional model resolved at level (n_levels for memory)
+void cachesim_timing_access(cachesim_timing*,uint32_t,char,unsigned);
+
+// cachesim_run_trace with every access also timed
+size_t cachesim_run_trace_timed(cachesim*,cachesim_timing*,const unsigned char*,size_t);
+
+void cachesim_timing_get_stats(const cachesim_timing*,cachesim_timing_stats*);
+
+/*
+ * filtered L1 miss streams: record, once, the accesses that miss L1 with
+ * their access clock, then replay that stream into L2 and below in later
+ * runs that only change the lower levels. The key identifies the trace
+ * range the stream was recorded from; replay fails (-1, sim untouched) on
+ * a missing or truncated file, or a different key or L1 configuration. A
+ * replayed hierarchy has exact stats and LRU state below L1, L1 stats from
+ * the recording, and no L1 contents.
+ */
+typedef struct
+{
+    uint64_t trace_size;    // bytes
+    int64_t trace_mtime;
+    uint64_t accesses;      // trace records requested
+}cachesim_filter_key;
+
+typedef struct cachesim_filter cachesim_filter;
+
+// start recording the stream of sim into path; NULL if it cannot be created
+cachesim_filter* cachesim_filter_record(const cachesim*,const char*,const cachesim_filter_key*);
+
+// cachesim_run_trace that also records the L1 misses
+size_t cachesim_run_trace_filtered(cachesim*,cachesim_filter*,const unsigned char*,size_t);
+
+// finish the file and publish it under its path; -1 if writing failed
+int cachesim_filter_close(cachesim_filter*,const cachesim*);
+
+// replay a recorded stream into a fresh hierarchy
+int cachesim_filter_replay(cachesim*,const char*,const cachesim_filter_key*);
+
+/*
+ * DRAM backend: a memory controller model behind the last level. Every
+ * access that misses the whole hierarchy reads its line from DRAM and
+ * every line the last level evicts after it was written is written back;
+ * lines that were only read leave silently. Requests arrive at access
+ * index * access_cycles (DRAM cycles), queue per channel and are
+ * scheduled FR-FCFS: among the queued requests whose bank is free, the
+ * oldest that hits the open row, else the oldest. Arrivals do not wait for
+ * the controller, so an overloaded channel shows as a growing latency
+ * rather than a slower trace. The hierarchy hands its requests over in
+ * batches, so the model costs little while simulating. Available to the
+ * serial and pipelined drivers; the parallel and time-sliced modes refuse
+ * a hierarchy with DRAM.
+ */
+typedef enum
+{
+    CACHESIM_DRAM_MAP_PAGE = 0,     // row:rank:bank:channel:column, a row holds consecutive lines
+    CACHESIM_DRAM_MAP_LINE,         // row:column:rank:bank:channel, consecutive lines spread out
+    CACHESIM_DRAM_MAP_XOR           // PAGE with the bank XORed with the low row bits
+}cachesim_dram_mapping;
+
+typedef struct
+{
+    unsigned channels;      // powers of two
+    unsigned ranks;         // per channel
+    unsigned banks;         // per rank
+    unsigned row_bytes;     // row buffer size, at least a line
+    unsigned queue;         // requests queued per channel
+    int closed_page;        // precharge after every access instead of keeping the row open
+    cachesim_dram_mapping mapping;
+    unsigned t_cl;          // cycles: column access
+    unsigned t_rcd;         // row activation
+    unsigned t_rp;          // precharge
+    unsigned t_burst;       // data bus time of one line
+    unsigned access_cycles; // cycles between accesses of the trace, 0 is 1
+}cachesim_dram_config;
+
+typedef struct
+{
+    uint64_t reads;
+    uint64_t writes;
+    uint64_t row_hits;      // the row was open
+    uint64_t row_empty;     // no row was open
+    uint64_t row_conflicts; // another row was open
+    uint64_t bank_conflicts;    // requests that arrived while their bank was busy with another row
+    uint64_t queue_full;    // requests that waited for a queue entry
+    uint64_t cycles;        // until the last request completed
+    uint64_t busy_cycles;   // data bus cycles summed over channels
+    double row_hit_rate;
+    double utilization;     // busy_cycles over channels * cycles
+    double read_latency;    // average arrival-to-data cycles of a read
+}cachesim_dram_stats;
+
+// enable before simulating; -1 for an invalid configuration or out of memory
+int cachesim_enable_dram(cachesim*,const cachesim_dram_config*);
+
+// completes every request handed over so far; -1 without DRAM
+int cachesim_get_dram_stats(cachesim*,cachesim_dram_stats*);
+
+/*
+ * dead-block prediction at one set-associative level, choosing where a
+ * fill goes in the LRU order or whether it is made at all. A table of
+ * 3-bit counters indexed by a signature of the missing access (its address
+ * region and whether it writes) learns which fills are never hit before
+ * eviction; each line keeps the signature it was filled with in 16 bits.
+ * A fill is predicted dead when its counter is 0. Policies:
+ *   MRU        fill at MRU, the model's own behaviour; the predictor only watches
+ *   LRU        fill at LRU, the next victim of its set unless hit first (LIP)
+ *   BIMODAL    one fill in 32 at MRU, the rest at LRU (BIP)
+ *   PREDICTED  predicted-dead fills at LRU, others at MRU
+ *   BYPASS     predicted-dead misses are not filled, except one in 32 filled
+ *              at LRU so the predictor keeps learning
+ * Accuracy counts over filled lines: a predicted-dead line that is hit was
+ * mispredicted, and a line evicted without a hit was dead whether predicted
+ * or not. Enable before simulating; serial driver only, the parallel,
+ * pipelined and time-sliced modes refuse it.
+ */
+typedef enum
+{
+    CACHESIM_INSERT_MRU = 0,
+    CACHESIM_INSERT_LRU,
+    CACHESIM_INSERT_BIMODAL,
+    CACHESIM_INSERT_PREDICTED,
+    CACHESIM_BYPASS_PREDICTED
+}cachesim_insert_policy;
+
+typedef struct
+{
+    unsigned level;         // 0 is L1
+    cachesim_insert_policy policy;
+    unsigned region_bits;   // signature address region of 2^region_bits bytes, 0 is 12
+}cachesim_deadblock_config;
+
+typedef struct
+{
+    uint64_t fills;
+    uint64_t bypasses;      // misses left unfilled
+    uint64_t lru_inserts;   // fills placed at LRU
+    uint64_t predicted_dead;    // misses whose signature predicted dead
+    uint64_t dead_evictions;    // filled lines evicted without a hit
+    uint64_t true_dead;     // of those, predicted dead
+    uint64_t missed_dead;   // of those, not predicted
+    uint64_t false_dead;    // predicted-dead lines that were hit
+    double accuracy;        // true_dead over true_dead + false_dead
+    double coverage;        // true_dead over dead_evictions
+}cachesim_deadblock_stats;
+
+// -1 for a level that is not set-associative, an unknown policy or out of memory
+int cachesim_enable_deadblock(cachesim*,const cachesim_deadblock_config*);
+int cachesim_get_deadblock_stats(const cachesim*,cachesim_deadblock_stats*);
+
+#endif
@@ -0,0 +1,140 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "cachesim.h"
+#include "cachesimd.h"
+
+/*
+ * minimal cachesimd client: run a range of a trace on a two level hierarchy
+ * held by the daemon and print the same totals as Cache.Grp1
+ *
+ * usage: cachesim_client socket benchmark first count size1 a1 b1 victim_size1
+ *                        size2 a2 b2 victim_size2
+ */
+
+static int
+read_full(int fd,void* buf,size_t n)
+{
+    char* p = buf;
+    while(n)
+    {
+        ssize_t got = read(fd,p,n);
+        if(got < 0 && errno == EINTR)
+            continue;
+        if(got <= 0)
+            return -1;
+        p += got;
+        n -= got;
+    }
+    return 0;
+}
+
+static int
+write_full(int fd,const void* buf,size_t n)
+{
+    const char* p = buf;
+    while(n)
+    {
+        ssize_t put = write(fd,p,n);
+        if(put < 0 && errno == EINTR)
+            continue;
+        if(put <= 0)
+            return -1;
+        p += put;
+        n -= put;
+    }
+    return 0;
+}
+
+static int
+transact(int fd,uint32_t type,const void* payload,uint32_t length,void* out,uint32_t out_length)
+{
+    csd_request req = {CSD_MAGIC, type, length};
+    csd_reply rep;
+    if(write_full(fd,&req,sizeof(req)) || (length && write_full(fd,payload,length)))
+        return -1;
+    if(read_full(fd,&rep,sizeof(rep)))
+        return -1;
+    if(rep.status != CSD_OK)
+        return rep.status;
+    if(rep.length != out_length || (out_length && read_full(fd,out,out_length)))
+        return -1;
+    return 0;
+}
+
+int
+main(int argc, char *argv[])
+{
+    if(argc < 13)
+    {
+        printf("Invalid arguments!");
+        exit(0);
+    }
+
+    struct sockaddr_un addr;
+    memset(&addr,0,sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path,argv[1],sizeof(addr.sun_path) - 1);
+    int fd = socket(AF_UNIX,SOCK_STREAM,0);
+    if(fd < 0 || connect(fd,(struct sockaddr*)&addr,sizeof(addr)))
+    {
+        printf("Unable to connect to %s\n",argv[1]);
+        exit(0);
+    }
+
+    cachesim_config config;
+    memset(&config,0,sizeof(config));
+    config.n_levels = 2;
+    for(unsigned l = 0;l < 2;++l)
+    {
+        config.level[l].size = atoi(argv[5 + 4*l]);
+        config.level[l].assoc = atoi(argv[6 + 4*l]);
+        config.level[l].line_size = atoi(argv[7 + 4*l]);
+        config.level[l].victim_size = atoi(argv[8 + 4*l]);
+    }
+
+    uint32_t handle;
+    int err = transact(fd,CSD_CONFIGURE,&config,sizeof(config),&handle,sizeof(handle));
+    if(err)
+    {
+        printf("configure failed (%d)\n",err);
+        exit(0);
+    }
+
+    size_t name_len = strlen(argv[2]);
+    unsigned char* run = malloc(sizeof(csd_run_trace) + name_len);
+    if(!run)
+    {
+        printf("Unable to allocate request\n");
+        exit(0);
+    }
+    csd_run_trace range = {handle, 0, strtoull(argv[3],NULL,0), strtoull(argv[4],NULL,0)};
+    memcpy(run,&range,sizeof(range));
+    memcpy(run + sizeof(range),argv[2],name_len);
+    uint64_t simulated;
+    err = transact(fd,CSD_RUN_TRACE,run,sizeof(range) + name_len,&simulated,sizeof(simulated));
+    free(run);
+
+    csd_stats stats;
+    if(!err)
+        err = transact(fd,CSD_STATS,&handle,sizeof(handle),&stats,sizeof(stats));
+    transact(fd,CSD_DESTROY,&handle,sizeof(handle),NULL,0);
+    close(fd);
+    if(err)
+    {
+        printf("simulation failed (%d)\n",err);
+        exit(0);
+    }
+
+    printf("total cache accesses:%zu\n",(size_t)stats.accesses);
+    printf("L1 hits: %zu\tmiss:%zu\tcold:%zu\nL2:hits: %zu\tmiss:%zu\tcold:%zu\n\n",stats.level[0].hits,
+            stats.level[0].total_misses,stats.level[0].cold_misses,stats.level[1].hits,
+            stats.level[1].total_misses,stats.level[1].cold_misses);
+    return 0;
+}
@@ -0,0 +1,404 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <limits.h>
+#include <signal.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+#include "cachesim.h"
+#include "cachesimd.h"
+
+/*
+ * cachesimd: keeps cache hierarchies and mmapped traces resident and serves
+ * simulation requests over a Unix domain socket, one thread per client
+ *
+ * usage: cachesimd [--trace-dir=DIR] socket
+ * traces are resolved as DIR/<name>.trace (default CacheonlyTraces/Traces)
+ */
+
+typedef struct
+{
+    cachesim* sim;
+    pthread_mutex_t lock;   // held while a request runs on the hierarchy
+    int in_use;             // handed out and not yet destroyed, under slots_lock
+}csd_slot;
+
+typedef struct trace_map trace_map;
+struct trace_map
+{
+    char name[CSD_MAX_TRACE_NAME];
+    const unsigned char* records;
+    uint64_t n_records;
+    trace_map* next;
+};
+
+static csd_slot slots[CSD_MAX_HANDLES];
+static pthread_mutex_t slots_lock = PTHREAD_MUTEX_INITIALIZER;
+static trace_map* traces = NULL;
+static pthread_mutex_t traces_lock = PTHREAD_MUTEX_INITIALIZER;
+static const char* trace_dir = "CacheonlyTraces/Traces";
+
+static int
+read_full(int fd,void* buf,size_t n)
+{
+    char* p = buf;
+    while(n)
+    {
+        ssize_t got = read(fd,p,n);
+        if(got < 0 && errno == EINTR)
+            continue;
+        if(got <= 0)
+            return -1;
+        p += got;
+        n -= got;
+    }
+    return 0;
+}
+
+static int
+write_full(int fd,const void* buf,size_t n)
+{
+    const char* p = buf;
+    while(n)
+    {
+        ssize_t put = write(fd,p,n);
+        if(put < 0 && errno == EINTR)
+            continue;
+        if(put <= 0)
+            return -1;
+        p += put;
+        n -= put;
+    }
+    return 0;
+}
+
+static int
+reply(int fd,csd_status status,const void* payload,uint32_t length)
+{
+    csd_reply r = {status, status == CSD_OK ? length : 0};
+    if(write_full(fd,&r,sizeof(r)))
+        return -1;
+    return r.length ? write_full(fd,payload,r.length) : 0;
+}
+
+/*
+ * find the mapping of a trace, mapping it on first use
+ */
+static const trace_map*
+get_trace(const char* name)
+{
+    pthread_mutex_lock(&traces_lock);
+    trace_map* t;
+    for(t = traces;t;t = t->next)
+        if(!strcmp(t->name,name))
+            break;
+    if(!t && !strchr(name,'/'))
+    {
+        char path[PATH_MAX];
+        snprintf(path,sizeof(path),"%s/%s.trace",trace_dir,name);
+        int fd = open(path,O_RDONLY);
+        struct stat st;
+        if(fd >= 0 && !fstat(fd,&st) && st.st_size >= CACHESIM_RECORD_SIZE)
+        {
+            void* records = mmap(NULL,st.st_size,PROT_READ,MAP_SHARED,fd,0);
+            if(records != MAP_FAILED)
+            {
+                madvise(records,st.st_size,MADV_SEQUENTIAL);
+                t = malloc(sizeof(trace_map));
+                if(t)
+                {
+                    strcpy(t->name,name);
+                    t->records = records;
+                    t->n_records = st.st_size/CACHESIM_RECORD_SIZE;
+                    t->next = traces;
+                    traces = t;
+                }
+                else
+                    munmap(records,st.st_size);
+            }
+        }
+        if(fd >= 0)
+            close(fd);
+    }
+    pthread_mutex_unlock(&traces_lock);
+    return t;
+}
+
+/*
+ * look up a handle and lock its hierarchy; NULL if it does not exist
+ */
+static csd_slot*
+acquire(uint32_t handle)
+{
+    if(handle >= CSD_MAX_HANDLES)
+        return NULL;
+    csd_slot* slot = &slots[handle];
+    pthread_mutex_lock(&slot->lock);
+    if(!slot->sim)
+    {
+        pthread_mutex_unlock(&slot->lock);
+        return NULL;
+    }
+    return slot;
+}
+
+static int
+handle_configure(int fd,const unsigned char* payload,uint32_t length)
+{
+    cachesim_config config;
+    if(length != sizeof(config))
+        return reply(fd,CSD_EBADREQ,NULL,0);
+    memcpy(&config,payload,sizeof(config));
+    cachesim* sim = cachesim_create(&config);
+    if(!sim)
+        return reply(fd,CSD_ECONFIG,NULL,0);
+
+    // claim a slot without touching the slot locks, which runs may hold for long
+    pthread_mutex_lock(&slots_lock);
+    uint32_t handle;
+    for(handle = 0;handle < CSD_MAX_HANDLES && slots[handle].in_use;++handle)
+        ;
+    if(handle < CSD_MAX_HANDLES)
+        slots[handle].in_use = 1;
+    pthread_mutex_unlock(&slots_lock);
+    if(handle == CSD_MAX_HANDLES)
+    {
+        cachesim_destroy(sim);
+        return reply(fd,CSD_EFULL,NULL,0);
+    }
+    // a free slot has no hierarchy, so its lock is at most held to find that out
+    pthread_mutex_lock(&slots[handle].lock);
+    slots[handle].sim = sim;
+    pthread_mutex_unlock(&slots[handle].lock);
+    return reply(fd,CSD_OK,&handle,sizeof(handle));
+}
+
+static int
+handle_access(int fd,const unsigned char* payload,uint32_t length)
+{
+    csd_access req;
+    if(length < sizeof(req))
+        return reply(fd,CSD_EBADREQ,NULL,0);
+    memcpy(&req,payload,sizeof(req));
+    if(length != sizeof(req) + (uint64_t)req.n*(sizeof(uint32_t) + 1))
+        return reply(fd,CSD_EBADREQ,NULL,0);
+
+    // the address array may be unaligned inside the payload
+    uint32_t* addresses = malloc(req.n*sizeof(uint32_t) + 1);
+    if(!addresses)
+        return reply(fd,CSD_ENOMEM,NULL,0);
+    memcpy(addresses,payload + sizeof(req),req.n*sizeof(uint32_t));
+    const char* ops = (const char*)payload + sizeof(req) + req.n*sizeof(uint32_t);
+
+    csd_slot* slot = acquire(req.handle);
+    if(!slot)
+    {
+        free(addresses);
+        return reply(fd,CSD_EHANDLE,NULL,0);
+    }
+    cachesim_access_batch(slot->sim,addresses,ops,req.n,NULL);
+    uint64_t accesses = cachesim_accesses(slot->sim);
+    pthread_mutex_unlock(&slot->lock);
+    free(addresses);
+    return reply(fd,CSD_OK,&accesses,sizeof(accesses));
+}
+
+static int
+handle_run_trace(int fd,const unsigned char* payload,uint32_t length)
+{
+    csd_run_trace req;
+    char name[CSD_MAX_TRACE_NAME];
+    if(length <= sizeof(req) || length - sizeof(req) >= sizeof(name))
+        return reply(fd,CSD_EBADREQ,NULL,0);
+    memcpy(&req,payload,sizeof(req));
+    memcpy(name,payload + sizeof(req),length - sizeof(req));
+    name[length - sizeof(req)] = 0;
+
+    const trace_map* trace = get_trace(name);
+    if(!trace || req.first > trace->n_records)
+        return reply(fd,CSD_ETRACE,NULL,0);
+    uint64_t count = req.count;
+    if(count > trace->n_records - req.first)
+        count = trace->n_records - req.first;
+
+    csd_slot* slot = acquire(req.handle);
+    if(!slot)
+        return reply(fd,CSD_EHANDLE,NULL,0);
+    cachesim_run_trace(slot->sim,trace->records + req.first*CACHESIM_RECORD_SIZE,count);
+    pthread_mutex_unlock(&slot->lock);
+    return reply(fd,CSD_OK,&count,sizeof(count));
+}
+
+static int
+handle_simple(int fd,uint32_t type,const unsigned char* payload,uint32_t length)
+{
+    uint32_t handle;
+    if(length != sizeof(handle))
+        return reply(fd,CSD_EBADREQ,NULL,0);
+    memcpy(&handle,payload,sizeof(handle));
+    csd_slot* slot = acquire(handle);
+    if(!slot)
+        return reply(fd,CSD_EHANDLE,NULL,0);
+
+    csd_stats stats;
+    memset(&stats,0,sizeof(stats));
+    switch(type)
+    {
+        case(CSD_STATS):
+            stats.accesses = cachesim_accesses(slot->sim);
+            stats.n_levels = cachesim_levels(slot->sim);
+            for(unsigned l = 0;l < stats.n_levels;++l)
+                cachesim_get_stats(slot->sim,l,&stats.level[l]);
+            break;
+        case(CSD_RESET):
+            cachesim_reset(slot->sim);
+            break;
+        case(CSD_DESTROY):
+            cachesim_destroy(slot->sim);
+            slot->sim = NULL;
+            break;
+    }
+    pthread_mutex_unlock(&slot->lock);
+    if(type == CSD_DESTROY)
+    {
+        // the handle may be handed out again only once its hierarchy is gone
+        pthread_mutex_lock(&slots_lock);
+        slot->in_use = 0;
+        pthread_mutex_unlock(&slots_lock);
+    }
+    if(type == CSD_STATS)
+        return reply(fd,CSD_OK,&stats,sizeof(stats));
+    return reply(fd,CSD_OK,NULL,0);
+}
+
+/*
+ * serve one client until it disconnects or sends something malformed
+ */
+static void*
+serve_client(void* arg)
+{
+    int fd = (int)(intptr_t)arg;
+    unsigned char* payload = NULL;
+    size_t capacity = 0;
+    for(;;)
+    {
+        csd_request req;
+        if(read_full(fd,&req,sizeof(req)) || req.magic != CSD_MAGIC || req.length > CSD_MAX_PAYLOAD)
+            break;
+        if(req.length > capacity)
+        {
+            unsigned char* grown = realloc(payload,req.length);
+            if(!grown)
+                break;
+            payload = grown;
+            capacity = req.length;
+        }
+        if(req.length && read_full(fd,payload,req.length))
+            break;
+
+        int err;
+        switch(req.type)
+        {
+            case(CSD_CONFIGURE):
+                err = handle_configure(fd,payload,req.length);
+                break;
+            case(CSD_ACCESS):
+                err = handle_access(fd,payload,req.length);
+                break;
+            case(CSD_RUN_TRACE):
+                err = handle_run_trace(fd,payload,req.length);
+                break;
+            case(CSD_STATS):
+            case(CSD_RESET):
+            case(CSD_DESTROY):
+                err = handle_simple(fd,req.type,payload,req.length);
+                break;
+            default:
+                err = reply(fd,CSD_EBADREQ,NULL,0);
+        }
+        if(err)
+            break;
+    }
+    free(payload);
+    close(fd);
+    return NULL;
+}
+
+int
+main(int argc, char *argv[])
+{
+    static const struct option long_options[] =
+    {
+        {"trace-dir", required_argument, NULL, 't'},
+        {NULL, 0, NULL, 0}
+    };
+    int opt;
+    while((opt = getopt_long(argc,argv,"",long_options,NULL)) != -1)
+    {
+        switch(opt)
+        {
+            case('t'):
+                trace_dir = optarg;
+                break;
+            default:
+                printf("usage: %s [--trace-dir=DIR] socket\n",argv[0]);
+                exit(0);
+        }
+    }
+    if(optind >= argc)
+    {
+        printf("usage: %s [--trace-dir=DIR] socket\n",argv[0]);
+        exit(0);
+    }
+
+    struct sockaddr_un addr;
+    memset(&addr,0,sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if(strlen(argv[optind]) >= sizeof(addr.sun_path))
+    {
+        printf("Socket path too long\n");
+        exit(0);
+    }
+    strcpy(addr.sun_path,argv[optind]);
+
+    for(int i = 0;i < CSD_MAX_HANDLES;++i)
+        pthread_mutex_init(&slots[i].lock,NULL);
+    signal(SIGPIPE,SIG_IGN);
+
+    int listener = socket(AF_UNIX,SOCK_STREAM,0);
+    unlink(addr.sun_path);
+    if(listener < 0 || bind(listener,(struct sockaddr*)&addr,sizeof(addr)) || listen(listener,64))
+    {
+        printf("Unable to listen on %s: %s\n",addr.sun_path,strerror(errno));
+        exit(0);
+    }
+
+    for(;;)
+    {
+        int client = accept(listener,NULL,NULL);
+        if(client < 0)
+        {
+            if(errno == EINTR)
+                continue;
+            break;
+        }
+        pthread_t thread;
+        if(pthread_create(&thread,NULL,serve_client,(void*)(intptr_t)client))
+        {
+            close(client);
+            continue;
+        }
+        pthread_detach(thread);
+    }
+    close(listener);
+    return 0;
+}
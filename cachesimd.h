@@ -0,0 +1,93 @@
+#ifndef CACHESIMD_H
+#define CACHESIMD_H
+
+#include <stdint.h>
+
+#include "cachesim.h"
+
+/*
+ * wire protocol of cachesimd, the persistent simulation daemon
+ *
+ * Every request is a csd_request header followed by length payload bytes,
+ * every reply a csd_reply header followed by length payload bytes. All
+ * integers are in host byte order since the socket is local.
+ *
+ * request          payload                                   reply payload
+ * CSD_CONFIGURE    cachesim_config                           uint32 handle
+ * CSD_ACCESS       csd_access, n uint32 addresses, n ops     uint64 accesses so far
+ * CSD_RUN_TRACE    csd_run_trace, trace name (no NUL)        uint64 records simulated
+ * CSD_STATS        uint32 handle                             csd_stats
+ * CSD_RESET        uint32 handle                             none
+ * CSD_DESTROY      uint32 handle                             none
+ *
+ * Hierarchies live in the daemon until destroyed, so any client may keep
+ * using a handle across connections. Traces are mmapped on first use and
+ * stay mapped.
+ */
+
+/*
+ * bumped whenever a payload layout changes; CSD2 is the first with
+ * cachesim_level_config.index_fn, so CSD1 clients must be rebuilt
+ */
+#define CSD_MAGIC 0x43534432u       // "CSD2"
+#define CSD_MAX_PAYLOAD (64u << 20)
+#define CSD_MAX_HANDLES 1024
+#define CSD_MAX_TRACE_NAME 256
+
+typedef enum
+{
+    CSD_CONFIGURE = 1,
+    CSD_ACCESS,
+    CSD_RUN_TRACE,
+    CSD_STATS,
+    CSD_RESET,
+    CSD_DESTROY
+}csd_type;
+
+typedef enum
+{
+    CSD_OK = 0,
+    CSD_EBADREQ,        // malformed request
+    CSD_EHANDLE,        // unknown handle
+    CSD_ECONFIG,        // cachesim_create() rejected the configuration
+    CSD_ETRACE,         // trace could not be opened or range is outside it
+    CSD_EFULL,          // no free handles
+    CSD_ENOMEM          // the daemon ran out of memory
+}csd_status;
+
+typedef struct
+{
+    uint32_t magic;
+    uint32_t type;
+    uint32_t length;
+}csd_request;
+
+typedef struct
+{
+    uint32_t status;
+    uint32_t length;
+}csd_reply;
+
+typedef struct
+{
+    uint32_t handle;
+    uint32_t n;
+}csd_access;
+
+typedef struct
+{
+    uint32_t handle;
+    uint32_t reserved;
+    uint64_t first;     // first record to simulate
+    uint64_t count;     // records to simulate, clipped to the end of the trace
+}csd_run_trace;
+
+typedef struct
+{
+    uint64_t accesses;
+    uint32_t n_levels;
+    uint32_t reserved;
+    cache_stats level[CACHESIM_MAX_LEVELS];
+}csd_stats;
+
+#endif
@@ -0,0 +1,179 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <limits.h>
+
+#include "cache.h"
+
+#define BIMODAL_PERIOD 32       // one fill in 32 goes to MRU under bimodal insertion
+#define BYPASS_SAMPLE 32        // one predicted-dead fill in 32 is kept, at LRU, to train on
+#define LRU_FIRST (-SSIZE_MAX - 1)
+
+deadblock_state*
+deadblock_create(const cachesim_deadblock_config* config,unsigned ways,unsigned n_sets)
+{
+    if(config->policy > CACHESIM_BYPASS_PREDICTED || config->region_bits > 31)
+        return NULL;
+    deadblock_state* d = calloc(1,sizeof(deadblock_state));
+    if(!d)
+        return NULL;
+    d->config = *config;
+    if(!d->config.region_bits)
+        d->config.region_bits = 12;
+    d->ways = ways;
+    d->meta = malloc((size_t)n_sets*ways*sizeof(uint16_t));
+    d->n_sets = n_sets;
+    d->counters = malloc(1u << DEADBLOCK_TABLE_BITS);
+    if(!d->meta || !d->counters)
+    {
+        deadblock_destroy(d);
+        return NULL;
+    }
+    deadblock_reset(d);
+    return d;
+}
+
+void
+deadblock_destroy(deadblock_state* d)
+{
+    if(!d)
+        return;
+    free(d->meta);
+    free(d->counters);
+    free(d);
+}
+
+/*
+ * forget every line and signature; counters start one step from dead so
+ * a signature needs a single dead eviction before it predicts
+ */
+void
+deadblock_reset(deadblock_state* d)
+{
+    memset(d->meta,0,(size_t)d->n_sets*d->ways*sizeof(uint16_t));
+    memset(d->counters,1,1u << DEADBLOCK_TABLE_BITS);
+    d->tick = 0;
+    memset(&d->stats,0,sizeof(d->stats));
+}
+
+static inline unsigned
+signature(const deadblock_state* d,uint32_t address,char op)
+{
+    uint32_t key = (address >> d->config.region_bits) << 1 | (op == 'w');
+    return (key*0x9e3779b1u) >> (32 - DEADBLOCK_TABLE_BITS);
+}
+
+// a valid line leaves the cache: settle its prediction and train on it
+static inline void
+retire(deadblock_state* d,uint16_t meta)
+{
+    if(meta & DEADBLOCK_REUSED)
+        return;
+    uint8_t* c = &d->counters[meta & DEADBLOCK_SIGNATURE];
+    if(*c)
+        --*c;
+    ++d->stats.dead_evictions;
+    if(meta & DEADBLOCK_PREDICTED)
+        ++d->stats.true_dead;
+    else
+        ++d->stats.missed_dead;
+}
+
+/*
+ * access_cache for the predicted level: hits and victims are found as in
+ * the model (LRU over the ways of alloc_mask, lines dirty once written),
+ * except that an invalid way always goes first, which only differs from
+ * the model when a line was filled at clock 0. The policy picks the stamp of a fill: now for MRU, just below the oldest other line
+ * of the set for LRU, or no fill at all for a bypass.
+ */
+int
+deadblock_access(deadblock_state* d,cache_t* cache,address_info af,uint32_t address,char op,ssize_t now)
+{
+    cache_t* set = &cache->sets[af.index];
+    uint16_t* meta = d->meta + (size_t)af.index*d->ways;
+    for(unsigned w = 0;w < set->n;++w)
+    {
+        cache_line* line = &set->lines[w];
+        if(line->valid && line->tag == af.tag)
+        {
+            line->dirty |= op == 'w';
+            line->last_used_time = now;
+            ++cache->stats.hits;
+            if(!(meta[w] & DEADBLOCK_REUSED))
+            {
+                uint8_t* c = &d->counters[meta[w] & DEADBLOCK_SIGNATURE];
+                if(*c < DEADBLOCK_COUNTER_MAX)
+                    ++*c;
+                if(meta[w] & DEADBLOCK_PREDICTED)
+                    ++d->stats.false_dead;
+                meta[w] |= DEADBLOCK_REUSED;
+            }
+            return 1;
+        }
+    }
+
+    ++cache->stats.total_misses;
+    unsigned sig = signature(d,address,op);
+    int dead = !d->counters[sig];
+    d->stats.predicted_dead += dead;
+    cachesim_insert_policy policy = d->config.policy;
+    d->bypassed = policy == CACHESIM_BYPASS_PREDICTED && dead && ++d->tick % BYPASS_SAMPLE;
+    if(d->bypassed)
+    {
+        ++d->stats.bypasses;
+        memset(&cache->evicted,0,sizeof(cache_line));
+        return 0;
+    }
+
+    unsigned victim = 0;
+    ssize_t oldest = SSIZE_MAX;
+    for(unsigned w = 0;w < set->n;++w)
+    {
+        ssize_t key = set->lines[w].valid ? set->lines[w].last_used_time : LRU_FIRST;
+        if(key < oldest && (!cache->alloc_mask || ((cache->alloc_mask >> w) & 1)))
+        {
+            oldest = key;
+            victim = w;
+        }
+    }
+    cache_line* line = &set->lines[victim];
+    cache->evicted = *line;
+    if(line->valid)
+        retire(d,meta[victim]);
+    else
+        ++cache->stats.cold_misses;
+
+    int lru;
+    switch(policy)
+    {
+        case(CACHESIM_INSERT_LRU):
+            lru = 1;
+            break;
+        case(CACHESIM_INSERT_BIMODAL):
+            lru = ++d->tick % BIMODAL_PERIOD != 0;
+            break;
+        case(CACHESIM_INSERT_PREDICTED):
+        case(CACHESIM_BYPASS_PREDICTED):
+            lru = dead;
+            break;
+        default:
+            lru = 0;
+            break;
+    }
+    ssize_t stamp = now;
+    if(lru)
+    {
+        for(unsigned w = 0;w < set->n;++w)
+            if(w != victim && set->lines[w].valid && set->lines[w].last_used_time <= stamp)
+                stamp = set->lines[w].last_used_time - 1;
+        ++d->stats.lru_inserts;
+    }
+    line->tag = af.tag;
+    line->owner = cache->alloc_class;
+    line->valid = 1;
+    line->dirty = op == 'w';
+    line->last_used_time = stamp;
+    meta[victim] = sig | (dead ? DEADBLOCK_PREDICTED : 0);
+    ++d->stats.fills;
+    return 0;
+}
@@ -0,0 +1,44 @@
+#ifndef DEADBLOCK_H
+#define DEADBLOCK_H
+
+#include <stdint.h>
+#include <sys/types.h>
+
+#include "cachesim.h"
+
+/*
+ * Dead-block prediction state of one set-associative level: a table of
+ * saturating counters indexed by a signature of the filling access, and
+ * per line the signature it was filled with plus whether it was predicted
+ * dead and whether it has been reused since.
+ *
+ * A line that is evicted without a hit trains its signature toward dead,
+ * the first hit to a line trains it toward live (sampling dead-block
+ * prediction in the manner of Khan, Tian and Jimenez, with an address
+ * region standing in for the PC the traces do not carry). Accuracy is
+ * settled when a line leaves the cache or is hit.
+ */
+
+#define DEADBLOCK_TABLE_BITS 14
+#define DEADBLOCK_COUNTER_MAX 3
+#define DEADBLOCK_PREDICTED 0x4000  // meta: filled while its signature predicted dead
+#define DEADBLOCK_REUSED 0x8000     // meta: hit since it was filled
+#define DEADBLOCK_SIGNATURE 0x3fff
+
+typedef struct
+{
+    cachesim_deadblock_config config;
+    unsigned ways;
+    unsigned n_sets;
+    uint16_t* meta;         // [set][way]
+    uint8_t* counters;      // [1 << DEADBLOCK_TABLE_BITS]
+    uint64_t tick;          // misses toward the next bimodal MRU fill or kept bypass
+    int bypassed;           // the last miss filled nothing
+    cachesim_deadblock_stats stats;
+}deadblock_state;
+
+deadblock_state* deadblock_create(const cachesim_deadblock_config*,unsigned,unsigned);
+void deadblock_destroy(deadblock_state*);
+void deadblock_reset(deadblock_state*);
+
+#endif
@@ -0,0 +1,248 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "dram.h"
+
+static inline int
+power_of_two(unsigned x)
+{
+    return x && !(x & (x - 1));
+}
+
+static inline unsigned
+bits_of(unsigned x)
+{
+    return __builtin_ctz(x);
+}
+
+dram_model*
+dram_create(const cachesim_dram_config* config,unsigned line_bits)
+{
+    const cachesim_dram_config* c = config;
+    if(!power_of_two(c->channels) || !power_of_two(c->ranks) || !power_of_two(c->banks) ||
+       !power_of_two(c->row_bytes) || c->row_bytes < (1u << line_bits) || !c->queue ||
+       c->ranks*c->banks > 65536 || c->mapping > CACHESIM_DRAM_MAP_XOR)
+        return NULL;
+    dram_model* d = calloc(1,sizeof(dram_model));
+    if(!d)
+        return NULL;
+    d->config = *config;
+    if(!d->config.access_cycles)
+        d->config.access_cycles = 1;
+    d->line_bits = line_bits;
+    d->column_bits = bits_of(c->row_bytes) - line_bits;
+    d->channel_bits = bits_of(c->channels);
+    d->bank_bits = bits_of(c->banks);
+    d->rank_bits = bits_of(c->ranks);
+    d->channels = calloc(c->channels,sizeof(dram_channel));
+    if(!d->channels)
+    {
+        free(d);
+        return NULL;
+    }
+    for(unsigned ch = 0;ch < c->channels;++ch)
+    {
+        d->channels[ch].queue = malloc(c->queue*sizeof(dram_queued));
+        d->channels[ch].banks = malloc(c->ranks*c->banks*sizeof(dram_bank));
+        if(!d->channels[ch].queue || !d->channels[ch].banks)
+        {
+            dram_destroy(d);
+            return NULL;
+        }
+    }
+    dram_reset(d);
+    return d;
+}
+
+void
+dram_destroy(dram_model* d)
+{
+    if(!d)
+        return;
+    for(unsigned ch = 0;ch < d->config.channels;++ch)
+    {
+        free(d->channels[ch].queue);
+        free(d->channels[ch].banks);
+    }
+    free(d->channels);
+    free(d);
+}
+
+void
+dram_reset(dram_model* d)
+{
+    for(unsigned ch = 0;ch < d->config.channels;++ch)
+    {
+        dram_channel* c = &d->channels[ch];
+        c->n = 0;
+        c->next = 0;
+        c->bus_free = 0;
+        for(unsigned b = 0;b < d->config.ranks*d->config.banks;++b)
+            c->banks[b] = (dram_bank){-1, 0};
+    }
+    d->n_batch = 0;
+    dram_clear_stats(d);
+}
+
+void
+dram_clear_stats(dram_model* d)
+{
+    memset(&d->stats,0,sizeof(d->stats));
+    d->latency = 0;
+}
+
+// take the next `bits` bits of the line address
+static inline uint32_t
+field(uint32_t* line,unsigned bits)
+{
+    uint32_t v = *line & ((1u << bits) - 1);
+    *line = bits < 32 ? *line >> bits : 0;
+    return v;
+}
+
+static void
+map_address(const dram_model* d,uint32_t address,unsigned* channel,dram_queued* q)
+{
+    uint32_t line = address >> d->line_bits;
+    unsigned rank, bank;
+    switch(d->config.mapping)
+    {
+        case(CACHESIM_DRAM_MAP_LINE):
+            *channel = field(&line,d->channel_bits);
+            bank = field(&line,d->bank_bits);
+            rank = field(&line,d->rank_bits);
+            field(&line,d->column_bits);
+            q->row = line;
+            break;
+        default:
+            field(&line,d->column_bits);
+            *channel = field(&line,d->channel_bits);
+            bank = field(&line,d->bank_bits);
+            rank = field(&line,d->rank_bits);
+            q->row = line;
+            // rows that conflict in one bank under PAGE spread over the banks
+            if(d->config.mapping == CACHESIM_DRAM_MAP_XOR)
+                bank ^= line & (d->config.banks - 1);
+            break;
+    }
+    q->bank = rank*d->config.banks + bank;
+}
+
+// earliest cycle a queued request can take a command
+static uint64_t
+next_issue(const dram_channel* c)
+{
+    uint64_t t = UINT64_MAX;
+    for(unsigned i = 0;i < c->n;++i)
+    {
+        uint64_t ready = c->banks[c->queue[i].bank].ready;
+        uint64_t at = c->queue[i].arrival > ready ? c->queue[i].arrival : ready;
+        if(at < t)
+            t = at;
+    }
+    return t > c->next ? t : c->next;
+}
+
+/*
+ * FR-FCFS: of the requests that have arrived and whose bank is free at
+ * the next command slot, serve the oldest row hit, else the oldest
+ */
+static void
+schedule(dram_model* d,dram_channel* c)
+{
+    const cachesim_dram_config* cfg = &d->config;
+    uint64_t t = next_issue(c);
+    int pick = -1;
+    for(unsigned i = 0;i < c->n && c->queue[i].arrival <= t;++i)
+    {
+        const dram_bank* b = &c->banks[c->queue[i].bank];
+        if(b->ready > t)
+            continue;
+        if(pick < 0)
+            pick = i;
+        if(b->open_row == c->queue[i].row)
+        {
+            pick = i;
+            break;
+        }
+    }
+    dram_queued q = c->queue[pick];
+    memmove(c->queue + pick,c->queue + pick + 1,(c->n - pick - 1)*sizeof(dram_queued));
+    --c->n;
+    c->next = t + 1;
+
+    dram_bank* b = &c->banks[q.bank];
+    if(b->ready > q.arrival && b->open_row != q.row)
+        ++d->stats.bank_conflicts;
+    uint64_t data;
+    if(b->open_row == q.row)
+    {
+        ++d->stats.row_hits;
+        data = t + cfg->t_cl;
+    }
+    else if(b->open_row < 0)
+    {
+        ++d->stats.row_empty;
+        data = t + cfg->t_rcd + cfg->t_cl;
+    }
+    else
+    {
+        ++d->stats.row_conflicts;
+        data = t + cfg->t_rp + cfg->t_rcd + cfg->t_cl;
+    }
+    uint64_t burst = data > c->bus_free ? data : c->bus_free;
+    uint64_t done = burst + cfg->t_burst;
+    c->bus_free = done;
+    d->stats.busy_cycles += cfg->t_burst;
+    if(cfg->closed_page)
+    {
+        b->open_row = -1;
+        b->ready = done + cfg->t_rp;
+    }
+    else
+    {
+        // column commands to the open row pipeline a burst apart
+        b->open_row = q.row;
+        b->ready = burst - cfg->t_cl + cfg->t_burst;
+    }
+    if(q.write)
+        ++d->stats.writes;
+    else
+    {
+        ++d->stats.reads;
+        d->latency += done - q.arrival;
+    }
+    if(done > d->stats.cycles)
+        d->stats.cycles = done;
+}
+
+void
+dram_flush(dram_model* d,int drain)
+{
+    for(unsigned i = 0;i < d->n_batch;++i)
+    {
+        const dram_request* r = &d->batch[i];
+        unsigned ch;
+        dram_queued q;
+        map_address(d,r->address,&ch,&q);
+        q.arrival = r->arrival;
+        q.write = r->write;
+        dram_channel* c = &d->channels[ch];
+        // everything the channel issues before this request arrives
+        while(c->n && next_issue(c) < q.arrival)
+            schedule(d,c);
+        if(c->n == d->config.queue)
+        {
+            ++d->stats.queue_full;
+            schedule(d,c);
+        }
+        c->queue[c->n++] = q;
+    }
+    d->n_batch = 0;
+    if(!drain)
+        return;
+    for(unsigned ch = 0;ch < d->config.channels;++ch)
+        while(d->channels[ch].n)
+            schedule(d,&d->channels[ch]);
+}
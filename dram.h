@@ -0,0 +1,77 @@
+#ifndef DRAM_H
+#define DRAM_H
+
+#include <stdint.h>
+
+#include "cachesim.h"
+
+/*
+ * DRAM backend state: requests collect in a batch while the hierarchy
+ * simulates and go to the channel queues when it fills; the scheduler of
+ * a channel runs only as far as the arrival of the next request needs.
+ */
+
+#define DRAM_BATCH 4096
+
+typedef struct
+{
+    uint64_t arrival;
+    uint32_t address;
+    uint32_t write;
+}dram_request;
+
+typedef struct
+{
+    uint64_t arrival;
+    uint32_t row;
+    uint16_t bank;          // rank*banks + bank within the channel
+    uint16_t write;
+}dram_queued;
+
+typedef struct
+{
+    int64_t open_row;       // -1 when precharged
+    uint64_t ready;         // cycle the bank takes its next command
+}dram_bank;
+
+typedef struct
+{
+    dram_queued* queue;     // in arrival order
+    unsigned n;
+    uint64_t next;          // cycle of the next command slot
+    uint64_t bus_free;
+    dram_bank* banks;
+}dram_channel;
+
+typedef struct
+{
+    cachesim_dram_config config;
+    unsigned line_bits;
+    unsigned column_bits, channel_bits, bank_bits, rank_bits;
+    dram_channel* channels;
+    dram_request batch[DRAM_BATCH];
+    unsigned n_batch;
+    uint64_t latency;       // summed read latency
+    cachesim_dram_stats stats;
+}dram_model;
+
+dram_model* dram_create(const cachesim_dram_config*,unsigned);
+void dram_destroy(dram_model*);
+void dram_reset(dram_model*);
+void dram_clear_stats(dram_model*);
+
+// queue the batch; with drain set, also complete everything queued
+void dram_flush(dram_model*,int);
+
+static inline void
+dram_push(dram_model* d,uint64_t time,uint32_t address,int write)
+{
+    dram_request* r = &d->batch[d->n_batch];
+    r->arrival = time*d->config.access_cycles;
+    r->address = address;
+    r->write = write;
+    if(++d->n_batch == DRAM_BATCH)
+        dram_flush(d,0);
+}
+
+#endif
@@ -0,0 +1,80 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "cachesim.h"
+
+/*
+ * decode a miss event log written by Cache.Grp1 --events to CSV, one line
+ * per event; -l and -t keep only one level (1 is L1) or event type
+ *
+ * usage: event_dump [-l level] [-t fill|evict|writeback] file
+ */
+
+#define DUMP_BLOCK 4096
+
+static const char* type_names[] = {"", "fill", "evict", "", "writeback"};
+static const char* class_names[] = {"cold", "capacity", "conflict"};
+
+int
+main(int argc, char *argv[])
+{
+    const char* path = NULL;
+    int level = -1;
+    int type = 0;
+    for(int i = 1;i < argc;++i)
+    {
+        if(!strcmp(argv[i],"-l") && i + 1 < argc)
+            level = atoi(argv[++i]) - 1;
+        else if(!strcmp(argv[i],"-t") && i + 1 < argc)
+        {
+            ++i;
+            for(int t = 1;t < sizeof(type_names)/sizeof(type_names[0]);++t)
+                if(*type_names[t] && !strcmp(argv[i],type_names[t]))
+                    type = t;
+            if(!type)
+            {
+                path = NULL;
+                break;
+            }
+        }
+        else
+            path = argv[i];
+    }
+    if(!path)
+    {
+        printf("usage: %s [-l level] [-t fill|evict|writeback] file\n",argv[0]);
+        exit(0);
+    }
+
+    FILE* fin = fopen(path,"rb");
+    if(fin == 0) { printf("Unable to open event log\n"); exit(0); }
+
+    cachesim_event_header header;
+    if(fread(&header,sizeof(header),1,fin) != 1 || memcmp(header.magic,CACHESIM_EVENT_MAGIC,4) ||
+       header.version != CACHESIM_EVENT_VERSION || header.event_size != sizeof(cachesim_event))
+    {
+        printf("Not an event log of this version\n");
+        exit(0);
+    }
+
+    printf("access,level,op,type,class,address,set,evicted_tag\n");
+    cachesim_event* events = malloc(DUMP_BLOCK*sizeof(cachesim_event));
+    size_t got;
+    while((got = fread(events,sizeof(cachesim_event),DUMP_BLOCK,fin)))
+    {
+        for(size_t i = 0;i < got;++i)
+        {
+            const cachesim_event* e = &events[i];
+            if((level >= 0 && e->level != level) || (type && e->type != type))
+                continue;
+            printf("%llu,%u,%c,%s,%s,%#x,%u,%#x\n",(unsigned long long)e->access,e->level + 1,e->op,
+                    e->type < sizeof(type_names)/sizeof(type_names[0]) ? type_names[e->type] : "?",
+                    e->miss_class < 3 ? class_names[e->miss_class] : "?",e->address,e->set,e->evicted_tag);
+        }
+    }
+    free(events);
+    fclose(fin);
+    return 0;
+}
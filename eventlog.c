@@ -0,0 +1,107 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+
+#include "eventlog.h"
+
+#define WRITER_IDLE_US 1000     // writer sleep when every ring is empty
+
+/*
+ * write the published events of q, at most up to the end of the ring
+ * memory at a time; returns how many were written
+ */
+static size_t
+drain(event_log* log,event_ring* q)
+{
+    size_t tail = atomic_load_explicit(&q->tail,memory_order_relaxed);
+    size_t head = atomic_load_explicit(&q->head,memory_order_acquire);
+    size_t total = 0;
+    while(tail != head)
+    {
+        size_t first = tail & (EVENT_RING - 1);
+        size_t n = head - tail < EVENT_RING - first ? head - tail : EVENT_RING - first;
+        if(!log->failed && fwrite(q->ring + first,sizeof(cachesim_event),n,log->out) != n)
+            log->failed = 1;
+        tail += n;
+        total += n;
+        atomic_store_explicit(&q->tail,tail,memory_order_release);
+    }
+    return total;
+}
+
+static void*
+writer_main(void* arg)
+{
+    event_log* log = arg;
+    for(;;)
+    {
+        // read stop first so a drain after it sees every event pushed before it
+        int stopping = atomic_load_explicit(&log->stop,memory_order_acquire);
+        size_t moved = 0;
+        for(unsigned l = 0;l < log->n_levels;++l)
+            moved += drain(log,&log->rings[l]);
+        log->written += moved;
+        if(stopping)
+            return NULL;
+        if(!moved)
+            usleep(WRITER_IDLE_US);
+    }
+}
+
+event_log*
+event_log_open(const char* path,const cachesim_config* config,unsigned levels,unsigned types)
+{
+    event_log* log = calloc(1,sizeof(event_log));
+    if(!log)
+        return NULL;
+    log->levels = levels;
+    log->types = types;
+    log->n_levels = config->n_levels;
+    atomic_init(&log->stop,0);
+    for(unsigned l = 0;l < log->n_levels;++l)
+    {
+        atomic_init(&log->rings[l].head,0);
+        atomic_init(&log->rings[l].tail,0);
+        if(!(log->rings[l].ring = malloc(EVENT_RING*sizeof(cachesim_event))))
+            goto fail;
+    }
+    if(!(log->out = fopen(path,"wb")))
+        goto fail;
+    setvbuf(log->out,NULL,_IOFBF,1 << 20);
+
+    cachesim_event_header header;
+    memset(&header,0,sizeof(header));
+    memcpy(header.magic,CACHESIM_EVENT_MAGIC,4);
+    header.version = CACHESIM_EVENT_VERSION;
+    header.event_size = sizeof(cachesim_event);
+    header.config = *config;
+    if(fwrite(&header,sizeof(header),1,log->out) != 1 || pthread_create(&log->writer,NULL,writer_main,log))
+    {
+        fclose(log->out);
+        unlink(path);
+        goto fail;
+    }
+    return log;
+
+fail:
+    for(unsigned l = 0;l < log->n_levels;++l)
+        free(log->rings[l].ring);
+    free(log);
+    return NULL;
+}
+
+int
+event_log_close(event_log* log,uint64_t* events)
+{
+    atomic_store_explicit(&log->stop,1,memory_order_release);
+    pthread_join(log->writer,NULL);
+    int failed = log->failed | (fclose(log->out) != 0);
+    if(events)
+        *events = log->written;
+    for(unsigned l = 0;l < log->n_levels;++l)
+        free(log->rings[l].ring);
+    free(log);
+    return failed ? -1 : 0;
+}
@@ -0,0 +1,64 @@
+#ifndef EVENTLOG_H
+#define EVENTLOG_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <sched.h>
+
+#include "cachesim.h"
+
+/*
+ * Miss event log: a single-producer, single-consumer ring per level
+ * between the thread simulating the level and the writer thread. The
+ * producer publishes every event with a release store of its head, which
+ * costs a plain store on x86; the writer drains the published part of
+ * each ring straight from ring memory into the file.
+ */
+
+#define EVENT_RING 65536        // events per ring, power of two
+
+typedef struct
+{
+    cachesim_event* ring;
+    _Alignas(64) atomic_size_t head;
+    size_t tail_cache;          // producer: last tail it saw
+    _Alignas(64) atomic_size_t tail;
+}event_ring;
+
+typedef struct
+{
+    unsigned levels;            // bit l logs level l
+    unsigned types;             // cachesim_event_type bits
+    unsigned n_levels;
+    event_ring rings[CACHESIM_MAX_LEVELS];
+    FILE* out;
+    pthread_t writer;
+    atomic_int stop;
+    int failed;
+    uint64_t written;
+}event_log;
+
+event_log* event_log_open(const char*,const cachesim_config*,unsigned,unsigned);
+
+// stop the writer after it drained every ring; -1 if writing failed
+int event_log_close(event_log*,uint64_t*);
+
+static inline void
+event_push(event_log* log,unsigned level,const cachesim_event* e)
+{
+    event_ring* q = &log->rings[level];
+    size_t head = atomic_load_explicit(&q->head,memory_order_relaxed);
+    while(head - q->tail_cache >= EVENT_RING)
+    {
+        // full: wait for the writer to catch up
+        q->tail_cache = atomic_load_explicit(&q->tail,memory_order_acquire);
+        if(head - q->tail_cache >= EVENT_RING)
+            sched_yield();
+    }
+    q->ring[head & (EVENT_RING - 1)] = *e;
+    atomic_store_explicit(&q->head,head + 1,memory_order_release);
+}
+
+#endif
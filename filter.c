@@ -0,0 +1,223 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "cache.h"
+
+/*
+ * Filtered L1 miss streams.
+ *
+ * Sweeps over the lower levels of a hierarchy with a fixed L1 re-simulate
+ * the same L1 on every run although L2 only ever sees its misses. The
+ * recording run writes those misses to a file; replaying it drives L2 and
+ * below with exactly the accesses and access clock they saw, so their stats
+ * and LRU state match a full run while L1 is skipped.
+ *
+ * File layout: one filter_header, then one entry per L1 miss:
+ *   LEB128 varint of (clock delta to the previous miss << 1 | write)
+ *   4 byte little-endian address
+ * The header is rewritten with the totals when the recording closes and the
+ * file is written under a temporary name and renamed into place, so
+ * concurrent runs never replay a partial stream.
+ *
+ * The model does not write dirty evictions back to the next level, so the
+ * stream holds misses only.
+ */
+
+#define FILTER_MAGIC "CSL1"
+#define FILTER_VERSION 1
+
+typedef struct
+{
+    char magic[4];
+    uint32_t version;
+    cachesim_level_config l1;
+    cachesim_filter_key key;
+    uint64_t clock;         // accesses simulated by the recording
+    uint64_t n_misses;
+    uint64_t bytes;         // of the entries following the header
+    cache_stats l1_stats;
+}filter_header;
+
+struct cachesim_filter
+{
+    FILE* out;
+    char* path;
+    char* tmp_path;
+    filter_header header;
+    uint64_t start_clock;
+    uint64_t last_clock;
+    int failed;
+};
+
+cachesim_filter*
+cachesim_filter_record(const cachesim* sim,const char* path,const cachesim_filter_key* key)
+{
+    cachesim_filter* f = calloc(1,sizeof(cachesim_filter));
+    if(!f)
+        return NULL;
+    f->path = strdup(path);
+    f->tmp_path = malloc(strlen(path) + 32);
+    if(!f->path || !f->tmp_path)
+    {
+        free(f->path);
+        free(f->tmp_path);
+        free(f);
+        return NULL;
+    }
+    sprintf(f->tmp_path,"%s.%ld.tmp",path,(long)getpid());
+    f->out = fopen(f->tmp_path,"wb");
+    if(!f->out)
+    {
+        free(f->path);
+        free(f->tmp_path);
+        free(f);
+        return NULL;
+    }
+    setvbuf(f->out,NULL,_IOFBF,1 << 20);
+
+    memcpy(f->header.magic,FILTER_MAGIC,4);
+    f->header.version = FILTER_VERSION;
+    f->header.l1 = sim->config.level[0];
+    f->header.key = *key;
+    f->start_clock = f->last_clock = sim->clock;
+    // placeholder until close knows the totals
+    if(fwrite(&f->header,sizeof(filter_header),1,f->out) != 1)
+        f->failed = 1;
+    return f;
+}
+
+static inline void
+put_miss(cachesim_filter* f,uint64_t clock,uint32_t address,char op)
+{
+    unsigned char entry[16];
+    unsigned len = 0;
+    uint64_t v = ((clock - f->last_clock) << 1) | (op == 'w');
+    while(v >= 0x80)
+    {
+        entry[len++] = v | 0x80;
+        v >>= 7;
+    }
+    entry[len++] = v;
+    memcpy(entry + len,&address,4);
+    len += 4;
+    if(fwrite(entry,1,len,f->out) != len)
+        f->failed = 1;
+    f->header.bytes += len;
+    ++f->header.n_misses;
+    f->last_clock = clock;
+}
+
+size_t
+cachesim_run_trace_filtered(cachesim* sim,cachesim_filter* f,const unsigned char* records,size_t n)
+{
+    uint32_t addresses[TRACE_BATCH];
+    char ops[TRACE_BATCH];
+    unsigned char levels[TRACE_BATCH];
+    for(size_t i = 0;i < n;i += TRACE_BATCH)
+    {
+        size_t batch = n - i < TRACE_BATCH ? n - i : TRACE_BATCH;
+        uint64_t clock = sim->clock;
+        for(size_t k = 0;k < batch;++k)
+            decode_record(records + (i + k)*CACHESIM_RECORD_SIZE,&addresses[k],&ops[k]);
+        cachesim_access_batch(sim,addresses,ops,batch,levels);
+        for(size_t k = 0;k < batch;++k)
+            if(levels[k] && ((ops[k] == 'r') || (ops[k] == 'w')))
+                put_miss(f,clock + k,addresses[k],ops[k]);
+    }
+    return n;
+}
+
+int
+cachesim_filter_close(cachesim_filter* f,const cachesim* sim)
+{
+    f->header.clock = sim->clock - f->start_clock;
+    f->header.l1_stats = sim->levels[0]->stats;
+    if(fseek(f->out,0,SEEK_SET) || fwrite(&f->header,sizeof(filter_header),1,f->out) != 1)
+        f->failed = 1;
+    if(fclose(f->out))
+        f->failed = 1;
+    if(!f->failed && rename(f->tmp_path,f->path))
+        f->failed = 1;
+    if(f->failed)
+        unlink(f->tmp_path);
+    int failed = f->failed;
+    free(f->path);
+    free(f->tmp_path);
+    free(f);
+    return failed ? -1 : 0;
+}
+
+/*
+ * run one L1 miss through L2 and below at its recorded clock
+ */
+static inline void
+replay_miss(cachesim* sim,uint32_t address,char op,ssize_t clock)
+{
+    for(unsigned l = 1;l < sim->n_levels;++l)
+    {
+        address_info info, fa_info;
+        decompose_address(&sim->geom[l],address,&info,&fa_info);
+        int hit = sim->dead && l == sim->dead->config.level ?
+                  deadblock_access(sim->dead,sim->levels[l],info,address,op,clock) :
+                  access_cache(sim->levels[l],info,op,clock);
+        if(hit)
+            return;
+        if(sim->profile[l])
+            hotspot_miss(sim->profile[l],info.index,address);
+    }
+}
+
+int
+cachesim_filter_replay(cachesim* sim,const char* path,const cachesim_filter_key* key)
+{
+    int fd = open(path,O_RDONLY);
+    if(fd < 0)
+        return -1;
+    struct stat st;
+    filter_header header;
+    if(fstat(fd,&st) || st.st_size < sizeof(filter_header) ||
+       pread(fd,&header,sizeof(filter_header),0) != sizeof(filter_header) ||
+       memcmp(header.magic,FILTER_MAGIC,4) || header.version != FILTER_VERSION ||
+       memcmp(&header.l1,&sim->config.level[0],sizeof(cachesim_level_config)) ||
+       memcmp(&header.key,key,sizeof(cachesim_filter_key)) ||
+       st.st_size != sizeof(filter_header) + header.bytes)
+    {
+        close(fd);
+        return -1;
+    }
+    const unsigned char* map = mmap(NULL,st.st_size,PROT_READ,MAP_PRIVATE,fd,0);
+    close(fd);
+    if(map == MAP_FAILED)
+        return -1;
+    madvise((void*)map,st.st_size,MADV_SEQUENTIAL);
+
+    const unsigned char* p = map + sizeof(filter_header);
+    const unsigned char* end = p + header.bytes;
+    uint64_t clock = sim->clock;
+    while(p < end)
+    {
+        uint64_t v = 0;
+        for(unsigned shift = 0;;shift += 7)
+        {
+            v |= (uint64_t)(*p & 0x7f) << shift;
+            if(!(*p++ & 0x80))
+                break;
+        }
+        uint32_t address;
+        memcpy(&address,p,4);
+        p += 4;
+        clock += v >> 1;
+        replay_miss(sim,address,(v & 1) ? 'w' : 'r',clock);
+    }
+    munmap((void*)map,st.st_size);
+
+    sim->levels[0]->stats = header.l1_stats;
+    sim->clock += header.clock;
+    return 0;
+}
@@ -0,0 +1,124 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+
+#include "cachesim.h"
+#include "follow.h"
+
+// bytes of inotify events drained per read
+#define EVENT_BUFFER 4096
+
+struct trace_follow
+{
+    int fd;
+    int notify;             // inotify descriptor, -1 without
+    uint64_t offset;
+    int gone;
+};
+
+trace_follow*
+trace_follow_open(const char* path,uint64_t offset)
+{
+    int fd = open(path,O_RDONLY);
+    if(fd < 0)
+        return NULL;
+    trace_follow* f = calloc(1,sizeof(trace_follow));
+    if(!f)
+    {
+        close(fd);
+        return NULL;
+    }
+    f->fd = fd;
+    f->offset = offset;
+    f->notify = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if(f->notify >= 0 && inotify_add_watch(f->notify,path,IN_MODIFY | IN_CLOSE_WRITE | IN_ATTRIB |
+                                           IN_DELETE_SELF | IN_MOVE_SELF) < 0)
+    {
+        close(f->notify);
+        f->notify = -1;
+    }
+    return f;
+}
+
+void
+trace_follow_close(trace_follow* f)
+{
+    if(!f)
+        return;
+    if(f->notify >= 0)
+        close(f->notify);
+    close(f->fd);
+    free(f);
+}
+
+uint64_t
+trace_follow_offset(const trace_follow* f)
+{
+    return f->offset;
+}
+
+/*
+ * wait for a change to the file; the events only wake the reader, what
+ * changed is found out from the file itself, except that it went away
+ */
+static void
+wait_change(trace_follow* f,int timeout_ms)
+{
+    if(f->notify < 0)
+    {
+        usleep((timeout_ms < 0 || timeout_ms > 100 ? 100 : timeout_ms)*1000);
+        return;
+    }
+    struct pollfd pfd = {f->notify, POLLIN, 0};
+    if(poll(&pfd,1,timeout_ms) <= 0)
+        return;
+    char events[EVENT_BUFFER] __attribute__((aligned(__alignof__(struct inotify_event))));
+    ssize_t len;
+    while((len = read(f->notify,events,sizeof(events))) > 0)
+    {
+        for(char* p = events;p < events + len;p += sizeof(struct inotify_event) + ((struct inotify_event*)p)->len)
+            if(((struct inotify_event*)p)->mask & (IN_DELETE_SELF | IN_MOVE_SELF | IN_IGNORED))
+                f->gone = 1;
+    }
+}
+
+follow_status
+trace_follow_read(trace_follow* f,unsigned char* out,size_t n,int timeout_ms,size_t* got)
+{
+    *got = 0;
+    for(int waited = 0;;waited = 1)
+    {
+        struct stat st;
+        if(fstat(f->fd,&st))
+            return FOLLOW_GONE;
+        if(st.st_size < f->offset)
+        {
+            f->offset = 0;
+            return FOLLOW_RESTARTED;
+        }
+        uint64_t records = (st.st_size - f->offset)/CACHESIM_RECORD_SIZE;
+        if(records)
+        {
+            if(records > n)
+                records = n;
+            ssize_t bytes = pread(f->fd,out,records*CACHESIM_RECORD_SIZE,f->offset);
+            if(bytes < 0)
+                return FOLLOW_GONE;
+            *got = bytes/CACHESIM_RECORD_SIZE;
+            f->offset += *got*CACHESIM_RECORD_SIZE;
+            return FOLLOW_DATA;
+        }
+        // unlinking only signals IN_ATTRIB while the file is held open here
+        if(f->gone || !st.st_nlink)
+            return FOLLOW_GONE;
+        if(waited)
+            return FOLLOW_IDLE;
+        wait_change(f,timeout_ms);
+    }
+}
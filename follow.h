@@ -0,0 +1,39 @@
+#ifndef FOLLOW_H
+#define FOLLOW_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Following a trace that is still being written: whole records appended
+ * since the last read are handed out as they arrive, with inotify waking
+ * the reader when the file changes (a plain timed wait where inotify is
+ * not available). A partially written record stays in the file until it
+ * is complete. A trace that shrinks was restarted by its writer and is
+ * followed again from its beginning.
+ */
+
+typedef enum
+{
+    FOLLOW_DATA = 0,        // records were read
+    FOLLOW_IDLE,            // nothing new within the timeout
+    FOLLOW_RESTARTED,       // the trace was truncated, reading starts over
+    FOLLOW_GONE             // the trace was deleted or renamed
+}follow_status;
+
+typedef struct trace_follow trace_follow;
+
+// follow path from byte offset; NULL if it cannot be opened
+trace_follow* trace_follow_open(const char*,uint64_t);
+void trace_follow_close(trace_follow*);
+
+/*
+ * read up to n records into out, waiting at most timeout_ms (-1 forever)
+ * for the first one; *got is set for FOLLOW_DATA and 0 otherwise
+ */
+follow_status trace_follow_read(trace_follow*,unsigned char*,size_t,int,size_t*);
+
+// byte offset of the next record
+uint64_t trace_follow_offset(const trace_follow*);
+
+#endif
@@ -0,0 +1,185 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "hotspot.h"
+
+// odd multipliers of the multiply-shift hash of each sketch row
+static const uint64_t cm_seeds[CM_DEPTH] =
+{
+    0x9e3779b97f4a7c15ull, 0xc2b2ae3d27d4eb4full, 0x165667b19e3779f9ull, 0xd6e8feb86659fd93ull
+};
+
+static inline unsigned
+cm_hash(uint64_t key,int row)
+{
+    return ((key + 1) * cm_seeds[row]) >> (64 - CM_WIDTH_BITS);
+}
+
+static void
+sift_down(cachesim_hotspot* heap,unsigned n,unsigned i)
+{
+    for(;;)
+    {
+        unsigned smallest = i, l = 2*i + 1, r = 2*i + 2;
+        if(l < n && heap[l].count < heap[smallest].count)
+            smallest = l;
+        if(r < n && heap[r].count < heap[smallest].count)
+            smallest = r;
+        if(smallest == i)
+            return;
+        cachesim_hotspot t = heap[i];
+        heap[i] = heap[smallest];
+        heap[smallest] = t;
+        i = smallest;
+    }
+}
+
+static void
+sift_up(cachesim_hotspot* heap,unsigned i)
+{
+    while(i && heap[(i - 1)/2].count > heap[i].count)
+    {
+        cachesim_hotspot t = heap[i];
+        heap[i] = heap[(i - 1)/2];
+        heap[(i - 1)/2] = t;
+        i = (i - 1)/2;
+    }
+}
+
+/*
+ * conservative count-min update, then offer the new estimate to the top-K
+ */
+void
+cm_update(cm_sketch* cm,uint64_t key)
+{
+    unsigned slot[CM_DEPTH];
+    uint32_t estimate = UINT32_MAX;
+    for(int row = 0;row < CM_DEPTH;++row)
+    {
+        slot[row] = cm_hash(key,row);
+        if(cm->counts[row][slot[row]] < estimate)
+            estimate = cm->counts[row][slot[row]];
+    }
+    ++estimate;
+    for(int row = 0;row < CM_DEPTH;++row)
+        if(cm->counts[row][slot[row]] < estimate)
+            cm->counts[row][slot[row]] = estimate;
+
+    // most keys are cold: one compare against the heap minimum rejects them
+    if(cm->n_top == cm->k && estimate <= cm->top[0].count)
+        return;
+    for(unsigned i = 0;i < cm->n_top;++i)
+    {
+        if(cm->top[i].key == key)
+        {
+            cm->top[i].count = estimate;
+            sift_down(cm->top,cm->n_top,i);
+            return;
+        }
+    }
+    if(cm->n_top < cm->k)
+    {
+        cm->top[cm->n_top].key = key;
+        cm->top[cm->n_top].count = estimate;
+        sift_up(cm->top,cm->n_top++);
+    }
+    else
+    {
+        cm->top[0].key = key;
+        cm->top[0].count = estimate;
+        sift_down(cm->top,cm->n_top,0);
+    }
+}
+
+static int
+by_count_desc(const void* a,const void* b)
+{
+    const cachesim_hotspot* x = a;
+    const cachesim_hotspot* y = b;
+    return (x->count < y->count) - (x->count > y->count);
+}
+
+/*
+ * copy up to n heavy hitters, hottest first
+ */
+size_t
+cm_top(const cm_sketch* cm,cachesim_hotspot* out,size_t n)
+{
+    cachesim_hotspot* sorted = malloc(cm->n_top*sizeof(cachesim_hotspot) + 1);
+    memcpy(sorted,cm->top,cm->n_top*sizeof(cachesim_hotspot));
+    qsort(sorted,cm->n_top,sizeof(cachesim_hotspot),by_count_desc);
+    if(n > cm->n_top)
+        n = cm->n_top;
+    memcpy(out,sorted,n*sizeof(cachesim_hotspot));
+    free(sorted);
+    return n;
+}
+
+/*
+ * the n sets with the most misses, hottest first
+ */
+size_t
+hotspot_top_sets(const hotspot_profile* p,cachesim_hotspot* out,size_t n)
+{
+    size_t found = 0;
+    if(!n)
+        return 0;
+    for(unsigned set = 0;set < p->n_sets;++set)
+    {
+        uint64_t count = p->set_misses[set];
+        if(!count || (found == n && count <= out[found - 1].count))
+            continue;
+        // insertion into the short sorted output list
+        size_t i = found < n ? found++ : n - 1;
+        while(i && out[i - 1].count < count)
+        {
+            out[i] = out[i - 1];
+            --i;
+        }
+        out[i].key = set;
+        out[i].count = count;
+    }
+    return found;
+}
+
+hotspot_profile*
+hotspot_create(unsigned n_sets,unsigned block_offset_bits,unsigned k)
+{
+    hotspot_profile* p = calloc(1,sizeof(hotspot_profile));
+    if(!p)
+        return NULL;
+    p->n_sets = n_sets;
+    p->block_offset_bits = block_offset_bits;
+    p->set_misses = calloc(n_sets,sizeof(uint64_t));
+    p->lines.k = p->pages.k = k ? k : 1;
+    p->lines.top = calloc(p->lines.k,sizeof(cachesim_hotspot));
+    p->pages.top = calloc(p->pages.k,sizeof(cachesim_hotspot));
+    if(!p->set_misses || !p->lines.top || !p->pages.top)
+    {
+        hotspot_destroy(p);
+        return NULL;
+    }
+    return p;
+}
+
+void
+hotspot_destroy(hotspot_profile* p)
+{
+    if(!p)
+        return;
+    free(p->set_misses);
+    free(p->lines.top);
+    free(p->pages.top);
+    free(p);
+}
+
+void
+hotspot_reset(hotspot_profile* p)
+{
+    memset(p->set_misses,0,p->n_sets*sizeof(uint64_t));
+    p->misses = 0;
+    memset(p->lines.counts,0,sizeof(p->lines.counts));
+    memset(p->pages.counts,0,sizeof(p->pages.counts));
+    p->lines.n_top = p->pages.n_top = 0;
+}
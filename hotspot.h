@@ -0,0 +1,57 @@
+#ifndef HOTSPOT_H
+#define HOTSPOT_H
+
+#include <stdint.h>
+#include <sys/types.h>
+
+#include "cachesim.h"
+
+/*
+ * Conflict hotspot profiling of one cache level.
+ *
+ * Misses are counted exactly per set (the set count is bounded by the
+ * geometry) and approximately per line and per 4kB page with a count-min
+ * sketch; a small min-heap keeps the top-K heavy hitters of each sketch.
+ * Memory is fixed at creation, independent of the trace footprint.
+ */
+
+#define CM_DEPTH 4
+#define CM_WIDTH_BITS 14
+#define CM_WIDTH (1u << CM_WIDTH_BITS)
+#define HOTSPOT_PAGE_BITS 12
+
+typedef struct
+{
+    uint32_t counts[CM_DEPTH][CM_WIDTH];
+    cachesim_hotspot* top;      // min-heap on count
+    unsigned k;
+    unsigned n_top;
+}cm_sketch;
+
+typedef struct
+{
+    uint64_t* set_misses;
+    unsigned n_sets;
+    unsigned block_offset_bits;
+    uint64_t misses;
+    cm_sketch lines;
+    cm_sketch pages;
+}hotspot_profile;
+
+hotspot_profile* hotspot_create(unsigned,unsigned,unsigned);
+void hotspot_destroy(hotspot_profile*);
+void hotspot_reset(hotspot_profile*);
+void cm_update(cm_sketch*,uint64_t);
+size_t hotspot_top_sets(const hotspot_profile*,cachesim_hotspot*,size_t);
+size_t cm_top(const cm_sketch*,cachesim_hotspot*,size_t);
+
+static inline void
+hotspot_miss(hotspot_profile* p,unsigned set,uint32_t address)
+{
+    ++p->misses;
+    ++p->set_misses[set];
+    cm_update(&p->lines,address >> p->block_offset_bits);
+    cm_update(&p->pages,address >> HOTSPOT_PAGE_BITS);
+}
+
+#endif
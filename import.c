@@ -0,0 +1,357 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "import.h"
+
+#define IMPORT_BUFFER (1 << 20)     // bytes read per refill
+#define IMPORT_PAD 32               // readable bytes past the data for 8 byte loads
+#define CHAMPSIM_RECORD 64
+#define MAX_PENDING 8               // records one input line or record can produce
+
+#define ONES 0x0101010101010101ull
+#define HIGHS 0x8080808080808080ull
+
+struct trace_reader
+{
+    int fd;
+    trace_format format;
+    int ifetch;
+    unsigned char* buf;
+    size_t begin;               // first byte not consumed
+    size_t end;                 // end of the data read
+    int eof;
+    unsigned char pending[MAX_PENDING*CACHESIM_RECORD_SIZE];   // records that did not fit the caller's
+    unsigned n_pending;
+    unsigned next_pending;
+    uint64_t rejected;
+};
+
+static const char* format_names[] = {"native", "din", "lackey", "champsim", "hex"};
+
+int
+trace_format_parse(const char* name)
+{
+    for(int f = 0;f < sizeof(format_names)/sizeof(format_names[0]);++f)
+        if(!strcmp(name,format_names[f]))
+            return f;
+    return -1;
+}
+
+trace_format
+trace_format_guess(const char* path)
+{
+    static const struct
+    {
+        const char* ext;
+        trace_format format;
+    }known[] = {{".din", TRACE_DINERO}, {".lackey", TRACE_LACKEY}, {".champsim", TRACE_CHAMPSIM},
+                {".champsimtrace", TRACE_CHAMPSIM}, {".hex", TRACE_HEX}, {".txt", TRACE_HEX}};
+    const char* ext = strrchr(path,'.');
+    for(int i = 0;ext && i < sizeof(known)/sizeof(known[0]);++i)
+        if(!strcmp(ext,known[i].ext))
+            return known[i].format;
+    return TRACE_NATIVE;
+}
+
+/*
+ * high bit of every byte of x that lies strictly between m and n (both at
+ * most 128), exact per byte (bit twiddling hacks, hasbetween)
+ */
+static inline uint64_t
+between(uint64_t x,unsigned m,unsigned n)
+{
+    uint64_t low = x & (ONES*127);
+    return (ONES*(127 + n) - low) & ~x & (low + ONES*(127 - m)) & HIGHS;
+}
+
+/*
+ * value of the hex digits at the start of the 8 bytes at p and how many
+ * there are; all eight are classified and converted at once
+ */
+static inline uint64_t
+hex8(const unsigned char* p,unsigned* len)
+{
+    uint64_t x;
+    memcpy(&x,p,8);
+    uint64_t digits = between(x,'0' - 1,'9' + 1);
+    uint64_t letters = between(x | (ONES*0x20),'a' - 1,'f' + 1);
+    uint64_t invalid = ~(digits | letters) & HIGHS;
+    *len = invalid ? __builtin_ctzll(invalid) >> 3 : 8;
+
+    // nibble values, the first digit in the lowest byte
+    uint64_t v = (x & (ONES*0x0f)) + (letters >> 7)*9;
+    v = ((v & 0x000f000f000f000full) << 4) | ((v & 0x0f000f000f000f00ull) >> 8);
+    v = ((v & 0x000000ff000000ffull) << 8) | ((v & 0x00ff000000ff0000ull) >> 16);
+    v = ((v & 0xffffull) << 16) | ((v >> 32) & 0xffff);
+    return *len ? v >> 4*(8 - *len) : 0;
+}
+
+// up to 16 hex digits; the end of the digits is stored in *end
+static inline uint64_t
+scan_hex(const unsigned char* p,const unsigned char** end)
+{
+    unsigned n, m;
+    uint64_t value = hex8(p,&n);
+    if(n == 8)
+    {
+        uint64_t low = hex8(p + 8,&m);
+        value = (value << 4*m) | low;
+        n += m;
+    }
+    *end = p + n;
+    return value;
+}
+
+static inline const unsigned char*
+skip_blanks(const unsigned char* p)
+{
+    while(*p == ' ' || *p == '\t' || *p == '\r')
+        ++p;
+    return p;
+}
+
+static inline void
+emit(trace_reader* r,unsigned char* out,size_t* k,size_t n,uint64_t address,char op)
+{
+    uint32_t a = address;
+    unsigned char* record = *k < n ? out + (*k)++*CACHESIM_RECORD_SIZE :
+                            r->pending + r->n_pending++*CACHESIM_RECORD_SIZE;
+    memcpy(record,&a,4);
+    record[4] = op;
+}
+
+// r or w followed by a blank or the line end
+static inline int
+op_letter(const unsigned char* p,const unsigned char* e,char* op)
+{
+    char c = *p | 0x20;
+    if((c != 'r' && c != 'w') || (p + 1 < e && p[1] != ' ' && p[1] != '\t' && p[1] != '\r'))
+        return 0;
+    *op = c;
+    return 1;
+}
+
+/*
+ * parse the line [p,e) of a text format; returns 0 if it is malformed
+ */
+static int
+parse_line(trace_reader* r,const unsigned char* p,const unsigned char* e,unsigned char* out,size_t* k,size_t n)
+{
+    const unsigned char* q;
+    uint64_t address;
+    char op = 'r';
+    p = skip_blanks(p);
+    switch(r->format)
+    {
+        case(TRACE_DINERO):
+            if(p == e || *p == '#')
+                return 1;
+            if(*p < '0' || *p > '9' || (p[1] != ' ' && p[1] != '\t'))
+                return 0;
+            int label = *p - '0';
+            p = skip_blanks(p + 1);
+            if(p[0] == '0' && (p[1] | 0x20) == 'x')
+                p += 2;
+            address = scan_hex(p,&q);
+            if(q == p)
+                return 0;
+            if(label == 0 || (label == 2 && r->ifetch))
+                emit(r,out,k,n,address,'r');
+            else if(label == 1)
+                emit(r,out,k,n,address,'w');
+            return 1;
+        case(TRACE_LACKEY):
+            // valgrind's own messages start with ==pid==
+            if(p == e || *p == '=')
+                return 1;
+            char kind = *p;
+            p = skip_blanks(p + 1);
+            address = scan_hex(p,&q);
+            if(q == p || (*q != ',' && q != e))
+                return 0;
+            switch(kind)
+            {
+                case('I'):
+                    if(r->ifetch)
+                        emit(r,out,k,n,address,'r');
+                    return 1;
+                case('L'):
+                    emit(r,out,k,n,address,'r');
+                    return 1;
+                case('S'):
+                    emit(r,out,k,n,address,'w');
+                    return 1;
+                case('M'):
+                    emit(r,out,k,n,address,'r');
+                    emit(r,out,k,n,address,'w');
+                    return 1;
+            }
+            return 0;
+        case(TRACE_HEX):
+            if(p == e || *p == '#')
+                return 1;
+            if(op_letter(p,e,&op))
+                p = skip_blanks(p + 1);
+            if(p[0] == '0' && (p[1] | 0x20) == 'x')
+                p += 2;
+            address = scan_hex(p,&q);
+            if(q == p)
+                return 0;
+            q = skip_blanks(q);
+            if(q != e && !op_letter(q,e,&op))
+                return 0;
+            emit(r,out,k,n,address,op);
+            return 1;
+        default:
+            return 0;
+    }
+}
+
+static void
+parse_champsim(trace_reader* r,const unsigned char* p,unsigned char* out,size_t* k,size_t n)
+{
+    uint64_t ip, destination[2], source[4];
+    memcpy(&ip,p,8);
+    memcpy(destination,p + 16,sizeof(destination));
+    memcpy(source,p + 32,sizeof(source));
+    if(r->ifetch)
+        emit(r,out,k,n,ip,'r');
+    for(int i = 0;i < 4;++i)
+        if(source[i])
+            emit(r,out,k,n,source[i],'r');
+    for(int i = 0;i < 2;++i)
+        if(destination[i])
+            emit(r,out,k,n,destination[i],'w');
+}
+
+trace_reader*
+trace_reader_open(const char* path,trace_format format,int ifetch)
+{
+    int fd = strcmp(path,"-") ? open(path,O_RDONLY) : dup(0);
+    if(fd < 0)
+        return NULL;
+    trace_reader* r = calloc(1,sizeof(trace_reader));
+    if(r)
+        r->buf = malloc(IMPORT_BUFFER + IMPORT_PAD);
+    if(!r || !r->buf)
+    {
+        free(r);
+        close(fd);
+        return NULL;
+    }
+    posix_fadvise(fd,0,0,POSIX_FADV_SEQUENTIAL);
+    r->fd = fd;
+    r->format = format;
+    r->ifetch = ifetch;
+    return r;
+}
+
+void
+trace_reader_close(trace_reader* r)
+{
+    if(!r)
+        return;
+    close(r->fd);
+    free(r->buf);
+    free(r);
+}
+
+/*
+ * move the unconsumed bytes to the front and read more behind them;
+ * returns 0 once the input is exhausted
+ */
+static int
+refill(trace_reader* r)
+{
+    if(r->eof)
+        return 0;
+    memmove(r->buf,r->buf + r->begin,r->end - r->begin);
+    r->end -= r->begin;
+    r->begin = 0;
+    while(r->end < IMPORT_BUFFER)
+    {
+        ssize_t got = read(r->fd,r->buf + r->end,IMPORT_BUFFER - r->end);
+        if(got <= 0)
+        {
+            r->eof = 1;
+            break;
+        }
+        r->end += got;
+        // a full line is enough to go on with for a pipe
+        if(r->format != TRACE_CHAMPSIM && r->format != TRACE_NATIVE && memchr(r->buf + r->end - got,'\n',got))
+            break;
+        if((r->format == TRACE_CHAMPSIM || r->format == TRACE_NATIVE) && r->end >= CHAMPSIM_RECORD)
+            break;
+    }
+    memset(r->buf + r->end,0,IMPORT_PAD);
+    return 1;
+}
+
+size_t
+trace_reader_read(trace_reader* r,unsigned char* out,size_t n)
+{
+    size_t k = 0;
+    while(k < n && r->next_pending < r->n_pending)
+        memcpy(out + k++*CACHESIM_RECORD_SIZE,r->pending + r->next_pending++*CACHESIM_RECORD_SIZE,
+               CACHESIM_RECORD_SIZE);
+    if(r->next_pending == r->n_pending)
+        r->n_pending = r->next_pending = 0;
+
+    while(k < n && !r->n_pending)
+    {
+        size_t have = r->end - r->begin;
+        const unsigned char* p = r->buf + r->begin;
+        if(r->format == TRACE_NATIVE)
+        {
+            size_t records = have/CACHESIM_RECORD_SIZE;
+            if(records > n - k)
+                records = n - k;
+            memcpy(out + k*CACHESIM_RECORD_SIZE,p,records*CACHESIM_RECORD_SIZE);
+            k += records;
+            r->begin += records*CACHESIM_RECORD_SIZE;
+            if(!records && !refill(r))
+                break;
+            continue;
+        }
+        if(r->format == TRACE_CHAMPSIM)
+        {
+            if(have < CHAMPSIM_RECORD)
+            {
+                if(!refill(r))
+                    break;
+                continue;
+            }
+            parse_champsim(r,p,out,&k,n);
+            r->begin += CHAMPSIM_RECORD;
+            continue;
+        }
+
+        const unsigned char* e = memchr(p,'\n',have);
+        if(!e)
+        {
+            // a line longer than the buffer is cut where the buffer ends
+            if(have < IMPORT_BUFFER && refill(r))
+                continue;
+            // the last line may have no newline; the pad bytes end it
+            if(!have)
+                break;
+            e = p + have;
+            r->end = r->begin + have + 1;
+            r->buf[r->end - 1] = '\n';
+        }
+        if(!parse_line(r,p,e,out,&k,n))
+            ++r->rejected;
+        r->begin = e + 1 - r->buf;
+    }
+    return k;
+}
+
+uint64_t
+trace_reader_rejected(const trace_reader* r)
+{
+    return r->rejected;
+}
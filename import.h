@@ -0,0 +1,57 @@
+#ifndef IMPORT_H
+#define IMPORT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "cachesim.h"
+
+/*
+ * Streaming trace importers: read a trace in another tool's format and
+ * hand it out as native CACHESIM_RECORD_SIZE records, to feed a
+ * simulation directly or to convert it once.
+ *
+ *   DINERO    din text, "label address [size]" with label 0 read, 1 write,
+ *             2 instruction fetch (other labels are skipped)
+ *   LACKEY    valgrind --tool=lackey --trace-mem=yes output: "I", " L",
+ *             " S" or " M" (load then store), address, size
+ *   CHAMPSIM  uncompressed ChampSim input_instr records (64 bytes); each
+ *             source memory operand is a read, each destination one a write
+ *   HEX       one hex address per line, optionally 0x-prefixed, with an
+ *             optional r or w before or after it (default r)
+ *
+ * Text is consumed a large buffer at a time: line ends are found with
+ * memchr and hex fields are converted eight digits per step with
+ * SIMD-within-a-register arithmetic instead of scanf. Addresses are cut to
+ * the 32 bits the model simulates; instruction fetches are only kept when
+ * asked for. Malformed lines are counted and skipped.
+ */
+
+typedef enum
+{
+    TRACE_NATIVE = 0,
+    TRACE_DINERO,
+    TRACE_LACKEY,
+    TRACE_CHAMPSIM,
+    TRACE_HEX
+}trace_format;
+
+typedef struct trace_reader trace_reader;
+
+// format by name (native, din, lackey, champsim, hex); -1 if unknown
+int trace_format_parse(const char*);
+
+// format by file extension, native if it has none of the known ones
+trace_format trace_format_guess(const char*);
+
+// "-" reads standard input; NULL if the file cannot be opened
+trace_reader* trace_reader_open(const char*,trace_format,int);
+void trace_reader_close(trace_reader*);
+
+// up to n records into out, fewer only at the end of the trace
+size_t trace_reader_read(trace_reader*,unsigned char*,size_t);
+
+// lines or records that could not be parsed so far
+uint64_t trace_reader_rejected(const trace_reader*);
+
+#endif
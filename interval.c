@@ -0,0 +1,120 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sched.h>
+
+#include "interval.h"
+
+static void* interval_writer(void*);
+
+/*
+ * create the output file, write its header and start the writer thread
+ * returns 0 on success, -1 if the file or thread could not be created
+ */
+int
+interval_open(interval_ctx* ctx,const char* path,unsigned interval)
+{
+    memset(ctx,0,sizeof(interval_ctx));
+    ctx->interval = interval;
+    ctx->out = fopen(path,"wb");
+    if(!ctx->out)
+        return -1;
+
+    interval_header header;
+    memcpy(header.magic,INTERVAL_MAGIC,4);
+    header.version = INTERVAL_VERSION;
+    header.interval = interval;
+    header.n_levels = INTERVAL_LEVELS;
+    header.n_fields = INTERVAL_FIELDS;
+    fwrite(&header,sizeof(header),1,ctx->out);
+
+    ctx->ring = malloc(INTERVAL_RING*sizeof(interval_record));
+    atomic_init(&ctx->head,0);
+    atomic_init(&ctx->tail,0);
+    atomic_init(&ctx->done,0);
+    if(!ctx->ring || pthread_create(&ctx->writer,NULL,interval_writer,ctx))
+    {
+        free(ctx->ring);
+        fclose(ctx->out);
+        ctx->out = NULL;
+        return -1;
+    }
+    return 0;
+}
+
+/*
+ * record the deltas since the previous snapshot; called by the simulation
+ * thread every ctx->interval accesses
+ */
+void
+interval_snapshot(interval_ctx* ctx,uint64_t end,ssize_t now[INTERVAL_LEVELS][INTERVAL_FIELDS])
+{
+    size_t head = atomic_load_explicit(&ctx->head,memory_order_relaxed);
+    // ring full: let the writer catch up rather than drop an interval
+    while(head - atomic_load_explicit(&ctx->tail,memory_order_acquire) == INTERVAL_RING)
+        sched_yield();
+
+    interval_record* rec = &ctx->ring[head & (INTERVAL_RING - 1)];
+    rec->end = end;
+    for(int l = 0;l < INTERVAL_LEVELS;++l)
+    {
+        for(int f = 0;f < INTERVAL_FIELDS;++f)
+        {
+            rec->delta[l][f] = now[l][f] - ctx->last[l][f];
+            ctx->last[l][f] = now[l][f];
+        }
+    }
+    ctx->last_end = end;
+    atomic_store_explicit(&ctx->head,head + 1,memory_order_release);
+}
+
+/*
+ * write the final partial interval, drain the ring and close the file
+ */
+void
+interval_close(interval_ctx* ctx,uint64_t end,ssize_t now[INTERVAL_LEVELS][INTERVAL_FIELDS])
+{
+    if(!ctx->out)
+        return;
+    if(end > ctx->last_end)
+        interval_snapshot(ctx,end,now);
+    atomic_store_explicit(&ctx->done,1,memory_order_release);
+    pthread_join(ctx->writer,NULL);
+    fclose(ctx->out);
+    free(ctx->ring);
+    ctx->out = NULL;
+}
+
+/*
+ * background thread: append whatever the simulator has published, sleeping
+ * briefly when the ring is empty so the producer never needs to signal
+ */
+static void*
+interval_writer(void* arg)
+{
+    interval_ctx* ctx = arg;
+    struct timespec idle = {0, 1000000};
+    for(;;)
+    {
+        int done = atomic_load_explicit(&ctx->done,memory_order_acquire);
+        size_t tail = atomic_load_explicit(&ctx->tail,memory_order_relaxed);
+        size_t head = atomic_load_explicit(&ctx->head,memory_order_acquire);
+        if(head == tail)
+        {
+            if(done)
+                break;
+            nanosleep(&idle,NULL);
+            continue;
+        }
+        // write the contiguous run up to the end of the ring in one call
+        size_t start = tail & (INTERVAL_RING - 1);
+        size_t n = head - tail;
+        if(start + n > INTERVAL_RING)
+            n = INTERVAL_RING - start;
+        fwrite(&ctx->ring[start],sizeof(interval_record),n,ctx->out);
+        atomic_store_explicit(&ctx->tail,tail + n,memory_order_release);
+    }
+    fflush(ctx->out);
+    return NULL;
+}
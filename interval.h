@@ -0,0 +1,68 @@
+#ifndef INTERVAL_H
+#define INTERVAL_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <sys/types.h>
+
+/*
+ * Interval statistics: every N accesses the per-level counter deltas are
+ * written into a preallocated ring and a background thread appends them to
+ * a binary file. The simulation thread never blocks on I/O; it only waits
+ * when the writer has fallen a full ring behind.
+ *
+ * File layout: one interval_header followed by interval_record entries.
+ * interval_export converts a file to CSV or JSON.
+ */
+
+#define INTERVAL_MAGIC "CSIV"
+#define INTERVAL_VERSION 1
+#define INTERVAL_LEVELS 2
+#define INTERVAL_RING 4096  // records, must be a power of two
+
+// counters recorded per level, in file order
+typedef enum
+{
+    INTERVAL_HITS = 0,
+    INTERVAL_MISSES,
+    INTERVAL_COLD,
+    INTERVAL_CAPACITY,
+    INTERVAL_CONFLICT,
+    INTERVAL_FIELDS
+}interval_field;
+
+typedef struct
+{
+    char magic[4];
+    uint32_t version;
+    uint32_t interval;
+    uint32_t n_levels;
+    uint32_t n_fields;
+}interval_header;
+
+typedef struct
+{
+    uint64_t end;           // accesses simulated at the end of the interval
+    uint32_t delta[INTERVAL_LEVELS][INTERVAL_FIELDS];
+}interval_record;
+
+typedef struct
+{
+    FILE* out;
+    unsigned interval;
+    uint64_t last_end;
+    ssize_t last[INTERVAL_LEVELS][INTERVAL_FIELDS];
+    interval_record* ring;
+    atomic_size_t head;     // next slot the simulator fills
+    atomic_size_t tail;     // next slot the writer drains
+    atomic_int done;
+    pthread_t writer;
+}interval_ctx;
+
+int interval_open(interval_ctx*,const char*,unsigned);
+void interval_snapshot(interval_ctx*,uint64_t,ssize_t[INTERVAL_LEVELS][INTERVAL_FIELDS]);
+void interval_close(interval_ctx*,uint64_t,ssize_t[INTERVAL_LEVELS][INTERVAL_FIELDS]);
+
+#endif
@@ -0,0 +1,97 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "interval.h"
+
+/*
+ * convert an interval statistics file written by Cache.Grp1 --interval to
+ * CSV (default) or JSON
+ *
+ * usage: interval_export [-j] file
+ */
+
+static const char* field_names[INTERVAL_FIELDS] =
+{
+    "hits", "misses", "cold", "capacity", "conflict"
+};
+
+int
+main(int argc, char *argv[])
+{
+    int json = 0;
+    const char* path = NULL;
+    for(int i = 1;i < argc;++i)
+    {
+        if(!strcmp(argv[i],"-j"))
+            json = 1;
+        else
+            path = argv[i];
+    }
+    if(!path)
+    {
+        printf("usage: %s [-j] file\n",argv[0]);
+        exit(0);
+    }
+
+    FILE* fin = fopen(path,"rb");
+    if(fin == 0) { printf("Unable to open interval file\n"); exit(0); }
+
+    interval_header header;
+    if((fread(&header,sizeof(header),1,fin) != 1) || memcmp(header.magic,INTERVAL_MAGIC,4) ||
+       (header.version != INTERVAL_VERSION) || (header.n_levels != INTERVAL_LEVELS) ||
+       (header.n_fields != INTERVAL_FIELDS))
+    {
+        printf("Not an interval statistics file\n");
+        fclose(fin);
+        exit(0);
+    }
+
+    if(json)
+        printf("{\"interval\":%u,\"records\":[",header.interval);
+    else
+    {
+        printf("end");
+        for(int l = 0;l < INTERVAL_LEVELS;++l)
+        {
+            for(int f = 0;f < INTERVAL_FIELDS;++f)
+                printf(",L%d_%s",l+1,field_names[f]);
+            printf(",L%d_miss_rate",l+1);
+        }
+        printf("\n");
+    }
+
+    interval_record rec;
+    for(size_t n = 0;fread(&rec,sizeof(rec),1,fin) == 1;++n)
+    {
+        if(json)
+        {
+            printf("%s\n{\"end\":%llu",n ? "," : "",(unsigned long long)rec.end);
+            for(int l = 0;l < INTERVAL_LEVELS;++l)
+            {
+                printf(",\"L%d\":{",l+1);
+                for(int f = 0;f < INTERVAL_FIELDS;++f)
+                    printf("\"%s\":%u,",field_names[f],rec.delta[l][f]);
+                unsigned accesses = rec.delta[l][INTERVAL_HITS] + rec.delta[l][INTERVAL_MISSES];
+                printf("\"miss_rate\":%.6f}",accesses ? (double)rec.delta[l][INTERVAL_MISSES]/accesses : 0.0);
+            }
+            printf("}");
+        }
+        else
+        {
+            printf("%llu",(unsigned long long)rec.end);
+            for(int l = 0;l < INTERVAL_LEVELS;++l)
+            {
+                for(int f = 0;f < INTERVAL_FIELDS;++f)
+                    printf(",%u",rec.delta[l][f]);
+                unsigned accesses = rec.delta[l][INTERVAL_HITS] + rec.delta[l][INTERVAL_MISSES];
+                printf(",%.6f",accesses ? (double)rec.delta[l][INTERVAL_MISSES]/accesses : 0.0);
+            }
+            printf("\n");
+        }
+    }
+    if(json)
+        printf("\n]}\n");
+    fclose(fin);
+    return 0;
+}
@@ -0,0 +1,198 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <stdint.h>
+#include <getopt.h>
+
+#include "cachesim.h"
+#include "shards.h"
+
+/********************************* CLI INPUTS **********************************
+ *
+ * mrc [options] benchmark accesses
+ *
+ * Prints the fully associative LRU miss-ratio curve of the trace for every
+ * cache size up to buckets*bucket lines, as CSV of cache bytes and miss ratio.
+ *
+ * --rate=R         fixed-rate SHARDS sampling rate (default 0.01)
+ * --size=S         fixed-size SHARDS tracking at most S lines instead
+ * --line=B         line size in bytes (default 64)
+ * --bucket=L       curve granularity in lines (default 16)
+ * --buckets=N      number of points on the curve (default 4096)
+ * --validate       also simulate fully associative LRU caches of the curve
+ *                  sizes at 1, 2, 4, ... buckets and the last one with
+ *                  the cache model (the shadow of each level) and report
+ *                  the error of the curve at those sizes
+ *
+ * *****************************************************************************
+*/
+
+#define TRACE_BLOCK 4096
+
+int
+main(int argc, char *argv[])
+{
+    static const struct option long_options[] =
+    {
+        {"rate", required_argument, NULL, 'r'},
+        {"size", required_argument, NULL, 's'},
+        {"line", required_argument, NULL, 'l'},
+        {"bucket", required_argument, NULL, 'b'},
+        {"buckets", required_argument, NULL, 'n'},
+        {"validate", no_argument, NULL, 'v'},
+        {NULL, 0, NULL, 0}
+    };
+    double rate = 0.01;
+    unsigned max_lines = 0, line_size = 64, bucket = 16, n_buckets = 4096;
+    int validate = 0;
+    int opt;
+    while((opt = getopt_long(argc,argv,"",long_options,NULL)) != -1)
+    {
+        switch(opt)
+        {
+            case('r'):
+                rate = atof(optarg);
+                break;
+            case('s'):
+                max_lines = atoi(optarg);
+                break;
+            case('l'):
+                line_size = atoi(optarg);
+                break;
+            case('b'):
+                bucket = atoi(optarg);
+                break;
+            case('n'):
+                n_buckets = atoi(optarg);
+                break;
+            case('v'):
+                validate = 1;
+                break;
+            default:
+                printf("Invalid arguments!");
+                exit(0);
+        }
+    }
+    if(argc - optind < 2 || !line_size || !bucket || !n_buckets)
+    {
+        printf("Invalid arguments!");
+        exit(0);
+    }
+
+    char benchmark[512];
+    snprintf(benchmark,sizeof(benchmark),"CacheonlyTraces/Traces/%s.trace",argv[optind]);
+    size_t accesses = strtoull(argv[optind + 1],NULL,0);
+    unsigned line_bits = log2(line_size);
+
+    shards* sampled = max_lines ? shards_create_fixed_size(max_lines,line_bits,bucket,n_buckets)
+                                : shards_create_fixed_rate(rate,line_bits,bucket,n_buckets);
+    if(!sampled)
+    {
+        printf("Invalid sampling parameters\n");
+        exit(0);
+    }
+
+    // every level's shadow is one exact point, so a hierarchy checks several at once
+    unsigned checked[64];
+    unsigned n_checked = 0;
+    cachesim* exact[64/CACHESIM_MAX_LEVELS];
+    unsigned n_exact = 0;
+    for(unsigned b = 1;validate && b <= n_buckets;b = b < n_buckets && 2*b > n_buckets ? n_buckets : 2*b)
+    {
+        checked[n_checked++] = b;
+        if(b == n_buckets)
+            break;
+    }
+    for(unsigned i = 0;i < n_checked;i += CACHESIM_MAX_LEVELS)
+    {
+        cachesim_config config;
+        memset(&config,0,sizeof(config));
+        for(unsigned k = i;k < n_checked && k < i + CACHESIM_MAX_LEVELS;++k)
+            config.level[config.n_levels++] = (cachesim_level_config){checked[k]*bucket*line_size, 1, line_size, 0,
+                                                                      CACHESIM_INDEX_MODULO};
+        if(!(exact[n_exact++] = cachesim_create(&config)))
+        {
+            printf("Unable to create the validation caches\n");
+            exit(0);
+        }
+    }
+
+    FILE* fin = fopen(benchmark,"rb");
+    if(fin == 0) { printf("Unable to open trace file\n"); exit(0); }
+
+    unsigned char* block = malloc(TRACE_BLOCK*CACHESIM_RECORD_SIZE);
+    if(!block)
+    {
+        printf("Unable to allocate trace buffer\n");
+        exit(0);
+    }
+    size_t left = accesses;
+    while(left)
+    {
+        size_t want = left < TRACE_BLOCK ? left : TRACE_BLOCK;
+        size_t got = fread(block,CACHESIM_RECORD_SIZE,want,fin);
+        for(size_t i = 0;i < got;++i)
+        {
+            uint32_t address;
+            memcpy(&address,block + i*CACHESIM_RECORD_SIZE,4);
+            shards_access(sampled,address);
+        }
+        for(unsigned k = 0;k < n_exact;++k)
+            cachesim_run_trace(exact[k],block,got);
+        left -= got;
+        if(got < want)
+            break;
+    }
+    free(block);
+    fclose(fin);
+
+    if(shards_failed(sampled))
+    {
+        printf("Out of memory while sampling\n");
+        exit(0);
+    }
+    double* curve = malloc(n_buckets*sizeof(double));
+    if(!curve)
+    {
+        printf("Unable to allocate the curve\n");
+        exit(0);
+    }
+    shards_mrc(sampled,curve,n_buckets);
+
+    printf("# %s: %zu accesses, sampling rate %g, %zu lines tracked\n",benchmark,accesses - left,
+            shards_rate(sampled),shards_tracked(sampled));
+    if(!validate)
+    {
+        printf("size_bytes,miss_ratio\n");
+        for(unsigned i = 0;i < n_buckets;++i)
+            printf("%llu,%.6f\n",(unsigned long long)(i + 1)*bucket*line_size,curve[i]);
+    }
+    else
+    {
+        // only the checked sizes have a reference
+        printf("size_bytes,miss_ratio,exact,abs_error\n");
+        double total_error = 0, max_error = 0;
+        for(unsigned i = 0;i < n_checked;++i)
+        {
+            cache_stats stats;
+            cachesim_get_shadow_stats(exact[i/CACHESIM_MAX_LEVELS],i%CACHESIM_MAX_LEVELS,&stats);
+            ssize_t references = stats.hits + stats.total_misses;
+            double reference = references ? (double)stats.total_misses/references : 0;
+            double error = fabs(curve[checked[i] - 1] - reference);
+            total_error += error;
+            if(error > max_error)
+                max_error = error;
+            printf("%llu,%.6f,%.6f,%.6f\n",(unsigned long long)checked[i]*bucket*line_size,curve[checked[i] - 1],
+                    reference,error);
+        }
+        printf("# validation: mean abs error %.6f, max abs error %.6f over %u sizes simulated fully associative\n",
+                total_error/n_checked,max_error,n_checked);
+    }
+
+    free(curve);
+    shards_destroy(sampled);
+    for(unsigned k = 0;k < n_exact;++k)
+        cachesim_destroy(exact[k]);
+    return 0;
+}
@@ -0,0 +1,315 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "cache.h"
+
+/*
+ * Belady's MIN over a trace held in memory, one level at a time.
+ *
+ * The backward pass walks the accesses that reach a level from last to
+ * first with a hash map from line address to the index of its next access,
+ * leaving the next use of every access in a side array. The forward pass
+ * then simulates the level evicting, in the set of the access, the line
+ * used furthest in the future: a max-heap on next use per set gives the
+ * victim, and a hash map from line address to slot finds hits, so an
+ * access costs O(log ways). The misses of a level are the accesses that
+ * reach the next one.
+ */
+
+#define NEVER UINT32_MAX
+
+// open addressing map from line address to a 32 bit value, linear probing
+typedef struct
+{
+    uint64_t* keys;         // line address + 1, 0 is empty
+    uint32_t* values;
+    size_t mask;
+    size_t used;
+}line_map;
+
+static inline size_t
+map_hash(uint32_t key,size_t mask)
+{
+    return ((uint64_t)key*0x9e3779b97f4a7c15ull >> 32) & mask;
+}
+
+static int
+map_init(line_map* m,size_t capacity)
+{
+    size_t size = 16;
+    while(size < 2*capacity)
+        size *= 2;
+    m->keys = calloc(size,sizeof(uint64_t));
+    m->values = malloc(size*sizeof(uint32_t));
+    m->mask = size - 1;
+    m->used = 0;
+    return m->keys && m->values ? 0 : -1;
+}
+
+static void
+map_free(line_map* m)
+{
+    free(m->keys);
+    free(m->values);
+}
+
+// slot of key, or of the empty slot where it would go
+static inline size_t
+map_find(const line_map* m,uint32_t key)
+{
+    size_t i = map_hash(key,m->mask);
+    while(m->keys[i] && m->keys[i] != key + 1ull)
+        i = (i + 1) & m->mask;
+    return i;
+}
+
+static int
+map_grow(line_map* m)
+{
+    line_map bigger;
+    if(map_init(&bigger,m->mask + 1))
+        return -1;
+    for(size_t i = 0;i <= m->mask;++i)
+    {
+        if(!m->keys[i])
+            continue;
+        size_t j = map_find(&bigger,m->keys[i] - 1);
+        bigger.keys[j] = m->keys[i];
+        bigger.values[j] = m->values[i];
+    }
+    bigger.used = m->used;
+    map_free(m);
+    *m = bigger;
+    return 0;
+}
+
+// remove the key at slot i, shifting later entries of its probe run back
+static void
+map_erase(line_map* m,size_t i)
+{
+    size_t j = i;
+    for(;;)
+    {
+        j = (j + 1) & m->mask;
+        if(!m->keys[j])
+            break;
+        size_t home = map_hash(m->keys[j] - 1,m->mask);
+        // the entry at j may move to i if i lies cyclically in [home, j)
+        if((j > i && (home <= i || home > j)) || (j < i && home <= i && home > j))
+        {
+            m->keys[i] = m->keys[j];
+            m->values[i] = m->values[j];
+            i = j;
+        }
+    }
+    m->keys[i] = 0;
+    --m->used;
+}
+
+/*
+ * per set: slots of lines with their next use and a max-heap of slot
+ * numbers on next use
+ */
+typedef struct
+{
+    uint32_t* line;         // [set][way]
+    uint32_t* next;
+    uint32_t* heap;         // [set][position] = way
+    uint32_t* pos;          // [set][way] = position
+    uint32_t* count;        // valid lines per set
+}opt_sets;
+
+static inline void
+heap_swap(uint32_t* heap,uint32_t* pos,unsigned a,unsigned b)
+{
+    uint32_t t = heap[a];
+    heap[a] = heap[b];
+    heap[b] = t;
+    pos[heap[a]] = a;
+    pos[heap[b]] = b;
+}
+
+// restore the heap around position i after its key changed
+static void
+heap_fix(uint32_t* heap,uint32_t* pos,const uint32_t* next,unsigned n,unsigned i)
+{
+    while(i && next[heap[(i - 1)/2]] < next[heap[i]])
+    {
+        heap_swap(heap,pos,i,(i - 1)/2);
+        i = (i - 1)/2;
+    }
+    for(;;)
+    {
+        unsigned largest = i, l = 2*i + 1, r = 2*i + 2;
+        if(l < n && next[heap[l]] > next[heap[largest]])
+            largest = l;
+        if(r < n && next[heap[r]] > next[heap[largest]])
+            largest = r;
+        if(largest == i)
+            return;
+        heap_swap(heap,pos,i,largest);
+        i = largest;
+    }
+}
+
+/*
+ * next[k] = index in reach of the next access to the same line, NEVER if none
+ */
+static int
+next_uses(const uint32_t* lines,size_t n,uint32_t* next)
+{
+    line_map seen;
+    if(map_init(&seen,1024))
+        return -1;
+    for(size_t k = n;k-- > 0;)
+    {
+        size_t i = map_find(&seen,lines[k]);
+        if(seen.keys[i])
+        {
+            next[k] = seen.values[i];
+            seen.values[i] = k;
+            continue;
+        }
+        next[k] = NEVER;
+        seen.keys[i] = lines[k] + 1ull;
+        seen.values[i] = k;
+        if(2*++seen.used > seen.mask && map_grow(&seen))
+        {
+            map_free(&seen);
+            return -1;
+        }
+    }
+    map_free(&seen);
+    return 0;
+}
+
+/*
+ * simulate one level under MIN; the accesses in reach that miss are moved
+ * to its front and their number returned
+ */
+static size_t
+opt_level(const level_geometry* geom,unsigned ways,const uint32_t* addresses,uint32_t* reach,size_t n,
+          const uint32_t* lines,const uint32_t* next,opt_sets* s,line_map* where,cache_stats* stats)
+{
+    size_t misses = 0;
+    for(size_t k = 0;k < n;++k)
+    {
+        address_info info = {0}, fa_info;
+        decompose_address(geom,addresses[reach[k]],&info,&fa_info);
+        uint32_t set = info.index;
+        uint32_t* line = s->line + (size_t)set*ways;
+        uint32_t* nx = s->next + (size_t)set*ways;
+        uint32_t* heap = s->heap + (size_t)set*ways;
+        uint32_t* pos = s->pos + (size_t)set*ways;
+        size_t i = map_find(where,lines[k]);
+        if(where->keys[i])
+        {
+            unsigned w = where->values[i];
+            nx[w] = next[k];
+            heap_fix(heap,pos,nx,s->count[set],pos[w]);
+            ++stats->hits;
+            continue;
+        }
+
+        ++stats->total_misses;
+        reach[misses++] = reach[k];
+        unsigned w;
+        if(s->count[set] < ways)
+        {
+            // a free way: the victim is invalid, as the model counts cold misses
+            ++stats->cold_misses;
+            w = s->count[set];
+            pos[w] = s->count[set];
+            heap[s->count[set]++] = w;
+        }
+        else
+        {
+            w = heap[0];
+            map_erase(where,map_find(where,line[w]));
+            i = map_find(where,lines[k]);
+        }
+        line[w] = lines[k];
+        nx[w] = next[k];
+        heap_fix(heap,pos,nx,s->count[set],pos[w]);
+        where->keys[i] = lines[k] + 1ull;
+        where->values[i] = w;
+        ++where->used;
+    }
+    return misses;
+}
+
+int
+cachesim_run_opt(const cachesim_config* config,const unsigned char* records,size_t n,cache_stats* stats)
+{
+    if(n >= NEVER)
+        return -1;
+    // the hierarchy is only built for its geometry
+    cachesim* sim = cachesim_create(config);
+    if(!sim)
+        return -1;
+    uint32_t* addresses = malloc(n*sizeof(uint32_t) + 1);
+    uint32_t* reach = malloc(n*sizeof(uint32_t) + 1);
+    uint32_t* lines = malloc(n*sizeof(uint32_t) + 1);
+    uint32_t* next = malloc(n*sizeof(uint32_t) + 1);
+    int err = !addresses || !reach || !lines || !next;
+
+    // only reads and writes reach the hierarchy
+    size_t reaching = 0;
+    for(size_t i = 0;!err && i < n;++i)
+    {
+        char op;
+        decode_record(records + i*CACHESIM_RECORD_SIZE,&addresses[i],&op);
+        if(op == 'r' || op == 'w')
+            reach[reaching++] = i;
+    }
+
+    memset(stats,0,sim->n_levels*sizeof(cache_stats));
+    for(unsigned l = 0;!err && l < sim->n_levels;++l)
+    {
+        const level_geometry* geom = &sim->geom[l];
+        if(sim->levels[l]->type == skewed_associative)
+        {
+            err = 1;
+            break;
+        }
+        unsigned ways = geom->g.n_lines/geom->g.n_sets;
+        unsigned n_sets = geom->g.n_sets;
+        for(size_t k = 0;k < reaching;++k)
+            lines[k] = addresses[reach[k]] >> geom->g.block_offset_bits;
+        if(next_uses(lines,reaching,next))
+        {
+            err = 1;
+            break;
+        }
+        // next uses are positions in reach; only their order matters
+
+        opt_sets s;
+        line_map where;
+        memset(&where,0,sizeof(where));
+        size_t slots = (size_t)n_sets*ways;
+        s.line = malloc(slots*sizeof(uint32_t));
+        s.next = malloc(slots*sizeof(uint32_t));
+        s.heap = malloc(slots*sizeof(uint32_t));
+        s.pos = malloc(slots*sizeof(uint32_t));
+        s.count = calloc(n_sets,sizeof(uint32_t));
+        err = !s.line || !s.next || !s.heap || !s.pos || !s.count || map_init(&where,slots);
+        if(!err)
+        {
+            stats[l].total_accesses = reaching;
+            reaching = opt_level(geom,ways,addresses,reach,reaching,lines,next,&s,&where,&stats[l]);
+        }
+        map_free(&where);
+        free(s.line);
+        free(s.next);
+        free(s.heap);
+        free(s.pos);
+        free(s.count);
+    }
+    free(addresses);
+    free(reach);
+    free(lines);
+    free(next);
+    cachesim_destroy(sim);
+    return err ? -1 : 0;
+}
@@ -0,0 +1,316 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <pthread.h>
+
+#include "cache.h"
+
+/*
+ * Set-partitioned parallel simulation of one hierarchy.
+ *
+ * The sets of every level are split into contiguous ranges, one per thread.
+ * A block of trace records is processed level by level:
+ *   route    each thread scans its slice of the block and appends the
+ *            records that reach this level to per-(thread, shard) buffers
+ *   simulate each thread walks the buffers of its shard in slice order, so
+ *            every set sees its records in trace order, and marks hits
+ * with a barrier between the two. Each record keeps its global access index
+ * as the LRU time, so the result is identical to the serial run.
+ *
+ * Each thread updates a private copy of every level's cache_t header that
+ * shares the line storage but has its own stats; the copies are folded
+ * into the real stats after every block. The fully associative shadows are
+ * single sets and are simulated by the last thread.
+ */
+
+typedef struct
+{
+    address_info info[CACHESIM_MAX_LEVELS];
+    address_info fa_info[CACHESIM_MAX_LEVELS];
+    char op;
+    unsigned char level;    // level that hit, n_levels while missing, n_levels+1 if not an access
+}par_record;
+
+struct cachesim_parallel
+{
+    cachesim* sim;
+    unsigned threads;
+    pthread_t* workers;
+    pthread_barrier_t barrier;
+    pthread_mutex_t start;  // held by the creator until every worker exists
+    int abandoned;          // set under start when a worker could not be created
+    int quit;
+
+    // current job
+    const unsigned char* records;
+    size_t n;
+    ssize_t base;           // clock of the first record
+
+    size_t capacity;
+    par_record* block;
+    uint32_t** route;       // route[w*threads + s]: record indices slice w sends to shard s
+    size_t* route_len;
+    cache_t* shard_cache;   // shard_cache[s*n_levels + l]: private header of level l for shard s
+    cache_t* shard_fa;      // private headers of the shadows, used by the last thread
+};
+
+typedef struct
+{
+    cachesim_parallel* p;
+    unsigned id;
+}par_worker;
+
+static inline unsigned
+owner(const cachesim_parallel* p,unsigned l,unsigned set)
+{
+    return (uint64_t)set*p->threads/p->sim->geom[l].g.n_sets;
+}
+
+static void
+fold_stats(cache_stats* into,cache_stats* from)
+{
+    into->total_accesses += from->total_accesses;
+    into->hits += from->hits;
+    into->total_misses += from->total_misses;
+    into->cold_misses += from->cold_misses;
+    into->capacity_misses += from->capacity_misses;
+    into->conflict_misses += from->conflict_misses;
+    memset(from,0,sizeof(cache_stats));
+}
+
+/*
+ * one thread's share of the current block
+ */
+static void
+run_block(cachesim_parallel* p,unsigned id)
+{
+    cachesim* sim = p->sim;
+    unsigned T = p->threads;
+    size_t slice = (p->n + T - 1)/T;
+    size_t begin = id*slice < p->n ? id*slice : p->n;
+    size_t end = begin + slice < p->n ? begin + slice : p->n;
+
+    // decode and decompose this thread's slice once for all levels
+    for(size_t i = begin;i < end;++i)
+    {
+        uint32_t address;
+        par_record* r = &p->block[i];
+        decode_record(p->records + i*CACHESIM_RECORD_SIZE,&address,&r->op);
+        for(unsigned l = 0;l < sim->n_levels;++l)
+            decompose_address(&sim->geom[l],address,&r->info[l],&r->fa_info[l]);
+        r->level = ((r->op == 'r') || (r->op == 'w')) ? sim->n_levels : sim->n_levels + 1;
+    }
+
+    for(unsigned l = 0;l < sim->n_levels;++l)
+    {
+        // route the records of this slice that still miss to the owning shard
+        for(unsigned s = 0;s < T;++s)
+            p->route_len[id*T + s] = 0;
+        for(size_t i = begin;i < end;++i)
+        {
+            if(p->block[i].level != sim->n_levels)
+                continue;
+            unsigned s = owner(p,l,p->block[i].info[l].index);
+            p->route[id*T + s][p->route_len[id*T + s]++] = i;
+        }
+        pthread_barrier_wait(&p->barrier);
+
+        // simulate this shard's sets in trace order
+        cache_t* cache = &p->shard_cache[id*sim->n_levels + l];
+        for(unsigned w = 0;w < T;++w)
+        {
+            const uint32_t* route = p->route[w*T + id];
+            size_t len = p->route_len[w*T + id];
+            for(size_t k = 0;k < len;++k)
+            {
+                par_record* r = &p->block[route[k]];
+                if(access_cache(cache,r->info[l],r->op,p->base + route[k]))
+                    r->level = l;
+            }
+        }
+        if(id == T - 1)
+        {
+            for(size_t i = 0;i < p->n;++i)
+            {
+                par_record* r = &p->block[i];
+                if((r->op == 'r') || (r->op == 'w'))
+                    access_cache(&p->shard_fa[l],r->fa_info[l],r->op,p->base + i);
+            }
+        }
+        pthread_barrier_wait(&p->barrier);
+    }
+}
+
+static void*
+worker_main(void* arg)
+{
+    par_worker* w = arg;
+    cachesim_parallel* p = w->p;
+    // wait for the creator: a missing worker would leave the barrier one short
+    pthread_mutex_lock(&p->start);
+    int abandoned = p->abandoned;
+    pthread_mutex_unlock(&p->start);
+    while(!abandoned)
+    {
+        pthread_barrier_wait(&p->barrier);
+        if(p->quit)
+            break;
+        run_block(p,w->id);
+    }
+    free(w);
+    return NULL;
+}
+
+static int
+reserve(cachesim_parallel* p,size_t n)
+{
+    if(n <= p->capacity)
+        return 0;
+    par_record* block = realloc(p->block,n*sizeof(par_record));
+    if(!block)
+        return -1;
+    p->block = block;
+    for(unsigned i = 0;i < p->threads*p->threads;++i)
+    {
+        // a slice can send all of its records to one shard
+        uint32_t* route = realloc(p->route[i],((n + p->threads - 1)/p->threads)*sizeof(uint32_t));
+        if(!route)
+            return -1;
+        p->route[i] = route;
+    }
+    p->capacity = n;
+    return 0;
+}
+
+static void
+free_parallel(cachesim_parallel* p)
+{
+    if(p->route)
+        for(unsigned i = 0;i < p->threads*p->threads;++i)
+            free(p->route[i]);
+    free(p->route);
+    free(p->route_len);
+    free(p->shard_cache);
+    free(p->shard_fa);
+    free(p->workers);
+    free(p->block);
+    free(p);
+}
+
+cachesim_parallel*
+cachesim_parallel_create(cachesim* sim,unsigned threads)
+{
+    // a skewed level spreads one line over several sets, which shards can not split
+    for(unsigned l = 0;l < sim->n_levels;++l)
+        if(sim->profile[l] || sim->geom[l].index_fn == CACHESIM_INDEX_SKEWED)
+            return NULL;
+    if(!threads || sim->part || sim->log || sim->dram || sim->dead)
+        return NULL;
+
+    cachesim_parallel* p = calloc(1,sizeof(cachesim_parallel));
+    if(!p)
+        return NULL;
+    p->sim = sim;
+    p->threads = threads;
+    p->route = calloc(threads*threads,sizeof(uint32_t*));
+    p->route_len = calloc(threads*threads,sizeof(size_t));
+    p->shard_cache = malloc(threads*sim->n_levels*sizeof(cache_t));
+    p->shard_fa = malloc(sim->n_levels*sizeof(cache_t));
+    p->workers = calloc(threads,sizeof(pthread_t));
+    if(!p->route || !p->route_len || !p->shard_cache || !p->shard_fa || !p->workers)
+    {
+        free_parallel(p);
+        return NULL;
+    }
+    for(unsigned s = 0;s < threads;++s)
+    {
+        for(unsigned l = 0;l < sim->n_levels;++l)
+        {
+            p->shard_cache[s*sim->n_levels + l] = *sim->levels[l];
+            memset(&p->shard_cache[s*sim->n_levels + l].stats,0,sizeof(cache_stats));
+        }
+    }
+    for(unsigned l = 0;l < sim->n_levels;++l)
+    {
+        p->shard_fa[l] = *sim->fa[l];
+        memset(&p->shard_fa[l].stats,0,sizeof(cache_stats));
+    }
+    if(pthread_barrier_init(&p->barrier,NULL,threads))
+    {
+        free_parallel(p);
+        return NULL;
+    }
+    if(pthread_mutex_init(&p->start,NULL))
+    {
+        pthread_barrier_destroy(&p->barrier);
+        free_parallel(p);
+        return NULL;
+    }
+
+    // the calling thread acts as worker 0
+    pthread_mutex_lock(&p->start);
+    unsigned started = 1;
+    for(;started < threads;++started)
+    {
+        par_worker* w = malloc(sizeof(par_worker));
+        if(!w)
+            break;
+        w->p = p;
+        w->id = started;
+        if(pthread_create(&p->workers[started],NULL,worker_main,w))
+        {
+            free(w);
+            break;
+        }
+    }
+    p->abandoned = started < threads;
+    pthread_mutex_unlock(&p->start);
+    if(p->abandoned)
+    {
+        for(unsigned t = 1;t < started;++t)
+            pthread_join(p->workers[t],NULL);
+        pthread_mutex_destroy(&p->start);
+        pthread_barrier_destroy(&p->barrier);
+        free_parallel(p);
+        return NULL;
+    }
+    return p;
+}
+
+size_t
+cachesim_parallel_run_trace(cachesim_parallel* p,const unsigned char* records,size_t n)
+{
+    cachesim* sim = p->sim;
+    if(!n)
+        return 0;
+    if(reserve(p,n))
+        return 0;
+    p->records = records;
+    p->n = n;
+    p->base = sim->clock;
+
+    pthread_barrier_wait(&p->barrier);
+    run_block(p,0);
+
+    for(unsigned s = 0;s < p->threads;++s)
+        for(unsigned l = 0;l < sim->n_levels;++l)
+            fold_stats(&sim->levels[l]->stats,&p->shard_cache[s*sim->n_levels + l].stats);
+    for(unsigned l = 0;l < sim->n_levels;++l)
+        fold_stats(&sim->fa[l]->stats,&p->shard_fa[l].stats);
+    sim->clock += n;
+    return n;
+}
+
+void
+cachesim_parallel_destroy(cachesim_parallel* p)
+{
+    if(!p)
+        return;
+    p->quit = 1;
+    pthread_barrier_wait(&p->barrier);
+    for(unsigned t = 1;t < p->threads;++t)
+        pthread_join(p->workers[t],NULL);
+    pthread_barrier_destroy(&p->barrier);
+    pthread_mutex_destroy(&p->start);
+    free_parallel(p);
+}
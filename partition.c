@@ -0,0 +1,153 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "partition.h"
+
+// mask of n ways starting at way first
+static uint64_t
+way_range(unsigned first,unsigned n)
+{
+    return (n < 64 ? (1ull << n) - 1 : ~0ull) << first;
+}
+
+/*
+ * masks are checked against the ways of the level; a class may always
+ * find a way to fill, and repartitioning needs a way for every class
+ */
+partition_state*
+partition_create(const cachesim_partition_config* config,unsigned ways,unsigned n_sets)
+{
+    if(!config->n_classes || config->n_classes > CACHESIM_MAX_CLASSES || ways > 64)
+        return NULL;
+    if(config->interval && config->n_classes > ways)
+        return NULL;
+    partition_state* p = calloc(1,sizeof(partition_state));
+    if(!p)
+        return NULL;
+    p->config = *config;
+    p->ways = ways;
+    uint64_t all = way_range(0,ways);
+    for(unsigned c = 0;c < config->n_classes;++c)
+    {
+        if(!p->config.way_mask[c])
+            p->config.way_mask[c] = all;
+        p->config.way_mask[c] &= all;
+        if(!p->config.way_mask[c])
+        {
+            free(p);
+            return NULL;
+        }
+    }
+
+    if(p->config.sample_shift > 31)
+        p->config.sample_shift = 31;
+    p->sample_mask = (1u << p->config.sample_shift) - 1;
+    p->n_sampled = ((n_sets - 1) >> p->config.sample_shift) + 1;
+    if(config->interval)
+    {
+        p->tags = calloc((size_t)config->n_classes*p->n_sampled*ways,sizeof(uint64_t));
+        p->way_hits = calloc((size_t)config->n_classes*ways,sizeof(uint64_t));
+        if(!p->tags || !p->way_hits)
+        {
+            partition_destroy(p);
+            return NULL;
+        }
+        p->next = config->interval;
+    }
+    return p;
+}
+
+void
+partition_destroy(partition_state* p)
+{
+    if(!p)
+        return;
+    free(p->tags);
+    free(p->way_hits);
+    free(p);
+}
+
+/*
+ * clear the statistics and monitors; the masks stay as they are
+ */
+void
+partition_reset(partition_state* p)
+{
+    memset(p->stats,0,sizeof(p->stats));
+    if(p->tags)
+    {
+        memset(p->tags,0,(size_t)p->config.n_classes*p->n_sampled*p->ways*sizeof(uint64_t));
+        memset(p->way_hits,0,(size_t)p->config.n_classes*p->ways*sizeof(uint64_t));
+    }
+    p->next = p->config.interval;
+    p->repartitions = 0;
+}
+
+/*
+ * an access of the current class reaching the partitioned level in set
+ */
+void
+umon_access(partition_state* p,unsigned set,unsigned tag)
+{
+    if(!p->tags || (set & p->sample_mask))
+        return;
+    uint64_t* stack = p->tags + ((size_t)p->cls*p->n_sampled + (set >> p->config.sample_shift))*p->ways;
+    uint64_t key = (uint64_t)tag + 1;
+    unsigned w = 0;
+    // a miss falls through to the LRU position, which it replaces
+    while(w + 1 < p->ways && stack[w] != key)
+        ++w;
+    if(stack[w] == key)
+        ++p->way_hits[p->cls*p->ways + w];
+    memmove(stack + 1,stack,w*sizeof(uint64_t));
+    stack[0] = key;
+}
+
+/*
+ * lookahead allocation: every class starts with one way, then the class
+ * and way count with the highest monitored hits per added way take the
+ * next ways until none are left. Classes get contiguous masks in class
+ * order and the counters are halved so older behaviour fades
+ */
+void
+partition_rebalance(partition_state* p)
+{
+    unsigned n = p->config.n_classes;
+    unsigned alloc[CACHESIM_MAX_CLASSES];
+    unsigned balance = p->ways - n;
+    for(unsigned c = 0;c < n;++c)
+        alloc[c] = 1;
+    while(balance)
+    {
+        double best = -1;
+        unsigned best_class = 0, best_ways = 1;
+        for(unsigned c = 0;c < n;++c)
+        {
+            const uint64_t* hits = p->way_hits + c*p->ways;
+            uint64_t gain = 0;
+            for(unsigned k = 1;k <= balance;++k)
+            {
+                gain += hits[alloc[c] + k - 1];
+                if((double)gain/k > best)
+                {
+                    best = (double)gain/k;
+                    best_class = c;
+                    best_ways = k;
+                }
+            }
+        }
+        alloc[best_class] += best_ways;
+        balance -= best_ways;
+    }
+
+    unsigned first = 0;
+    for(unsigned c = 0;c < n;++c)
+    {
+        p->config.way_mask[c] = way_range(first,alloc[c]);
+        first += alloc[c];
+    }
+    for(size_t i = 0;i < (size_t)n*p->ways;++i)
+        p->way_hits[i] >>= 1;
+    ++p->repartitions;
+}
@@ -0,0 +1,56 @@
+#ifndef PARTITION_H
+#define PARTITION_H
+
+#include <stdint.h>
+#include <sys/types.h>
+
+#include "cachesim.h"
+
+/*
+ * Way partitioning state of one hierarchy: the class masks, per-class
+ * statistics and the utility monitors that drive repartitioning.
+ *
+ * The utility monitor of a class keeps an LRU stack of shadow tags for
+ * every sampled set of the partitioned level, as if the class had the
+ * whole level to itself, and counts hits per stack position. The hits at
+ * position w are what the class would gain from its (w+1)-th way, which is
+ * what the lookahead allocation of utility-based cache partitioning
+ * (Qureshi and Patt) distributes.
+ */
+
+typedef struct
+{
+    cachesim_partition_config config;   // masks are the current ones
+    unsigned ways;
+    unsigned n_sampled;                 // sets with a shadow stack per class
+    unsigned sample_mask;               // set index bits that must be 0 to be sampled
+    unsigned cls;                       // class of the accesses being simulated
+    cache_stats stats[CACHESIM_MAX_CLASSES][CACHESIM_MAX_LEVELS];
+    uint64_t* tags;                     // [class][sampled set][way], tag + 1 with 0 empty, MRU first
+    uint64_t* way_hits;                 // [class][way]
+    uint64_t next;                      // access clock of the next repartition
+    uint64_t repartitions;
+}partition_state;
+
+partition_state* partition_create(const cachesim_partition_config*,unsigned,unsigned);
+void partition_destroy(partition_state*);
+void partition_reset(partition_state*);
+void umon_access(partition_state*,unsigned,unsigned);
+void partition_rebalance(partition_state*);
+
+// count an access of the current class that hit level (n_levels for memory)
+static inline void
+partition_count(partition_state* p,unsigned level,unsigned n_levels)
+{
+    cache_stats* s = p->stats[p->cls];
+    for(unsigned l = 0;l < n_levels && l <= level;++l)
+    {
+        ++s[l].total_accesses;
+        if(l == level)
+            ++s[l].hits;
+        else
+            ++s[l].total_misses;
+    }
+}
+
+#endif
@@ -0,0 +1,234 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+#include "perf.h"
+
+static const char* phase_names[PERF_N_PHASES] =
+{
+    "read", "decode", "decompose", "lookup", "replace"
+};
+
+static const char* counter_names[PERF_N_COUNTERS] =
+{
+    "cycles", "instructions", "llc-misses", "branch-misses", "task-clock(ns)"
+};
+
+static const struct
+{
+    unsigned type;
+    unsigned long long config;
+}counter_events[PERF_N_COUNTERS] =
+{
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+    {PERF_TYPE_SOFTWARE, PERF_COUNT_SW_TASK_CLOCK}
+};
+
+static uint64_t read_counter(const perf_ctx*,int);
+
+/*
+ * open every counter for the calling thread, user space only
+ * returns the number of counters that could be opened
+ */
+int
+perf_init(perf_ctx* ctx,unsigned period)
+{
+    memset(ctx,0,sizeof(perf_ctx));
+    ctx->period = period ? period : 1;
+    for(int c = 0;c < PERF_N_COUNTERS;++c)
+    {
+        struct perf_event_attr attr;
+        memset(&attr,0,sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = counter_events[c].type;
+        attr.config = counter_events[c].config;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+
+        ctx->fd[c] = syscall(SYS_perf_event_open,&attr,0,-1,-1,0);
+        ctx->page[c] = NULL;
+        if(ctx->fd[c] < 0)
+            continue;
+        ctx->available |= 1u << c;
+
+        // the first page lets us read the counter with rdpmc instead of a syscall
+        void* page = mmap(NULL,sysconf(_SC_PAGESIZE),PROT_READ,MAP_SHARED,ctx->fd[c],0);
+        if(page != MAP_FAILED)
+            ctx->page[c] = page;
+    }
+
+    int opened = __builtin_popcount(ctx->available);
+    if(!opened)
+        printf("perf: no performance counters available, instrumentation disabled\n");
+    return opened;
+}
+
+void
+perf_deinit(perf_ctx* ctx)
+{
+    for(int c = 0;c < PERF_N_COUNTERS;++c)
+    {
+        if(!(ctx->available & (1u << c)))
+            continue;
+        if(ctx->page[c])
+            munmap(ctx->page[c],sysconf(_SC_PAGESIZE));
+        close(ctx->fd[c]);
+    }
+    ctx->available = 0;
+    ctx->active = 0;
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+static inline uint64_t
+rdpmc(uint32_t counter)
+{
+    uint32_t low, high;
+    __asm__ volatile("rdpmc" : "=a"(low), "=d"(high) : "c"(counter));
+    return ((uint64_t)high << 32) | low;
+}
+#endif
+
+static uint64_t
+read_counter(const perf_ctx* ctx,int c)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    volatile struct perf_event_mmap_page* pc = ctx->page[c];
+    if(pc)
+    {
+        uint32_t seq, index;
+        uint64_t count;
+        int ok = 1;
+        do
+        {
+            seq = pc->lock;
+            __asm__ volatile("" ::: "memory");
+            index = pc->index;
+            count = pc->offset;
+            if(pc->cap_user_rdpmc && index)
+            {
+                uint64_t pmc = rdpmc(index - 1);
+                unsigned shift = 64 - pc->pmc_width;
+                count += (uint64_t)(((int64_t)(pmc << shift)) >> shift);
+            }
+            else
+                ok = 0;
+            __asm__ volatile("" ::: "memory");
+        }while(pc->lock != seq);
+        if(ok)
+            return count;
+    }
+#endif
+    uint64_t value = 0;
+    if(read(ctx->fd[c],&value,sizeof(value)) != sizeof(value))
+        return 0;
+    return value;
+}
+
+/*
+ * start bracketing access number i if it falls on the sampling period
+ */
+void
+perf_begin(perf_ctx* ctx,ssize_t i)
+{
+    ctx->active = ctx->available && (i % ctx->period == 0);
+    if(!ctx->active)
+        return;
+    ++ctx->sampled;
+    for(int c = 0;c < PERF_N_COUNTERS;++c)
+        if(ctx->available & (1u << c))
+            ctx->last[c] = read_counter(ctx,c);
+}
+
+/*
+ * charge everything since the previous mark to phase p
+ */
+void
+perf_mark(perf_ctx* ctx,perf_phase p)
+{
+    if(!ctx->active)
+        return;
+    for(int c = 0;c < PERF_N_COUNTERS;++c)
+    {
+        if(!(ctx->available & (1u << c)))
+            continue;
+        uint64_t now = read_counter(ctx,c);
+        ctx->totals[p][c] += now - ctx->last[c];
+        ctx->last[c] = now;
+    }
+    ++ctx->calls[p];
+}
+
+/*
+ * bracket one block read; its cost is spread over the records it returned
+ * rather than the sampled accesses, since every record pays for it
+ */
+void
+perf_read_begin(perf_ctx* ctx)
+{
+    for(int c = 0;c < PERF_N_COUNTERS;++c)
+        if(ctx->available & (1u << c))
+            ctx->last[c] = read_counter(ctx,c);
+}
+
+void
+perf_read_end(perf_ctx* ctx,size_t records)
+{
+    if(!ctx->available)
+        return;
+    for(int c = 0;c < PERF_N_COUNTERS;++c)
+    {
+        if(!(ctx->available & (1u << c)))
+            continue;
+        uint64_t now = read_counter(ctx,c);
+        ctx->totals[PERF_READ][c] += now - ctx->last[c];
+        ctx->last[c] = now;
+    }
+    ++ctx->calls[PERF_READ];
+    ctx->read_records += records;
+}
+
+void
+perf_report(const perf_ctx* ctx)
+{
+    if(!ctx->available || !ctx->sampled)
+        return;
+    printf("host counters per simulated access (%zd sampled, period %u):\n",ctx->sampled,ctx->period);
+    printf("%-10s","phase");
+    for(int c = 0;c < PERF_N_COUNTERS;++c)
+        printf("%16s",counter_names[c]);
+    printf("\n");
+
+    double sum[PERF_N_COUNTERS] = {0};
+    for(int p = 0;p <= PERF_N_PHASES;++p)
+    {
+        printf("%-10s",p < PERF_N_PHASES ? phase_names[p] : "total");
+        for(int c = 0;c < PERF_N_COUNTERS;++c)
+        {
+            if(!(ctx->available & (1u << c)))
+            {
+                printf("%16s","n/a");
+                continue;
+            }
+            double v;
+            if(p == PERF_READ)
+                v = ctx->read_records ? (double)ctx->totals[p][c]/ctx->read_records : 0;
+            else if(p < PERF_N_PHASES)
+                v = (double)ctx->totals[p][c]/ctx->sampled;
+            else
+                v = sum[c];
+            if(p < PERF_N_PHASES)
+                sum[c] += v;
+            printf("%16.2f",v);
+        }
+        printf("\n");
+    }
+    printf("\n");
+}
@@ -0,0 +1,64 @@
+#ifndef PERF_H
+#define PERF_H
+
+#include <stdint.h>
+#include <sys/types.h>
+
+#include "cachesim.h"
+
+/*
+ * Optional host performance counter instrumentation of the simulation loop.
+ *
+ * Counters are opened with perf_event_open() on the calling thread and read
+ * with rdpmc when the kernel allows user-space reads, falling back to read().
+ * Every counter that cannot be opened is reported as n/a; if none can be
+ * opened the instrumentation turns itself off and the run is unaffected.
+ */
+
+// phases of one simulated access, in the order they are bracketed
+typedef enum
+{
+    PERF_READ = 0,          // reading trace blocks from the file, averaged over every record read
+    PERF_DECODE,            // unpacking the record from the block
+    PERF_DECOMPOSE,         // splitting the address into tag/index/offset
+    PERF_LOOKUP,            // access_cache() calls that hit
+    PERF_REPLACE,           // access_cache() calls that miss (lookup + LRU victim + fill)
+    PERF_N_PHASES
+}perf_phase;
+
+typedef enum
+{
+    PERF_CYCLES = 0,
+    PERF_INSTRUCTIONS,
+    PERF_LLC_MISSES,
+    PERF_BRANCH_MISSES,
+    PERF_TASK_CLOCK,        // software event, nanoseconds; usually available even in VMs
+    PERF_N_COUNTERS
+}perf_counter;
+
+typedef struct
+{
+    int fd[PERF_N_COUNTERS];
+    void* page[PERF_N_COUNTERS];
+    unsigned available;     // bitmask of opened counters
+    unsigned period;        // bracket every period-th access
+    int active;             // counters are being read for the current access
+    uint64_t last[PERF_N_COUNTERS];
+    uint64_t totals[PERF_N_PHASES][PERF_N_COUNTERS];
+    ssize_t calls[PERF_N_PHASES];
+    ssize_t sampled;
+    ssize_t read_records;   // records delivered by bracketed block reads
+}perf_ctx;
+
+int perf_init(perf_ctx*,unsigned);
+void perf_begin(perf_ctx*,ssize_t);
+void perf_mark(perf_ctx*,perf_phase);
+void perf_read_begin(perf_ctx*);
+void perf_read_end(perf_ctx*,size_t);
+void perf_report(const perf_ctx*);
+void perf_deinit(perf_ctx*);
+
+// cachesim_run_trace with every period-th access bracketed by phase
+size_t cachesim_run_trace_perf(cachesim*,const unsigned char*,size_t,perf_ctx*);
+
+#endif
@@ -0,0 +1,333 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <sched.h>
+
+#include "cache.h"
+
+/*
+ * Pipelined simulation: one thread per cache level.
+ *
+ * The calling thread decodes the trace and runs the fully associative
+ * shadows and L1. Every L1 miss is pushed into a bounded single-producer,
+ * single-consumer ring read by the L2 thread, whose misses feed the L3
+ * thread, and so on. Producers publish their head once per batch and
+ * consumers drain everything published before storing their tail, so the
+ * shared indices move once per batch rather than once per record. A
+ * consumer that finds its ring empty for a while sleeps until the producer
+ * next publishes, so idle levels do not hold a core.
+ *
+ * Every record carries its global access index as the LRU time and each
+ * level is touched by exactly one thread, so statistics are identical to
+ * the serial run. The model does not propagate dirty evictions to the
+ * next level, so the stream between levels is the miss stream only.
+ */
+
+#define PIPE_RING 16384     // records per ring, power of two
+#define PIPE_BATCH 256      // records between head publications
+#define PIPE_SPINS 64       // empty polls before a consumer sleeps
+
+#define PIPE_FLUSH 0        // op of the end-of-run marker
+#define PIPE_QUIT 1         // op of the shutdown marker
+
+typedef struct
+{
+    ssize_t time;
+    uint32_t address;
+    char op;
+    unsigned char fa_hits;  // bit l: the shadow of level l hit, for the event log
+}pipe_record;
+
+typedef struct
+{
+    pipe_record* ring;
+    // producer and consumer indices on separate cache lines
+    _Alignas(64) atomic_size_t head;
+    size_t pending;         // producer: written but not yet published
+    size_t tail_cache;      // producer: last tail it saw
+    _Alignas(64) atomic_size_t tail;
+    atomic_int sleeping;    // consumer is waiting on wake for the head to move
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+}spsc_queue;
+
+typedef struct
+{
+    struct cachesim_pipeline* p;
+    unsigned level;
+}pipe_stage;
+
+struct cachesim_pipeline
+{
+    cachesim* sim;
+    spsc_queue* queues;     // queues[l-1] feeds level l
+    pipe_stage* stages;
+    pthread_t* threads;
+    atomic_size_t flushed;  // flush markers that reached the last level
+    size_t epoch;
+};
+
+static void
+queue_publish(spsc_queue* q)
+{
+    size_t head = atomic_load_explicit(&q->head,memory_order_relaxed);
+    // sequentially consistent against queue_wait, so a sleeping consumer is always seen
+    atomic_store(&q->head,head + q->pending);
+    q->pending = 0;
+    if(atomic_load(&q->sleeping))
+    {
+        pthread_mutex_lock(&q->lock);
+        pthread_cond_signal(&q->wake);
+        pthread_mutex_unlock(&q->lock);
+    }
+}
+
+// consumer: wait until the head moves past tail, yielding first, then asleep
+static void
+queue_wait(spsc_queue* q,size_t tail)
+{
+    for(unsigned spin = 0;spin < PIPE_SPINS;++spin)
+    {
+        if(atomic_load_explicit(&q->head,memory_order_acquire) != tail)
+            return;
+        sched_yield();
+    }
+    pthread_mutex_lock(&q->lock);
+    atomic_store(&q->sleeping,1);
+    while(atomic_load(&q->head) == tail)
+        pthread_cond_wait(&q->wake,&q->lock);
+    atomic_store_explicit(&q->sleeping,0,memory_order_relaxed);
+    pthread_mutex_unlock(&q->lock);
+}
+
+static void
+queue_push(spsc_queue* q,const pipe_record* r)
+{
+    size_t head = atomic_load_explicit(&q->head,memory_order_relaxed) + q->pending;
+    while(head - q->tail_cache >= PIPE_RING)
+    {
+        // full: publish what we have so the consumer can make room
+        if(q->pending)
+        {
+            queue_publish(q);
+            head = atomic_load_explicit(&q->head,memory_order_relaxed);
+        }
+        q->tail_cache = atomic_load_explicit(&q->tail,memory_order_acquire);
+        if(head - q->tail_cache >= PIPE_RING)
+            sched_yield();
+    }
+    q->ring[head & (PIPE_RING - 1)] = *r;
+    if(++q->pending == PIPE_BATCH)
+        queue_publish(q);
+}
+
+static void
+push_marker(spsc_queue* q,char op)
+{
+    pipe_record marker = {0, 0, op, 0};
+    queue_push(q,&marker);
+    queue_publish(q);
+}
+
+/*
+ * thread of level l: simulate its input stream, forward misses and markers
+ */
+static void*
+stage_main(void* arg)
+{
+    pipe_stage* stage = arg;
+    cachesim_pipeline* p = stage->p;
+    cachesim* sim = p->sim;
+    unsigned l = stage->level;
+    spsc_queue* in = &p->queues[l - 1];
+    spsc_queue* out = l + 1 < sim->n_levels ? &p->queues[l] : NULL;
+    cache_t* cache = sim->levels[l];
+    const level_geometry* geom = &sim->geom[l];
+    hotspot_profile* profile = sim->profile[l];
+    event_log* log = sim->log;
+    dram_model* dram = out ? NULL : sim->dram;
+
+    for(;;)
+    {
+        size_t tail = atomic_load_explicit(&in->tail,memory_order_relaxed);
+        size_t head = atomic_load_explicit(&in->head,memory_order_acquire);
+        if(head == tail)
+        {
+            queue_wait(in,tail);
+            continue;
+        }
+        for(;tail != head;++tail)
+        {
+            pipe_record r = in->ring[tail & (PIPE_RING - 1)];
+            if(r.op == PIPE_FLUSH || r.op == PIPE_QUIT)
+            {
+                atomic_store_explicit(&in->tail,tail + 1,memory_order_release);
+                if(out)
+                    push_marker(out,r.op);
+                else if(r.op == PIPE_FLUSH)
+                    atomic_fetch_add_explicit(&p->flushed,1,memory_order_release);
+                if(r.op == PIPE_QUIT)
+                    return NULL;
+                continue;
+            }
+            address_info info, fa_info;
+            decompose_address(geom,r.address,&info,&fa_info);
+            if(access_cache(cache,info,r.op,r.time))
+                continue;
+            if(profile)
+                hotspot_miss(profile,info.index,r.address);
+            if(log)
+                log_miss(log,cache,l,r.time,r.address,&info,r.op,(r.fa_hits >> l) & 1);
+            if(dram)
+                dram_miss(dram,cache,geom,r.time,r.address,&info);
+            if(out)
+                queue_push(out,&r);
+        }
+        atomic_store_explicit(&in->tail,tail,memory_order_release);
+        if(out && out->pending)
+            queue_publish(out);
+    }
+}
+
+// stop the first n stage threads and free everything
+static void
+free_pipeline(cachesim_pipeline* p,unsigned n_threads,unsigned n_queues)
+{
+    if(n_threads)
+    {
+        // each stage forwards the marker before it quits
+        push_marker(&p->queues[0],PIPE_QUIT);
+        for(unsigned s = 0;s < n_threads;++s)
+            pthread_join(p->threads[s],NULL);
+    }
+    for(unsigned s = 0;s < n_queues;++s)
+    {
+        pthread_cond_destroy(&p->queues[s].wake);
+        pthread_mutex_destroy(&p->queues[s].lock);
+        free(p->queues[s].ring);
+    }
+    free(p->queues);
+    free(p->stages);
+    free(p->threads);
+    free(p);
+}
+
+cachesim_pipeline*
+cachesim_pipeline_create(cachesim* sim)
+{
+    // stages would count their class stats without knowing the class
+    if(sim->part || sim->dead)
+        return NULL;
+    cachesim_pipeline* p = calloc(1,sizeof(cachesim_pipeline));
+    if(!p)
+        return NULL;
+    unsigned n_stages = sim->n_levels - 1;
+    p->sim = sim;
+    atomic_init(&p->flushed,0);
+    if(!n_stages)
+        return p;
+
+    p->queues = aligned_alloc(64,((n_stages*sizeof(spsc_queue) + 63)/64)*64);
+    p->stages = calloc(n_stages,sizeof(pipe_stage));
+    p->threads = calloc(n_stages,sizeof(pthread_t));
+    if(!p->queues || !p->stages || !p->threads)
+    {
+        free_pipeline(p,0,0);
+        return NULL;
+    }
+    for(unsigned s = 0;s < n_stages;++s)
+    {
+        spsc_queue* q = &p->queues[s];
+        memset(q,0,sizeof(spsc_queue));
+        atomic_init(&q->head,0);
+        atomic_init(&q->tail,0);
+        atomic_init(&q->sleeping,0);
+        q->ring = malloc(PIPE_RING*sizeof(pipe_record));
+        int err = !q->ring || pthread_mutex_init(&q->lock,NULL);
+        if(!err && pthread_cond_init(&q->wake,NULL))
+        {
+            pthread_mutex_destroy(&q->lock);
+            err = 1;
+        }
+        if(err)
+        {
+            free(q->ring);
+            free_pipeline(p,0,s);
+            return NULL;
+        }
+    }
+    for(unsigned s = 0;s < n_stages;++s)
+    {
+        p->stages[s].p = p;
+        p->stages[s].level = s + 1;
+        if(pthread_create(&p->threads[s],NULL,stage_main,&p->stages[s]))
+        {
+            free_pipeline(p,s,n_stages);
+            return NULL;
+        }
+    }
+    return p;
+}
+
+/*
+ * run n records through the pipeline; returns once every level has
+ * consumed them, so statistics are complete
+ */
+size_t
+cachesim_pipeline_run_trace(cachesim_pipeline* p,const unsigned char* records,size_t n)
+{
+    cachesim* sim = p->sim;
+    spsc_queue* out = sim->n_levels > 1 ? &p->queues[0] : NULL;
+    cache_t* L1 = sim->levels[0];
+
+    for(size_t i = 0;i < n;++i)
+    {
+        uint32_t address;
+        char op;
+        decode_record(records + i*CACHESIM_RECORD_SIZE,&address,&op);
+        ssize_t time = sim->clock++;
+        if((op != 'r') && (op != 'w'))
+            continue;
+
+        address_info info[CACHESIM_MAX_LEVELS], fa_info[CACHESIM_MAX_LEVELS];
+        unsigned char fa_hits = 0;
+        for(unsigned l = 0;l < sim->n_levels;++l)
+        {
+            decompose_address(&sim->geom[l],address,&info[l],&fa_info[l]);
+            fa_hits |= access_cache(sim->fa[l],fa_info[l],op,time) << l;
+        }
+        if(access_cache(L1,info[0],op,time))
+            continue;
+        if(sim->profile[0])
+            hotspot_miss(sim->profile[0],info[0].index,address);
+        if(sim->log)
+            log_miss(sim->log,L1,0,time,address,&info[0],op,fa_hits & 1);
+        if(!out && sim->dram)
+            dram_miss(sim->dram,L1,&sim->geom[0],time,address,&info[0]);
+        if(out)
+        {
+            pipe_record r = {time, address, op, fa_hits};
+            queue_push(out,&r);
+        }
+    }
+
+    if(out)
+    {
+        push_marker(out,PIPE_FLUSH);
+        ++p->epoch;
+        while(atomic_load_explicit(&p->flushed,memory_order_acquire) != p->epoch)
+            sched_yield();
+    }
+    return n;
+}
+
+void
+cachesim_pipeline_destroy(cachesim_pipeline* p)
+{
+    if(!p)
+        return;
+    unsigned n_stages = p->sim->n_levels - 1;
+    free_pipeline(p,n_stages,n_stages);
+}
@@ -0,0 +1,303 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+
+#include "results.h"
+
+#define HASH_BLOCK (1 << 16)    // trace bytes hashed per read
+
+typedef struct
+{
+    char magic[4];
+    uint32_t size;          // of the whole entry
+    result_key key;
+    result_value value;
+}result_entry;
+
+typedef struct
+{
+    char name[128];
+    off_t size;
+    struct timespec used;
+}store_file;
+
+static const uint64_t P1 = 0x9e3779b185ebca87ull;
+static const uint64_t P2 = 0xc2b2ae3d27d4eb4full;
+
+static inline uint64_t
+rotl(uint64_t x,unsigned r)
+{
+    return (x << r) | (x >> (64 - r));
+}
+
+static inline uint64_t
+lane(uint64_t h,uint64_t word)
+{
+    return rotl(h + word*P2,31)*P1;
+}
+
+static inline uint64_t
+finish(uint64_t h)
+{
+    h ^= h >> 33;
+    h *= P2;
+    h ^= h >> 29;
+    h *= P1;
+    h ^= h >> 32;
+    return h;
+}
+
+/*
+ * four independent lanes over 32 byte blocks so the multiplies overlap;
+ * the tail is folded in a word or byte at a time
+ */
+typedef struct
+{
+    uint64_t v[4];
+    uint64_t length;
+}hash_state;
+
+static void
+hash_init(hash_state* s)
+{
+    s->v[0] = P1 + P2;
+    s->v[1] = P2;
+    s->v[2] = 0;
+    s->v[3] = -P1;
+    s->length = 0;
+}
+
+// n must be a multiple of 32 except for the last call
+static void
+hash_update(hash_state* s,const unsigned char* p,size_t n)
+{
+    size_t i = 0;
+    for(;i + 32 <= n;i += 32)
+    {
+        uint64_t w[4];
+        memcpy(w,p + i,32);
+        s->v[0] = lane(s->v[0],w[0]);
+        s->v[1] = lane(s->v[1],w[1]);
+        s->v[2] = lane(s->v[2],w[2]);
+        s->v[3] = lane(s->v[3],w[3]);
+    }
+    for(;i < n;++i)
+        s->v[i & 3] = lane(s->v[i & 3],p[i]);
+    s->length += n;
+}
+
+static uint64_t
+hash_final(const hash_state* s)
+{
+    uint64_t h = rotl(s->v[0],1) + rotl(s->v[1],7) + rotl(s->v[2],12) + rotl(s->v[3],18);
+    return finish(h ^ s->length*P1);
+}
+
+static uint64_t
+hash_bytes(const void* p,size_t n)
+{
+    hash_state s;
+    hash_init(&s);
+    hash_update(&s,p,n);
+    return hash_final(&s);
+}
+
+/*
+ * write len bytes to dir/name through a temporary file and a rename
+ */
+static int
+publish(const char* dir,const char* name,const void* data,size_t len)
+{
+    char path[4096], tmp[4096];
+    snprintf(path,sizeof(path),"%s/%s",dir,name);
+    snprintf(tmp,sizeof(tmp),"%s/.%s.%ld.tmp",dir,name,(long)getpid());
+    int fd = open(tmp,O_WRONLY | O_CREAT | O_TRUNC,0666);
+    if(fd < 0)
+        return -1;
+    int failed = write(fd,data,len) != len;
+    if(close(fd) || failed || rename(tmp,path))
+    {
+        unlink(tmp);
+        return -1;
+    }
+    return 0;
+}
+
+int
+results_trace_hash(const char* dir,const char* trace,uint64_t records,uint64_t* hash)
+{
+    struct stat st;
+    if(stat(trace,&st))
+        return -1;
+    char memo[128];
+    snprintf(memo,sizeof(memo),"trace-%llx-%llx-%llx-%llx-%llu",(unsigned long long)st.st_dev,
+            (unsigned long long)st.st_ino,(unsigned long long)st.st_size,(unsigned long long)st.st_mtime,
+            (unsigned long long)records);
+    char path[4096];
+    snprintf(path,sizeof(path),"%s/%s",dir,memo);
+    int fd = open(path,O_RDONLY);
+    if(fd >= 0)
+    {
+        int found = read(fd,hash,sizeof(*hash)) == sizeof(*hash);
+        if(found)
+            futimens(fd,NULL);
+        close(fd);
+        if(found)
+            return 0;
+    }
+
+    fd = open(trace,O_RDONLY);
+    if(fd < 0)
+        return -1;
+    posix_fadvise(fd,0,0,POSIX_FADV_SEQUENTIAL);
+    unsigned char* block = malloc(HASH_BLOCK);
+    hash_state s;
+    hash_init(&s);
+    uint64_t left = records*CACHESIM_RECORD_SIZE;
+    int failed = !block;
+    while(!failed && left)
+    {
+        // fill whole blocks so only the last update is partial
+        size_t want = left < HASH_BLOCK ? left : HASH_BLOCK, have = 0;
+        ssize_t got = 1;
+        while(have < want && (got = read(fd,block + have,want - have)) > 0)
+            have += got;
+        failed = got < 0;
+        hash_update(&s,block,have);
+        left -= have;
+        if(have < want)
+            break;
+    }
+    free(block);
+    close(fd);
+    if(failed)
+        return -1;
+    *hash = hash_final(&s);
+    publish(dir,memo,hash,sizeof(*hash));
+    return 0;
+}
+
+static void
+entry_name(const result_key* key,char* name,size_t len)
+{
+    snprintf(name,len,"%016llx.res",(unsigned long long)hash_bytes(key,sizeof(*key)));
+}
+
+int
+results_lookup(const char* dir,const result_key* key,result_value* value)
+{
+    char name[64], path[4096];
+    entry_name(key,name,sizeof(name));
+    snprintf(path,sizeof(path),"%s/%s",dir,name);
+    int fd = open(path,O_RDONLY);
+    if(fd < 0)
+        return -1;
+    result_entry e;
+    int hit = read(fd,&e,sizeof(e)) == sizeof(e) && !memcmp(e.magic,RESULTS_MAGIC,4) && e.size == sizeof(e) &&
+              !memcmp(&e.key,key,sizeof(*key));
+    if(hit)
+    {
+        *value = e.value;
+        // recently used entries survive trimming
+        futimens(fd,NULL);
+    }
+    close(fd);
+    return hit ? 0 : -1;
+}
+
+static int
+older(const void* a,const void* b)
+{
+    const struct timespec* x = &((const store_file*)a)->used;
+    const struct timespec* y = &((const store_file*)b)->used;
+    if(x->tv_sec != y->tv_sec)
+        return x->tv_sec < y->tv_sec ? -1 : 1;
+    return x->tv_nsec < y->tv_nsec ? -1 : x->tv_nsec > y->tv_nsec;
+}
+
+/*
+ * remove the least recently used files until the store fits; only one
+ * process trims at a time, the others skip it
+ */
+static void
+trim(const char* dir,uint64_t max_bytes)
+{
+    char path[4096];
+    snprintf(path,sizeof(path),"%s/.lock",dir);
+    int lock = open(path,O_RDONLY | O_CREAT,0666);
+    if(lock < 0)
+        return;
+    if(flock(lock,LOCK_EX | LOCK_NB))
+    {
+        close(lock);
+        return;
+    }
+
+    DIR* d = opendir(dir);
+    store_file* files = NULL;
+    size_t n = 0, cap = 0;
+    uint64_t total = 0;
+    struct dirent* ent;
+    while(d && (ent = readdir(d)))
+    {
+        struct stat st;
+        // dot files are the lock and entries still being written
+        if(ent->d_name[0] == '.' || strlen(ent->d_name) >= sizeof(files->name))
+            continue;
+        snprintf(path,sizeof(path),"%s/%s",dir,ent->d_name);
+        if(stat(path,&st) || !S_ISREG(st.st_mode))
+            continue;
+        if(n == cap)
+        {
+            cap = cap ? 2*cap : 256;
+            store_file* grown = realloc(files,cap*sizeof(store_file));
+            if(!grown)
+                break;
+            files = grown;
+        }
+        strcpy(files[n].name,ent->d_name);
+        files[n].size = st.st_size;
+        files[n].used = st.st_mtim;
+        total += st.st_size;
+        ++n;
+    }
+    if(d)
+        closedir(d);
+
+    if(total > max_bytes)
+    {
+        qsort(files,n,sizeof(store_file),older);
+        for(size_t i = 0;i < n && total > max_bytes;++i)
+        {
+            snprintf(path,sizeof(path),"%s/%s",dir,files[i].name);
+            if(!unlink(path))
+                total -= files[i].size;
+        }
+    }
+    free(files);
+    flock(lock,LOCK_UN);
+    close(lock);
+}
+
+int
+results_store(const char* dir,const result_key* key,const result_value* value,uint64_t max_bytes)
+{
+    result_entry e;
+    memset(&e,0,sizeof(e));
+    memcpy(e.magic,RESULTS_MAGIC,4);
+    e.size = sizeof(e);
+    e.key = *key;
+    e.value = *value;
+    char name[64];
+    entry_name(key,name,sizeof(name));
+    int failed = publish(dir,name,&e,sizeof(e));
+    if(max_bytes)
+        trim(dir,max_bytes);
+    return failed;
+}
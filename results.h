@@ -0,0 +1,51 @@
+#ifndef RESULTS_H
+#define RESULTS_H
+
+#include <stdint.h>
+
+#include "cachesim.h"
+
+/*
+ * Content-addressed result store.
+ *
+ * A finished run is stored under the hash of what determines its result:
+ * the content of the trace records it read, the number of accesses, the
+ * full hierarchy configuration and CACHESIM_VERSION. Each entry is a small
+ * file in the store directory named after the key hash; it is written
+ * under a temporary name and renamed into place, so parallel runs only
+ * ever see complete entries, and it repeats the full key so a hash
+ * collision reads as a miss.
+ *
+ * Hashing a trace means reading it, so the trace hash is also remembered
+ * per trace file (device, inode, size, mtime and records hashed) in the
+ * store. After an insert the store is trimmed to max_bytes by removing the
+ * entries used least recently; a hit refreshes the entry's mtime.
+ */
+
+#define RESULTS_MAGIC "CSRS"
+
+typedef struct
+{
+    uint64_t trace_hash;
+    uint64_t accesses;      // requested
+    uint32_t version;
+    uint32_t reserved;
+    cachesim_config config;
+}result_key;
+
+typedef struct
+{
+    uint64_t accesses;      // simulated
+    cache_stats stats[CACHESIM_MAX_LEVELS];
+}result_value;
+
+// hash of the first records of trace; -1 if it cannot be read
+int results_trace_hash(const char*,const char*,uint64_t,uint64_t*);
+
+// 0 and the stored value on a hit, -1 otherwise
+int results_lookup(const char*,const result_key*,result_value*);
+
+// store value and trim the store to max_bytes (0 for no limit); -1 on failure
+int results_store(const char*,const result_key*,const result_value*,uint64_t);
+
+#endif
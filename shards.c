@@ -0,0 +1,451 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "shards.h"
+
+#define SHARDS_P_BITS 24
+#define SHARDS_P (1u << SHARDS_P_BITS)
+
+/*
+ * treap node: one tracked line keyed by the time of its last sampled use,
+ * with subtree sizes so the stack distance is a rank query
+ */
+typedef struct
+{
+    uint64_t time;
+    uint32_t prio;
+    int left, right;
+    unsigned size;
+}treap_node;
+
+typedef struct
+{
+    uint64_t line;          // line address + 1, 0 marks an empty slot
+    uint64_t time;
+}map_slot;
+
+typedef struct
+{
+    uint32_t hash;
+    uint64_t line;
+}heap_entry;
+
+struct shards
+{
+    unsigned line_bits;
+    unsigned bucket_lines;
+    unsigned n_buckets;
+    unsigned max_lines;     // 0 for fixed rate
+    uint32_t threshold;     // sample when hash < threshold, rate = threshold/P
+    uint64_t now;
+
+    treap_node* nodes;
+    int root;
+    int free_node;
+    unsigned n_nodes;
+    unsigned cap_nodes;
+    uint32_t rng;
+
+    map_slot* map;
+    size_t map_mask;
+    size_t tracked;
+
+    heap_entry* heap;       // max-heap on hash, fixed size only
+
+    double* hist;           // weighted references per scaled distance bucket, last is beyond
+    double total;
+    int failed;             // memory ran out, later references are ignored
+};
+
+static inline uint64_t
+mix64(uint64_t x)
+{
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ull;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebull;
+    x ^= x >> 31;
+    return x;
+}
+
+/********************************* treap ***************************************/
+
+static inline unsigned
+node_size(const shards* s,int n)
+{
+    return n < 0 ? 0 : s->nodes[n].size;
+}
+
+static inline void
+node_update(shards* s,int n)
+{
+    s->nodes[n].size = 1 + node_size(s,s->nodes[n].left) + node_size(s,s->nodes[n].right);
+}
+
+// split n into keys <= time and keys > time
+static void
+treap_split(shards* s,int n,uint64_t time,int* le,int* gt)
+{
+    if(n < 0)
+    {
+        *le = *gt = -1;
+        return;
+    }
+    if(s->nodes[n].time <= time)
+    {
+        treap_split(s,s->nodes[n].right,time,&s->nodes[n].right,gt);
+        *le = n;
+    }
+    else
+    {
+        treap_split(s,s->nodes[n].left,time,le,&s->nodes[n].left);
+        *gt = n;
+    }
+    node_update(s,n);
+}
+
+static int
+treap_merge(shards* s,int a,int b)
+{
+    if(a < 0)
+        return b;
+    if(b < 0)
+        return a;
+    if(s->nodes[a].prio > s->nodes[b].prio)
+    {
+        s->nodes[a].right = treap_merge(s,s->nodes[a].right,b);
+        node_update(s,a);
+        return a;
+    }
+    s->nodes[b].left = treap_merge(s,a,s->nodes[b].left);
+    node_update(s,b);
+    return b;
+}
+
+static int
+alloc_node(shards* s,uint64_t time)
+{
+    int n;
+    if(s->free_node >= 0)
+    {
+        n = s->free_node;
+        s->free_node = s->nodes[n].left;
+    }
+    else
+        n = s->n_nodes++;   // reserve() made room
+    s->rng = s->rng*1664525u + 1013904223u;
+    s->nodes[n].time = time;
+    s->nodes[n].prio = s->rng;
+    s->nodes[n].left = s->nodes[n].right = -1;
+    s->nodes[n].size = 1;
+    return n;
+}
+
+// the newest time is always the largest key, so inserting is a merge
+static void
+treap_push(shards* s,uint64_t time)
+{
+    s->root = treap_merge(s,s->root,alloc_node(s,time));
+}
+
+// remove time and return how many keys were newer than it
+static unsigned
+treap_remove(shards* s,uint64_t time)
+{
+    int le, gt, lt, eq;
+    treap_split(s,s->root,time,&le,&gt);
+    treap_split(s,le,time - 1,&lt,&eq);
+    unsigned newer = node_size(s,gt);
+    if(eq >= 0)
+    {
+        s->nodes[eq].left = s->free_node;
+        s->free_node = eq;
+    }
+    s->root = treap_merge(s,lt,gt);
+    return newer;
+}
+
+/******************************** line map *************************************/
+
+static map_slot*
+map_find(const shards* s,uint64_t line)
+{
+    size_t i = mix64(line) & s->map_mask;
+    while(s->map[i].line)
+    {
+        if(s->map[i].line == line + 1)
+            return &s->map[i];
+        i = (i + 1) & s->map_mask;
+    }
+    return NULL;
+}
+
+static void
+map_insert(shards* s,uint64_t line,uint64_t time)
+{
+    size_t i = mix64(line) & s->map_mask;
+    while(s->map[i].line)
+        i = (i + 1) & s->map_mask;
+    s->map[i].line = line + 1;
+    s->map[i].time = time;
+    ++s->tracked;
+}
+
+static int
+map_grow(shards* s)
+{
+    map_slot* old = s->map;
+    size_t old_size = s->map_mask + 1;
+    map_slot* map = calloc(2*old_size,sizeof(map_slot));
+    if(!map)
+        return -1;
+    s->map = map;
+    s->map_mask = 2*old_size - 1;
+    s->tracked = 0;
+    for(size_t i = 0;i < old_size;++i)
+        if(old[i].line)
+            map_insert(s,old[i].line - 1,old[i].time);
+    free(old);
+    return 0;
+}
+
+/*
+ * room for one more tracked line in the treap and the map, so a reference
+ * either fails up front or updates everything
+ */
+static int
+reserve(shards* s)
+{
+    if(s->free_node < 0 && s->n_nodes == s->cap_nodes)
+    {
+        treap_node* nodes = realloc(s->nodes,2*s->cap_nodes*sizeof(treap_node));
+        if(!nodes)
+            return -1;
+        s->nodes = nodes;
+        s->cap_nodes *= 2;
+    }
+    if(2*(s->tracked + 1) > s->map_mask + 1)
+        return map_grow(s);
+    return 0;
+}
+
+// linear probing delete with backward shift, keeps probe chains intact
+static void
+map_erase(shards* s,map_slot* slot)
+{
+    size_t i = slot - s->map;
+    size_t j = i;
+    for(;;)
+    {
+        j = (j + 1) & s->map_mask;
+        if(!s->map[j].line)
+            break;
+        size_t home = mix64(s->map[j].line - 1) & s->map_mask;
+        if(((j - home) & s->map_mask) >= ((j - i) & s->map_mask))
+        {
+            s->map[i] = s->map[j];
+            i = j;
+        }
+    }
+    s->map[i].line = 0;
+    --s->tracked;
+}
+
+/******************************** hash heap ************************************/
+
+static void
+heap_push(shards* s,uint32_t hash,uint64_t line)
+{
+    size_t i = s->tracked - 1;
+    while(i && s->heap[(i - 1)/2].hash < hash)
+    {
+        s->heap[i] = s->heap[(i - 1)/2];
+        i = (i - 1)/2;
+    }
+    s->heap[i].hash = hash;
+    s->heap[i].line = line;
+}
+
+static heap_entry
+heap_pop(shards* s,size_t n)
+{
+    heap_entry top = s->heap[0];
+    heap_entry last = s->heap[n - 1];
+    size_t i = 0;
+    for(;;)
+    {
+        size_t c = 2*i + 1;
+        if(c >= n - 1)
+            break;
+        if(c + 1 < n - 1 && s->heap[c + 1].hash > s->heap[c].hash)
+            ++c;
+        if(s->heap[c].hash <= last.hash)
+            break;
+        s->heap[i] = s->heap[c];
+        i = c;
+    }
+    s->heap[i] = last;
+    return top;
+}
+
+/*
+ * lower the threshold to the largest tracked hash and drop every line at
+ * or above it until the tracked set fits again
+ */
+static void
+shards_shrink(shards* s)
+{
+    while(s->tracked > s->max_lines)
+    {
+        s->threshold = s->heap[0].hash;
+        while(s->tracked && s->heap[0].hash >= s->threshold)
+        {
+            heap_entry e = heap_pop(s,s->tracked);
+            map_slot* slot = map_find(s,e.line);
+            treap_remove(s,slot->time);
+            map_erase(s,slot);
+        }
+    }
+}
+
+/********************************** api ****************************************/
+
+static shards*
+shards_create(uint32_t threshold,unsigned max_lines,unsigned line_bits,unsigned bucket_lines,unsigned n_buckets)
+{
+    shards* s = calloc(1,sizeof(shards));
+    if(!s)
+        return NULL;
+    s->line_bits = line_bits;
+    s->bucket_lines = bucket_lines ? bucket_lines : 1;
+    s->n_buckets = n_buckets ? n_buckets : 1;
+    s->max_lines = max_lines;
+    s->threshold = threshold;
+    s->root = -1;
+    s->free_node = -1;
+    s->cap_nodes = 1024;
+    s->nodes = malloc(s->cap_nodes*sizeof(treap_node));
+    s->rng = 12345;
+    s->map_mask = 1023;
+    s->map = calloc(s->map_mask + 1,sizeof(map_slot));
+    if(max_lines)
+        s->heap = malloc((max_lines + 1)*sizeof(heap_entry));
+    s->hist = calloc(s->n_buckets + 1,sizeof(double));
+    if(!s->nodes || !s->map || !s->hist || (max_lines && !s->heap))
+    {
+        shards_destroy(s);
+        return NULL;
+    }
+    return s;
+}
+
+shards*
+shards_create_fixed_rate(double rate,unsigned line_bits,unsigned bucket_lines,unsigned n_buckets)
+{
+    if(rate <= 0 || rate > 1)
+        return NULL;
+    return shards_create(rate*SHARDS_P,0,line_bits,bucket_lines,n_buckets);
+}
+
+shards*
+shards_create_fixed_size(unsigned max_lines,unsigned line_bits,unsigned bucket_lines,unsigned n_buckets)
+{
+    if(!max_lines)
+        return NULL;
+    return shards_create(SHARDS_P,max_lines,line_bits,bucket_lines,n_buckets);
+}
+
+void
+shards_destroy(shards* s)
+{
+    if(!s)
+        return;
+    free(s->nodes);
+    free(s->map);
+    free(s->heap);
+    free(s->hist);
+    free(s);
+}
+
+void
+shards_access(shards* s,uint32_t address)
+{
+    uint64_t line = address >> s->line_bits;
+    uint32_t hash = mix64(line) & (SHARDS_P - 1);
+    if(hash >= s->threshold || s->failed)
+        return;
+    map_slot* slot = map_find(s,line);
+    if(!slot && reserve(s))
+    {
+        s->failed = 1;
+        return;
+    }
+
+    double rate = (double)s->threshold/SHARDS_P;
+    double weight = 1/rate;
+    s->total += weight;
+
+    uint64_t now = ++s->now;
+    if(slot)
+    {
+        // lines used since the last reference, plus the line itself, scaled to the full trace
+        unsigned newer = treap_remove(s,slot->time);
+        uint64_t distance = (newer + 1)*weight;
+        uint64_t bucket = (distance + s->bucket_lines - 1)/s->bucket_lines;
+        s->hist[bucket && bucket <= s->n_buckets ? bucket - 1 : s->n_buckets] += weight;
+        slot->time = now;
+        treap_push(s,now);
+        return;
+    }
+
+    // cold reference: misses at every size
+    s->hist[s->n_buckets] += weight;
+    treap_push(s,now);
+    map_insert(s,line,now);
+    if(s->max_lines)
+    {
+        heap_push(s,hash,line);
+        shards_shrink(s);
+    }
+}
+
+size_t
+shards_mrc(const shards* s,double* miss_ratio,size_t n)
+{
+    if(n > s->n_buckets)
+        n = s->n_buckets;
+    double hits = 0;
+    for(size_t i = 0;i < n;++i)
+    {
+        hits += s->hist[i];
+        miss_ratio[i] = s->total > 0 ? 1 - hits/s->total : 0;
+        if(miss_ratio[i] < 0)
+            miss_ratio[i] = 0;
+    }
+    return n;
+}
+
+double
+shards_rate(const shards* s)
+{
+    return (double)s->threshold/SHARDS_P;
+}
+
+size_t
+shards_tracked(const shards* s)
+{
+    return s->tracked;
+}
+
+unsigned
+shards_bucket_lines(const shards* s)
+{
+    return s->bucket_lines;
+}
+
+int
+shards_failed(const shards* s)
+{
+    return s->failed;
+}
@@ -0,0 +1,40 @@
+#ifndef SHARDS_H
+#define SHARDS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * SHARDS: spatially hashed sampling for approximate LRU miss-ratio curves.
+ *
+ * A line is tracked only if its hashed address falls below a threshold, so
+ * the LRU stack holds a fraction R of the footprint. Stack distances of the
+ * sampled references are scaled by 1/R into a fixed histogram that gives
+ * the miss ratio of every fully associative LRU size at once.
+ *
+ * fixed rate: R stays constant, memory is R times the footprint
+ * fixed size: at most max_lines lines are tracked; R drops whenever the
+ *             set overflows, evicting the lines with the largest hashes,
+ *             so memory stays constant
+ * A fixed rate of 1.0 samples everything and is exact stack distance
+ * analysis.
+ */
+
+typedef struct shards shards;
+
+shards* shards_create_fixed_rate(double,unsigned,unsigned,unsigned);
+shards* shards_create_fixed_size(unsigned,unsigned,unsigned,unsigned);
+void shards_destroy(shards*);
+void shards_access(shards*,uint32_t);
+
+// miss ratio at cache sizes of (i+1)*bucket_lines lines for i < n
+size_t shards_mrc(const shards*,double*,size_t);
+
+double shards_rate(const shards*);
+size_t shards_tracked(const shards*);
+unsigned shards_bucket_lines(const shards*);
+
+// nonzero once memory ran out; the curve then covers the references before
+int shards_failed(const shards*);
+
+#endif
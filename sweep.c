@@ -0,0 +1,162 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <stdint.h>
+#include <getopt.h>
+
+#include "cachesim.h"
+#include "allassoc.h"
+
+/********************************* CLI INPUTS **********************************
+ *
+ * sweep [options] benchmark accesses
+ *
+ * Prints the LRU hits and misses of every single-level cache with a
+ * power-of-two set count in the range and 1 to max ways ways, from one pass
+ * over the trace, as CSV of cache bytes, sets, ways, hits, misses and miss
+ * ratio. Only reads and writes are accesses, as in Cache.Grp1.
+ *
+ * --line=B         line size in bytes (default 64)
+ * --sets=MIN:MAX   set counts, powers of two (default 1:16384)
+ * --ways=W         most ways (default 16)
+ * --validate       also simulate every combination with the cache model
+ *                  and report those whose hits differ; expect one hit
+ *                  less in the model where the line of the first access,
+ *                  stamped at time 0 like an empty way, is evicted early
+ *
+ * *****************************************************************************
+*/
+
+#define TRACE_BLOCK 4096
+
+int
+main(int argc, char *argv[])
+{
+    static const struct option long_options[] =
+    {
+        {"line", required_argument, NULL, 'l'},
+        {"sets", required_argument, NULL, 's'},
+        {"ways", required_argument, NULL, 'w'},
+        {"validate", no_argument, NULL, 'v'},
+        {NULL, 0, NULL, 0}
+    };
+    unsigned line_size = 64, min_sets = 1, max_sets = 16384, max_ways = 16;
+    int validate = 0;
+    int opt;
+    while((opt = getopt_long(argc,argv,"",long_options,NULL)) != -1)
+    {
+        switch(opt)
+        {
+            case('l'):
+                line_size = atoi(optarg);
+                break;
+            case('s'):
+                if(sscanf(optarg,"%u:%u",&min_sets,&max_sets) != 2)
+                {
+                    printf("Invalid arguments!");
+                    exit(0);
+                }
+                break;
+            case('w'):
+                max_ways = atoi(optarg);
+                break;
+            case('v'):
+                validate = 1;
+                break;
+            default:
+                printf("Invalid arguments!");
+                exit(0);
+        }
+    }
+    if(argc - optind < 2 || !line_size || (line_size & (line_size - 1)) || !min_sets || (min_sets & (min_sets - 1)) ||
+       !max_sets || (max_sets & (max_sets - 1)))
+    {
+        printf("Invalid arguments!");
+        exit(0);
+    }
+
+    char benchmark[512];
+    snprintf(benchmark,sizeof(benchmark),"CacheonlyTraces/Traces/%s.trace",argv[optind]);
+    size_t accesses = strtoull(argv[optind + 1],NULL,0);
+    unsigned line_bits = log2(line_size), min_bits = log2(min_sets), max_bits = log2(max_sets);
+
+    all_assoc* sweep = all_assoc_create(line_bits,min_bits,max_bits,max_ways);
+    if(!sweep)
+    {
+        printf("Invalid sweep parameters\n");
+        exit(0);
+    }
+
+    FILE* fin = fopen(benchmark,"rb");
+    if(fin == 0) { printf("Unable to open trace file\n"); exit(0); }
+
+    unsigned char* block = malloc(TRACE_BLOCK*CACHESIM_RECORD_SIZE);
+    if(!block) { printf("Unable to allocate trace buffer\n"); exit(0); }
+    size_t left = accesses;
+    while(left)
+    {
+        size_t want = left < TRACE_BLOCK ? left : TRACE_BLOCK;
+        size_t got = fread(block,CACHESIM_RECORD_SIZE,want,fin);
+        for(size_t i = 0;i < got;++i)
+        {
+            const unsigned char* record = block + i*CACHESIM_RECORD_SIZE;
+            uint32_t address;
+            memcpy(&address,record,4);
+            if(record[4] == 'r' || record[4] == 'w')
+                all_assoc_access(sweep,address);
+        }
+        left -= got;
+        if(got < want)
+            break;
+    }
+
+    uint64_t total = all_assoc_accesses(sweep);
+    printf("# %s: %zu records, %llu accesses, %u byte lines\n",benchmark,accesses - left,
+            (unsigned long long)total,line_size);
+    printf("size_bytes,sets,ways,hits,misses,miss_ratio\n");
+    unsigned mismatches = 0;
+    for(unsigned bits = min_bits;bits <= max_bits;++bits)
+    {
+        for(unsigned ways = 1;ways <= max_ways;++ways)
+        {
+            unsigned long long sets = 1ull << bits;
+            uint64_t hits = all_assoc_hits(sweep,bits,ways);
+            printf("%llu,%llu,%u,%llu,%llu,%.6f\n",sets*ways*line_size,sets,ways,(unsigned long long)hits,
+                    (unsigned long long)(total - hits),total ? (double)(total - hits)/total : 0);
+            if(!validate)
+                continue;
+            //the model replays the same records from the start
+            cachesim_config config = {1, {{sets*ways*line_size, ways, line_size, 0, CACHESIM_INDEX_BITS}}};
+            cachesim* sim = cachesim_create(&config);
+            if(!sim)
+                continue;
+            rewind(fin);
+            size_t remaining = accesses - left;
+            while(remaining)
+            {
+                size_t got = fread(block,CACHESIM_RECORD_SIZE,remaining < TRACE_BLOCK ? remaining : TRACE_BLOCK,fin);
+                if(!got)
+                    break;
+                cachesim_run_trace(sim,block,got);
+                remaining -= got;
+            }
+            cache_stats stats;
+            cachesim_get_stats(sim,0,&stats);
+            if(stats.hits != hits)
+            {
+                printf("# mismatch: %llu sets, %u ways: model %zd hits (%+lld)\n",sets,ways,stats.hits,
+                        (long long)stats.hits - (long long)hits);
+                ++mismatches;
+            }
+            cachesim_destroy(sim);
+        }
+    }
+    if(validate)
+        printf("# validation: %u of %u configurations differ from the cache model\n",mismatches,
+                (max_bits - min_bits + 1)*max_ways);
+    free(block);
+    fclose(fin);
+    all_assoc_destroy(sweep);
+    return 0;
+}
@@ -3,3 +3,25 @@
 ./Cache.Grp1 gcc 10000000 16384 2 64 0 524288 8 64 0
 ./Cache.Grp1 ammp 10000000 16384 1 64 0 524288 8 64 0
 ./Cache.Grp1 perlbmk 10000000 16384 2 64 0 524288 8 64 2048
+
+# SHARDS miss-ratio curves checked against fully associative LRU simulation
+./mrc --validate --rate=0.01 gcc 10000000 | tail -1
+./mrc --validate --rate=0.01 ammp 10000000 | tail -1
+./mrc --validate --size=8192 perlbmk 10000000 | tail -1
+
+# configuration search: Pareto front of capacity against global miss ratio
+./tune --max-capacity=1200000 --target-miss=0.25 gcc 1000000 | grep ",1$"
+
+# LRU hits of every set count and associativity from one pass
+./sweep --ways=16 gcc 10000000 | grep "^524288,"
+
+# miss events: reads leave lines clean, so evictions split into evict and writeback
+./Cache.Grp1 --events=events.bin gcc 1000000 16384 2 64 0 524288 8 64 0 | grep "event log"
+./event_dump -t evict events.bin | tail -n +2 | wc -l
+./event_dump -t writeback events.bin | tail -n +2 | wc -l
+
+# DRAM behind L2 with XOR bank mapping
+./Cache.Grp1 --dram --dram-mapping=xor gcc 10000000 16384 2 64 0 524288 8 64 0 | grep DRAM
+
+# dead-block prediction bypassing predicted no-reuse L2 fills
+./Cache.Grp1 --deadblock=bypass gcc 10000000 16384 2 64 0 524288 8 64 0 | grep dead-block
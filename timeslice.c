@@ -0,0 +1,205 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <pthread.h>
+
+#include "cache.h"
+
+/*
+ * Time-sliced parallel simulation of one trace range.
+ *
+ * The range is cut into K contiguous slices simulated in parallel, each on
+ * its own hierarchy. Slice 0 continues from the caller's state and is
+ * exact; every later slice starts cold, is warmed on the `warmup` records
+ * before it with statistics discarded, and then counts its own records.
+ * Each hierarchy runs on the global access clock so LRU timestamps are the
+ * ones the serial run would produce.
+ *
+ * Exact mode then fixes up the slice boundaries: every slice whose
+ * predecessor's end state changed is re-simulated from that end state, in
+ * parallel, until no end state changes. A slice started from the exact end
+ * state of its predecessor is exact, so this reaches the serial result;
+ * since cache state usually converges within a slice, it typically takes
+ * one fix-up round.
+ */
+
+typedef struct
+{
+    cachesim* work;         // state while the slice runs, its end state afterwards
+    cachesim* end;          // end state from the previous round
+    const unsigned char* records;
+    size_t warmup;          // records before the slice used only for warmup
+    size_t n;
+    ssize_t clock;          // clock of the first record simulated
+    int from_start;         // work already holds the exact start state
+    cache_stats stats[CACHESIM_MAX_LEVELS];
+    cache_stats fa_stats[CACHESIM_MAX_LEVELS];
+}slice_job;
+
+static void*
+run_slice(void* arg)
+{
+    slice_job* job = arg;
+    cachesim* sim = job->work;
+    if(!job->from_start)
+    {
+        cachesim_reset(sim);
+        sim->clock = job->clock;
+        cachesim_run_trace(sim,job->records - job->warmup*CACHESIM_RECORD_SIZE,job->warmup);
+    }
+    cachesim_clear_stats(sim);
+    cachesim_run_trace(sim,job->records,job->n);
+    for(unsigned l = 0;l < sim->n_levels;++l)
+    {
+        job->stats[l] = sim->levels[l]->stats;
+        job->fa_stats[l] = sim->fa[l]->stats;
+    }
+    return NULL;
+}
+
+static void
+add_stats(cache_stats* into,const cache_stats* from)
+{
+    into->total_accesses += from->total_accesses;
+    into->hits += from->hits;
+    into->total_misses += from->total_misses;
+    into->cold_misses += from->cold_misses;
+    into->capacity_misses += from->capacity_misses;
+    into->conflict_misses += from->conflict_misses;
+}
+
+// a slice whose thread can not be started runs on the calling thread instead
+static void
+run_round(slice_job* jobs,const int* run,unsigned k,pthread_t* threads,int* started)
+{
+    for(unsigned s = 1;s < k;++s)
+        started[s] = run[s] && !pthread_create(&threads[s],NULL,run_slice,&jobs[s]);
+    for(unsigned s = 0;s < k;++s)
+        if(run[s] && (!s || !started[s]))
+            run_slice(&jobs[s]);
+    for(unsigned s = 1;s < k;++s)
+        if(started[s])
+            pthread_join(threads[s],NULL);
+}
+
+int
+cachesim_run_sliced(cachesim* sim,const unsigned char* records,size_t n,const cachesim_slice_config* config,cachesim_slice_report* report)
+{
+    unsigned k = config->slices;
+    // the private hierarchies of the slices are not partitioned or logged
+    if(!k || sim->part || sim->log || sim->dram || sim->dead)
+        return -1;
+    if(k > n)
+        k = n ? n : 1;
+
+    slice_job* jobs = calloc(k,sizeof(slice_job));
+    int* run = calloc(k,sizeof(int));
+    int* changed = calloc(k,sizeof(int));
+    int* started = calloc(k,sizeof(int));
+    pthread_t* threads = malloc(k*sizeof(pthread_t));
+    int err = 0;
+    if(!jobs || !run || !changed || !started || !threads)
+    {
+        err = -1;
+        goto out;
+    }
+    size_t per_slice = n/k;
+    for(unsigned s = 0;s < k;++s)
+    {
+        size_t first = s*per_slice;
+        jobs[s].records = records + first*CACHESIM_RECORD_SIZE;
+        jobs[s].n = s + 1 < k ? per_slice : n - first;
+        jobs[s].warmup = config->warmup < first ? config->warmup : first;
+        jobs[s].clock = sim->clock + first - jobs[s].warmup;
+        jobs[s].work = cachesim_create(&sim->config);
+        jobs[s].end = config->exact ? cachesim_create(&sim->config) : NULL;
+        if(!jobs[s].work || (config->exact && !jobs[s].end))
+            err = -1;
+        run[s] = 1;
+    }
+    if(err)
+        goto out;
+
+    // slice 0 picks up exactly where the caller's hierarchy is
+    cachesim_copy_state(jobs[0].work,sim);
+    jobs[0].from_start = 1;
+
+    memset(report,0,sizeof(cachesim_slice_report));
+    for(;;)
+    {
+        run_round(jobs,run,k,threads,started);
+        ++report->rounds;
+        for(unsigned s = 0;s < k;++s)
+            if(run[s])
+                report->simulated += jobs[s].n + (jobs[s].from_start ? 0 : jobs[s].warmup);
+        if(!config->exact)
+            break;
+
+        // which end states moved since the previous round
+        int any = 0;
+        for(unsigned s = 0;s < k;++s)
+        {
+            changed[s] = run[s] && ((report->rounds == 1) || !cachesim_state_equal(jobs[s].work,jobs[s].end));
+            if(run[s])
+                cachesim_copy_state(jobs[s].end,jobs[s].work);
+        }
+        for(unsigned s = 1;s < k;++s)
+        {
+            run[s] = changed[s - 1];
+            any |= run[s];
+        }
+        run[0] = 0;
+        if(!any)
+        {
+            report->exact = 1;
+            break;
+        }
+        if(config->max_rounds && report->rounds >= config->max_rounds)
+            break;
+        // restart from the predecessor's end state as it was at the end of the round
+        for(unsigned s = 1;s < k;++s)
+        {
+            if(!run[s])
+                continue;
+            cachesim_copy_state(jobs[s].work,jobs[s - 1].end);
+            jobs[s].from_start = 1;
+        }
+    }
+    if(k == 1)
+        report->exact = 1;
+
+    // merged stats on top of the caller's, end state of the last slice
+    cache_stats stats[CACHESIM_MAX_LEVELS], fa_stats[CACHESIM_MAX_LEVELS];
+    for(unsigned l = 0;l < sim->n_levels;++l)
+    {
+        stats[l] = sim->levels[l]->stats;
+        fa_stats[l] = sim->fa[l]->stats;
+        for(unsigned s = 0;s < k;++s)
+        {
+            add_stats(&stats[l],&jobs[s].stats[l]);
+            add_stats(&fa_stats[l],&jobs[s].fa_stats[l]);
+        }
+    }
+    cachesim_copy_state(sim,jobs[k - 1].work);
+    for(unsigned l = 0;l < sim->n_levels;++l)
+    {
+        sim->levels[l]->stats = stats[l];
+        sim->fa[l]->stats = fa_stats[l];
+    }
+
+out:
+    if(jobs)
+    {
+        for(unsigned s = 0;s < k;++s)
+        {
+            cachesim_destroy(jobs[s].work);
+            cachesim_destroy(jobs[s].end);
+        }
+    }
+    free(jobs);
+    free(run);
+    free(changed);
+    free(started);
+    free(threads);
+    return err;
+}
@@ -0,0 +1,221 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "cache.h"
+
+/*
+ * Event-driven timing layer.
+ *
+ * The functional model decides where each access hits; this layer only
+ * decides when. Every level keeps a file of MSHRs, each holding the line of
+ * an outstanding miss and the cycle its data returns. An access walks the
+ * levels it missed in, waiting for a free MSHR where none is left, and
+ * completes after the hit latency of the level that served it or the
+ * memory latency, plus the miss penalty of every level above. Entries
+ * retire implicitly once their completion cycle has passed, so the event
+ * queue is the MSHR files themselves.
+ *
+ * The functional model fills lines at once, so an access to a line whose
+ * miss is still outstanding looks like a hit; it is timed as a secondary
+ * miss that completes with the primary. Overlapping misses are what the
+ * model rewards: stall cycles only accrue when MSHRs or the read window
+ * run out, not per miss.
+ *
+ * With timing disabled nothing here runs, so the functional path is
+ * unchanged.
+ */
+
+typedef struct
+{
+    uint64_t line;
+    uint64_t done;          // cycle the data returns, free once passed
+}mshr_entry;
+
+struct cachesim_timing
+{
+    unsigned n_levels;
+    cachesim_timing_config config;
+    unsigned line_bits[CACHESIM_MAX_LEVELS];
+    mshr_entry* mshr[CACHESIM_MAX_LEVELS];
+
+    uint64_t next_issue;    // earliest cycle the next access may issue
+    uint64_t* retire;       // completion cycles of the last `window` reads
+    uint64_t reads;
+    uint64_t last_done;
+
+    uint64_t busy_until;    // end of the current span with misses outstanding
+    uint64_t miss_latency;  // summed latency of L1 misses
+    cachesim_timing_stats stats;
+};
+
+cachesim_timing*
+cachesim_timing_create(const cachesim* sim,const cachesim_timing_config* config)
+{
+    cachesim_timing* t = calloc(1,sizeof(cachesim_timing));
+    if(!t)
+        return NULL;
+    t->n_levels = sim->n_levels;
+    t->config = *config;
+    if(!t->config.issue_interval)
+        t->config.issue_interval = 1;
+    for(unsigned l = 0;l < t->n_levels;++l)
+    {
+        if(!t->config.mshrs[l])
+            t->config.mshrs[l] = 1;
+        t->line_bits[l] = sim->geom[l].g.block_offset_bits;
+        t->mshr[l] = calloc(t->config.mshrs[l],sizeof(mshr_entry));
+        if(!t->mshr[l])
+        {
+            cachesim_timing_destroy(t);
+            return NULL;
+        }
+    }
+    if(t->config.window && !(t->retire = calloc(t->config.window,sizeof(uint64_t))))
+    {
+        cachesim_timing_destroy(t);
+        return NULL;
+    }
+    return t;
+}
+
+void
+cachesim_timing_destroy(cachesim_timing* t)
+{
+    if(!t)
+        return;
+    for(unsigned l = 0;l < t->n_levels;++l)
+        free(t->mshr[l]);
+    free(t->retire);
+    free(t);
+}
+
+// outstanding miss on line at cycle now, or NULL
+static inline const mshr_entry*
+mshr_pending(const cachesim_timing* t,unsigned l,uint64_t line,uint64_t now)
+{
+    for(unsigned i = 0;i < t->config.mshrs[l];++i)
+        if(t->mshr[l][i].done > now && t->mshr[l][i].line == line)
+            return &t->mshr[l][i];
+    return NULL;
+}
+
+// the entry that frees first; free at now if its done has passed
+static inline mshr_entry*
+mshr_earliest(cachesim_timing* t,unsigned l)
+{
+    mshr_entry* e = &t->mshr[l][0];
+    for(unsigned i = 1;i < t->config.mshrs[l];++i)
+        if(t->mshr[l][i].done < e->done)
+            e = &t->mshr[l][i];
+    return e;
+}
+
+void
+cachesim_timing_access(cachesim_timing* t,uint32_t address,char op,unsigned level)
+{
+    const cachesim_timing_config* c = &t->config;
+    if((op != 'r') && (op != 'w'))
+        return;
+
+    uint64_t issue = t->next_issue;
+    if(t->retire && t->retire[t->reads % c->window] > issue)
+        issue = t->retire[t->reads % c->window];
+
+    mshr_entry* alloc[CACHESIM_MAX_LEVELS];
+    unsigned n_alloc = 0;
+    uint64_t time = issue;
+    for(unsigned l = 0;;++l)
+    {
+        if(l == t->n_levels)
+        {
+            time += c->memory_latency;
+            break;
+        }
+        uint64_t line = address >> t->line_bits[l];
+        const mshr_entry* pending = mshr_pending(t,l,line,time);
+        if(pending)
+        {
+            // secondary miss: the data arrives with the primary
+            time += c->hit_latency[l];
+            if(pending->done > time)
+                time = pending->done;
+            ++t->stats.merged;
+            break;
+        }
+        if(l == level)
+        {
+            time += c->hit_latency[l];
+            break;
+        }
+        mshr_entry* e = mshr_earliest(t,l);
+        if(e->done > time)
+        {
+            ++t->stats.mshr_full[l];
+            time = e->done;
+            // no L1 MSHR: the access cannot leave the core until one frees
+            if(!l)
+                issue = time;
+        }
+        e->line = line;
+        alloc[n_alloc++] = e;
+        time += c->miss_penalty[l];
+    }
+    for(unsigned i = 0;i < n_alloc;++i)
+        alloc[i]->done = time;
+
+    if(n_alloc)
+    {
+        // union of the spans with an L1 miss outstanding; issues are in order
+        ++t->stats.misses;
+        t->miss_latency += time - issue;
+        if(issue >= t->busy_until)
+            t->stats.miss_cycles += time - issue;
+        else if(time > t->busy_until)
+            t->stats.miss_cycles += time - t->busy_until;
+        if(time > t->busy_until)
+            t->busy_until = time;
+    }
+
+    if(op == 'r' && t->retire)
+    {
+        // reads retire in order
+        uint64_t prev = t->retire[(t->reads + c->window - 1) % c->window];
+        t->retire[t->reads % c->window] = time > prev ? time : prev;
+        ++t->reads;
+    }
+    ++t->stats.accesses;
+    t->stats.latency += time - issue;
+    t->next_issue = issue + c->issue_interval;
+    if(time > t->last_done)
+        t->last_done = time;
+}
+
+size_t
+cachesim_run_trace_timed(cachesim* sim,cachesim_timing* t,const unsigned char* records,size_t n)
+{
+    uint32_t addresses[TRACE_BATCH];
+    char ops[TRACE_BATCH];
+    unsigned char levels[TRACE_BATCH];
+    for(size_t i = 0;i < n;i += TRACE_BATCH)
+    {
+        size_t batch = n - i < TRACE_BATCH ? n - i : TRACE_BATCH;
+        for(size_t k = 0;k < batch;++k)
+            decode_record(records + (i + k)*CACHESIM_RECORD_SIZE,&addresses[k],&ops[k]);
+        cachesim_access_batch(sim,addresses,ops,batch,levels);
+        for(size_t k = 0;k < batch;++k)
+            cachesim_timing_access(t,addresses[k],ops[k],levels[k]);
+    }
+    return n;
+}
+
+void
+cachesim_timing_get_stats(const cachesim_timing* t,cachesim_timing_stats* stats)
+{
+    *stats = t->stats;
+    stats->cycles = t->last_done > t->next_issue ? t->last_done : t->next_issue;
+    uint64_t ideal = stats->accesses*t->config.issue_interval;
+    stats->stall_cycles = stats->cycles > ideal ? stats->cycles - ideal : 0;
+    stats->amat = stats->accesses ? (double)stats->latency/stats->accesses : 0;
+    stats->mlp = stats->miss_cycles ? (double)t->miss_latency/stats->miss_cycles : 0;
+}
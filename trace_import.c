@@ -0,0 +1,111 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <getopt.h>
+
+#include "cachesim.h"
+#include "import.h"
+
+/********************************* CLI INPUTS **********************************
+ *
+ * trace_import [options] input output
+ *
+ * Converts a trace to the native 5 byte records Cache.Grp1 reads from
+ * CacheonlyTraces/Traces/<benchmark>.trace. Either path may be - for
+ * standard input or output, e.g. xz -dc t.champsimtrace.xz | trace_import
+ * --format=champsim - t.trace
+ *
+ * --format=F       din, lackey, champsim, hex or native (default by the
+ *                  input extension: .din, .lackey, .champsim[trace],
+ *                  .hex/.txt, anything else native)
+ * --ifetch         keep instruction fetches as reads
+ * --limit=N        stop after N records
+ *
+ * *****************************************************************************
+*/
+
+#define CONVERT_BLOCK 65536
+
+int
+main(int argc, char *argv[])
+{
+    static const struct option long_options[] =
+    {
+        {"format", required_argument, NULL, 'f'},
+        {"ifetch", no_argument, NULL, 'i'},
+        {"limit", required_argument, NULL, 'l'},
+        {NULL, 0, NULL, 0}
+    };
+    int format = -1, ifetch = 0;
+    uint64_t limit = UINT64_MAX;
+    int opt;
+    while((opt = getopt_long(argc,argv,"",long_options,NULL)) != -1)
+    {
+        switch(opt)
+        {
+            case('f'):
+                format = trace_format_parse(optarg);
+                if(format < 0)
+                {
+                    fprintf(stderr,"Invalid arguments!");
+                    exit(0);
+                }
+                break;
+            case('i'):
+                ifetch = 1;
+                break;
+            case('l'):
+                limit = strtoull(optarg,NULL,0);
+                break;
+            default:
+                fprintf(stderr,"Invalid arguments!");
+                exit(0);
+        }
+    }
+    if(argc - optind < 2)
+    {
+        fprintf(stderr,"Invalid arguments!");
+        exit(0);
+    }
+    const char* input = argv[optind];
+    const char* output = argv[optind + 1];
+    if(format < 0)
+        format = trace_format_guess(input);
+
+    trace_reader* reader = trace_reader_open(input,format,ifetch);
+    if(!reader) { fprintf(stderr,"Unable to open trace file\n"); exit(0); }
+    FILE* fout = strcmp(output,"-") ? fopen(output,"wb") : stdout;
+    if(!fout) { fprintf(stderr,"Unable to create %s\n",output); exit(0); }
+
+    // the records are already block sized, stdio buffering would only copy them
+    setvbuf(fout,NULL,_IONBF,0);
+    unsigned char* block = malloc(CONVERT_BLOCK*CACHESIM_RECORD_SIZE);
+    if(!block) { fprintf(stderr,"Unable to allocate trace buffer\n"); exit(0); }
+    uint64_t records = 0;
+    while(records < limit)
+    {
+        size_t want = limit - records < CONVERT_BLOCK ? limit - records : CONVERT_BLOCK;
+        size_t got = trace_reader_read(reader,block,want);
+        if(fwrite(block,CACHESIM_RECORD_SIZE,got,fout) != got)
+        {
+            fprintf(stderr,"Unable to write %s\n",output);
+            exit(0);
+        }
+        records += got;
+        if(got < want)
+            break;
+    }
+    free(block);
+
+    // the summary, like every error, must not end up in a trace written to stdout
+    fprintf(stderr,"%llu records, %llu malformed lines skipped\n",(unsigned long long)records,
+            (unsigned long long)trace_reader_rejected(reader));
+    trace_reader_close(reader);
+    if(fout != stdout && fclose(fout))
+    {
+        fprintf(stderr,"Unable to write %s\n",output);
+        exit(0);
+    }
+    return 0;
+}
@@ -0,0 +1,177 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "trace_index.h"
+
+#define INDEX_BLOCK 4096    // trace records read per fread while building
+
+int
+trace_index_build(const char* path,const char* trace,cachesim* sim,uint64_t interval,uint64_t records)
+{
+    struct stat st;
+    if(!interval || stat(trace,&st))
+        return -1;
+    FILE* fin = fopen(trace,"rb");
+    if(!fin)
+        return -1;
+    char tmp_path[4096];
+    snprintf(tmp_path,sizeof(tmp_path),"%s.%ld.tmp",path,(long)getpid());
+    FILE* out = fopen(tmp_path,"wb");
+    if(!out)
+    {
+        fclose(fin);
+        return -1;
+    }
+
+    trace_index_header header;
+    memset(&header,0,sizeof(header));
+    memcpy(header.magic,TRACE_INDEX_MAGIC,4);
+    header.version = TRACE_INDEX_VERSION;
+    header.trace_size = st.st_size;
+    header.trace_mtime = st.st_mtime;
+    header.interval = interval;
+    header.state_size = cachesim_state_size(sim);
+    cachesim_get_config(sim,&header.config);
+
+    size_t cap = 1024;
+    trace_index_entry* entries = malloc(cap*sizeof(trace_index_entry));
+    unsigned char* state = malloc(header.state_size);
+    unsigned char* block = malloc(INDEX_BLOCK*CACHESIM_RECORD_SIZE);
+    int failed = !entries || !state || !block || fwrite(&header,sizeof(header),1,out) != 1;
+
+    uint64_t record = 0;
+    while(!failed)
+    {
+        if(!(record % interval))
+        {
+            if(header.n_entries == cap)
+            {
+                cap *= 2;
+                trace_index_entry* grown = realloc(entries,cap*sizeof(trace_index_entry));
+                if(!grown)
+                {
+                    failed = 1;
+                    break;
+                }
+                entries = grown;
+            }
+            trace_index_entry* e = &entries[header.n_entries++];
+            e->record = record;
+            e->offset = record*CACHESIM_RECORD_SIZE;
+            e->state = ftello(out);
+            cachesim_save_state(sim,state);
+            if(fwrite(state,header.state_size,1,out) != 1)
+                failed = 1;
+        }
+        if(record == records)
+            break;
+        // stop at the next entry so checkpoints land on exact records
+        uint64_t want = interval - record % interval;
+        if(want > records - record)
+            want = records - record;
+        if(want > INDEX_BLOCK)
+            want = INDEX_BLOCK;
+        size_t got = fread(block,CACHESIM_RECORD_SIZE,want,fin);
+        cachesim_run_trace(sim,block,got);
+        record += got;
+        if(got < want)
+            break;
+    }
+
+    header.entries = ftello(out);
+    if(!failed && (fwrite(entries,sizeof(trace_index_entry),header.n_entries,out) != header.n_entries ||
+       fseeko(out,0,SEEK_SET) || fwrite(&header,sizeof(header),1,out) != 1))
+        failed = 1;
+    if(fclose(out))
+        failed = 1;
+    if(!failed && rename(tmp_path,path))
+        failed = 1;
+    if(failed)
+        unlink(tmp_path);
+    fclose(fin);
+    free(entries);
+    free(state);
+    free(block);
+    return failed ? -1 : 0;
+}
+
+trace_index*
+trace_index_open(const char* path,const char* trace,const cachesim* sim)
+{
+    struct stat st;
+    if(stat(trace,&st))
+        return NULL;
+    int fd = open(path,O_RDONLY);
+    if(fd < 0)
+        return NULL;
+    trace_index* index = calloc(1,sizeof(trace_index));
+    if(!index)
+    {
+        close(fd);
+        return NULL;
+    }
+    trace_index_header* h = &index->header;
+    index->fd = fd;
+    if(pread(fd,h,sizeof(*h),0) != sizeof(*h) || memcmp(h->magic,TRACE_INDEX_MAGIC,4) ||
+       h->version != TRACE_INDEX_VERSION || h->trace_size != st.st_size || h->trace_mtime != st.st_mtime ||
+       !h->interval || !h->n_entries)
+    {
+        trace_index_close(index);
+        return NULL;
+    }
+    index->entries = malloc(h->n_entries*sizeof(trace_index_entry));
+    size_t bytes = h->n_entries*sizeof(trace_index_entry);
+    if(!index->entries || pread(fd,index->entries,bytes,h->entries) != bytes)
+    {
+        trace_index_close(index);
+        return NULL;
+    }
+    cachesim_config config;
+    cachesim_get_config(sim,&config);
+    index->checkpoints = h->state_size && h->state_size == cachesim_state_size(sim) &&
+                         !memcmp(&config,&h->config,sizeof(config));
+    return index;
+}
+
+void
+trace_index_close(trace_index* index)
+{
+    if(!index)
+        return;
+    close(index->fd);
+    free(index->entries);
+    free(index);
+}
+
+int
+trace_index_seek(trace_index* index,uint64_t record,cachesim* sim,uint64_t* start,uint64_t* offset)
+{
+    // entries are every interval records, so the one below is found directly
+    uint64_t i = record/index->header.interval;
+    if(i >= index->header.n_entries)
+        i = index->header.n_entries - 1;
+    const trace_index_entry* e = &index->entries[i];
+
+    if(index->checkpoints && e->state)
+    {
+        void* state = malloc(index->header.state_size);
+        if(state && pread(index->fd,state,index->header.state_size,e->state) == index->header.state_size &&
+           !cachesim_load_state(sim,state,index->header.state_size))
+        {
+            free(state);
+            *start = e->record;
+            *offset = e->offset;
+            return 1;
+        }
+        free(state);
+    }
+    cachesim_reset(sim);
+    *start = record;
+    *offset = record*CACHESIM_RECORD_SIZE;
+    return 0;
+}
@@ -0,0 +1,72 @@
+#ifndef TRACE_INDEX_H
+#define TRACE_INDEX_H
+
+#include <stdint.h>
+
+#include "cachesim.h"
+
+/*
+ * Trace block index: a sidecar file next to a trace that maps every
+ * `interval`-th record to its byte offset and, optionally, to a checkpoint
+ * of the hierarchy state after all earlier records. Starting a simulation
+ * at record N then costs one seek plus at most interval records of
+ * fast-forward from the checkpoint below N, instead of a scan of the
+ * prefix.
+ *
+ * File layout: one trace_index_header, the checkpoint states back to back
+ * (state_size bytes each), then n_entries trace_index_entry. Checkpoints belong to one configuration and one
+ * build; an index whose trace, configuration or state size does not match
+ * is only used for offsets.
+ */
+
+#define TRACE_INDEX_MAGIC "CSIX"
+#define TRACE_INDEX_VERSION 1
+
+typedef struct
+{
+    char magic[4];
+    uint32_t version;
+    uint64_t trace_size;
+    int64_t trace_mtime;
+    uint64_t interval;      // records between entries
+    uint64_t n_entries;
+    uint64_t entries;       // file offset of the entry table
+    uint64_t state_size;    // bytes per checkpoint, 0 for none
+    cachesim_config config; // of the checkpoints
+}trace_index_header;
+
+typedef struct
+{
+    uint64_t record;
+    uint64_t offset;        // byte offset of the record in the trace
+    uint64_t state;         // file offset of its checkpoint, 0 for none
+}trace_index_entry;
+
+typedef struct
+{
+    int fd;
+    trace_index_header header;
+    trace_index_entry* entries;
+    int checkpoints;        // states usable by the hierarchy it was opened for
+}trace_index;
+
+/*
+ * simulate the first `records` records of trace on sim (from its current
+ * state, normally fresh) and write an index of it to path with a
+ * checkpoint of sim every interval records; -1 on I/O failure
+ */
+int trace_index_build(const char*,const char*,cachesim*,uint64_t,uint64_t);
+
+// NULL if path is missing, does not describe trace or memory runs out
+trace_index* trace_index_open(const char*,const char*,const cachesim*);
+void trace_index_close(trace_index*);
+
+/*
+ * load the checkpoint at or below record into sim and store the first
+ * record it has not seen and that record's byte offset; returns 1. Without
+ * a usable checkpoint sim is reset, the start is record itself and 0 is
+ * returned
+ */
+int trace_index_seek(trace_index*,uint64_t,cachesim*,uint64_t*,uint64_t*);
+
+#endif
@@ -0,0 +1,462 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <stdint.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <stdatomic.h>
+
+#include "cachesim.h"
+#include "shards.h"
+
+/********************************* CLI INPUTS **********************************
+ *
+ * tune [options] benchmark accesses
+ *
+ * Searches two-level geometries under the constraints for the cheapest
+ * ones at each miss rate. Every candidate gets a cheap estimate
+ * of its global miss ratio from the fully associative LRU miss-ratio curve
+ * of its L2 line size at its total capacity; candidates run cheapest first
+ * in batches across the threads, and one whose estimate is already worse
+ * than a simulated candidate of no greater cost, or than the target miss
+ * ratio, is skipped. Prints every simulated candidate that meets the
+ * targets as CSV, marking the Pareto front of cost (bytes of capacity)
+ * against the objective.
+ *
+ * --l1-sizes=S,...     L1 sizes in bytes (default 4096 to 65536)
+ * --l1-assocs=A,...    L1 associativities (default 1,2,4,8)
+ * --l2-sizes=S,...     L2 sizes in bytes (default 131072 to 2097152)
+ * --l2-assocs=A,...    L2 associativities (default 4,8,16)
+ * --lines=B,...        line sizes of either level, L2 never below L1
+ *                      (default 32,64,128)
+ * --victims=V,...      victim cache sizes in bytes of either level
+ *                      (default 0)
+ * --max-capacity=C     total bytes of both levels and victim caches
+ * --max-assoc=A        ways of either level
+ * --target-miss=R      report only candidates with a global miss ratio
+ *                      (L2 misses per access) of at most R
+ * --target-amat=T      report only candidates with an AMAT of at most T
+ * --objective=O        miss (default) or amat, the axis of the front
+ * --latencies=H1,H2,M  L1 and L2 hit and memory latency for the AMAT
+ *                      (default 4,12,200)
+ * --rate=R             SHARDS sampling rate of the estimates (default 0.1)
+ * --slack=F            skip a candidate only when its estimate exceeds
+ *                      the miss ratio reached at no greater cost or the
+ *                      target by more than the fraction F (default 0.05);
+ *                      -1 never skips
+ * --jobs=N             simulation threads (default the online CPUs)
+ *
+ * *****************************************************************************
+*/
+
+#define MAX_CHOICES 32
+#define MAX_LINE_SIZES 8
+
+typedef struct
+{
+    unsigned n;
+    unsigned v[MAX_CHOICES];
+}choices;
+
+typedef struct
+{
+    cachesim_config config;
+    uint64_t cost;
+    double estimate;        // global miss ratio the curve predicts
+    double miss;            // simulated global miss ratio
+    double amat;
+    int simulated;
+    int front;
+}candidate;
+
+// shared by the simulation threads
+typedef struct
+{
+    const unsigned char* records;
+    size_t n;
+    candidate** batch;
+    size_t batch_size;
+    atomic_size_t next;
+    double latency[3];
+}tune_work;
+
+void parse_choices(const char*,choices*);
+int shards_index(const unsigned*,unsigned,unsigned);
+
+void
+parse_choices(const char* arg,choices* out)
+{
+    out->n = 0;
+    char* end;
+    for(const char* p = arg;*p && out->n < MAX_CHOICES;p = *end ? end + 1 : end)
+    {
+        unsigned long v = strtoul(p,&end,0);
+        if(end == p || !v || (*end && *end != ','))
+        {
+            printf("Invalid arguments!");
+            exit(0);
+        }
+        out->v[out->n++] = v;
+    }
+    if(!out->n)
+    {
+        printf("Invalid arguments!");
+        exit(0);
+    }
+}
+
+int
+shards_index(const unsigned* line_sizes,unsigned n,unsigned line_size)
+{
+    for(unsigned i = 0;i < n;++i)
+        if(line_sizes[i] == line_size)
+            return i;
+    return -1;
+}
+
+static void*
+simulate_main(void* arg)
+{
+    tune_work* work = arg;
+    size_t i;
+    while((i = atomic_fetch_add(&work->next,1)) < work->batch_size)
+    {
+        candidate* c = work->batch[i];
+        cachesim* sim = cachesim_create(&c->config);
+        if(!sim)
+            continue;
+        cachesim_run_trace(sim,work->records,work->n);
+        cache_stats L1, L2;
+        cachesim_get_stats(sim,0,&L1);
+        cachesim_get_stats(sim,1,&L2);
+        double accesses = cachesim_accesses(sim) ? cachesim_accesses(sim) : 1;
+        double m1 = L1.hits + L1.total_misses ? (double)L1.total_misses/(L1.hits + L1.total_misses) : 0;
+        double m2 = L2.hits + L2.total_misses ? (double)L2.total_misses/(L2.hits + L2.total_misses) : 0;
+        c->miss = L2.total_misses/accesses;
+        c->amat = work->latency[0] + m1*(work->latency[1] + m2*work->latency[2]);
+        c->simulated = 1;
+        cachesim_destroy(sim);
+    }
+    return NULL;
+}
+
+static int
+by_cost(const void* a,const void* b)
+{
+    const candidate* x = a;
+    const candidate* y = b;
+    if(x->cost != y->cost)
+        return x->cost < y->cost ? -1 : 1;
+    return x->estimate < y->estimate ? -1 : x->estimate > y->estimate;
+}
+
+int
+main(int argc, char *argv[])
+{
+    static const struct option long_options[] =
+    {
+        {"l1-sizes", required_argument, NULL, 's'},
+        {"l1-assocs", required_argument, NULL, 'a'},
+        {"l2-sizes", required_argument, NULL, 'S'},
+        {"l2-assocs", required_argument, NULL, 'A'},
+        {"lines", required_argument, NULL, 'l'},
+        {"victims", required_argument, NULL, 'v'},
+        {"max-capacity", required_argument, NULL, 'c'},
+        {"max-assoc", required_argument, NULL, 'w'},
+        {"target-miss", required_argument, NULL, 'm'},
+        {"target-amat", required_argument, NULL, 't'},
+        {"objective", required_argument, NULL, 'o'},
+        {"latencies", required_argument, NULL, 'L'},
+        {"rate", required_argument, NULL, 'r'},
+        {"slack", required_argument, NULL, 'k'},
+        {"jobs", required_argument, NULL, 'j'},
+        {NULL, 0, NULL, 0}
+    };
+    choices l1_sizes = {5, {4096, 8192, 16384, 32768, 65536}};
+    choices l1_assocs = {4, {1, 2, 4, 8}};
+    choices l2_sizes = {5, {131072, 262144, 524288, 1048576, 2097152}};
+    choices l2_assocs = {3, {4, 8, 16}};
+    choices lines = {3, {32, 64, 128}};
+    choices victims = {1, {0}};
+    choices latencies = {3, {4, 12, 200}};
+    uint64_t max_capacity = UINT64_MAX;
+    unsigned max_assoc = ~0u;
+    double target_miss = 1, target_amat = INFINITY;
+    int amat_objective = 0;
+    double rate = 0.1, slack = 0.05;
+    long jobs = sysconf(_SC_NPROCESSORS_ONLN);
+    int opt;
+    while((opt = getopt_long(argc,argv,"",long_options,NULL)) != -1)
+    {
+        switch(opt)
+        {
+            case('s'):
+                parse_choices(optarg,&l1_sizes);
+                break;
+            case('a'):
+                parse_choices(optarg,&l1_assocs);
+                break;
+            case('S'):
+                parse_choices(optarg,&l2_sizes);
+                break;
+            case('A'):
+                parse_choices(optarg,&l2_assocs);
+                break;
+            case('l'):
+                parse_choices(optarg,&lines);
+                break;
+            case('v'):
+                //0 is a valid victim size, so the list is parsed here
+                victims.n = 0;
+                for(char* p = optarg;*p && victims.n < MAX_CHOICES;)
+                {
+                    victims.v[victims.n++] = strtoul(p,&p,0);
+                    if(*p == ',')
+                        ++p;
+                }
+                break;
+            case('c'):
+                max_capacity = strtoull(optarg,NULL,0);
+                break;
+            case('w'):
+                max_assoc = atoi(optarg);
+                break;
+            case('m'):
+                target_miss = atof(optarg);
+                break;
+            case('t'):
+                target_amat = atof(optarg);
+                break;
+            case('o'):
+                if(strcmp(optarg,"miss") && strcmp(optarg,"amat"))
+                {
+                    printf("Invalid arguments!");
+                    exit(0);
+                }
+                amat_objective = !strcmp(optarg,"amat");
+                break;
+            case('L'):
+                parse_choices(optarg,&latencies);
+                break;
+            case('r'):
+                rate = atof(optarg);
+                break;
+            case('k'):
+                slack = atof(optarg);
+                break;
+            case('j'):
+                jobs = atoi(optarg);
+                break;
+            default:
+                printf("Invalid arguments!");
+                exit(0);
+        }
+    }
+    if(argc - optind < 2 || latencies.n != 3 || !victims.n || rate <= 0 || rate > 1)
+    {
+        printf("Invalid arguments!");
+        exit(0);
+    }
+    if(jobs < 1)
+        jobs = 1;
+
+    char benchmark[512];
+    snprintf(benchmark,sizeof(benchmark),"CacheonlyTraces/Traces/%s.trace",argv[optind]);
+    size_t accesses = strtoull(argv[optind + 1],NULL,0);
+
+    //the constraints alone rule out most of the space before any simulation
+    size_t n_candidates = 0, space = 0;
+    candidate* candidates = NULL;
+    uint64_t largest = 0;
+    for(unsigned a = 0;a < l1_sizes.n;++a)
+    for(unsigned b = 0;b < l1_assocs.n;++b)
+    for(unsigned c = 0;c < lines.n;++c)
+    for(unsigned d = 0;d < victims.n;++d)
+    for(unsigned e = 0;e < l2_sizes.n;++e)
+    for(unsigned f = 0;f < l2_assocs.n;++f)
+    for(unsigned g = 0;g < lines.n;++g)
+    for(unsigned h = 0;h < victims.n;++h)
+    {
+        ++space;
+        cachesim_level_config l1 = {l1_sizes.v[a], l1_assocs.v[b], lines.v[c], victims.v[d], CACHESIM_INDEX_BITS};
+        cachesim_level_config l2 = {l2_sizes.v[e], l2_assocs.v[f], lines.v[g], victims.v[h], CACHESIM_INDEX_BITS};
+        uint64_t cost = (uint64_t)l1.size + l2.size + l1.victim_size + l2.victim_size;
+        if(cost > max_capacity || l1.assoc > max_assoc || l2.assoc > max_assoc || l2.line_size < lines.v[c] ||
+           l2.size <= l1.size || l1.size < (uint64_t)l1.assoc*l1.line_size ||
+           l2.size < (uint64_t)l2.assoc*l2.line_size)
+            continue;
+        if(!(n_candidates & (n_candidates - 1)))
+        {
+            candidate* grown = realloc(candidates,(n_candidates ? 2*n_candidates : 1)*sizeof(candidate));
+            if(!grown) { printf("Unable to allocate the candidate list\n"); exit(0); }
+            candidates = grown;
+        }
+        candidate* cand = &candidates[n_candidates++];
+        memset(cand,0,sizeof(*cand));
+        cand->config.n_levels = 2;
+        cand->config.level[0] = l1;
+        cand->config.level[1] = l2;
+        cand->cost = cost;
+        if(cost > largest)
+            largest = cost;
+    }
+    if(!n_candidates)
+    {
+        printf("No configuration satisfies the constraints\n");
+        exit(0);
+    }
+
+    FILE* fin = fopen(benchmark,"rb");
+    if(fin == 0) { printf("Unable to open trace file\n"); exit(0); }
+    unsigned char* records = malloc(accesses*CACHESIM_RECORD_SIZE + 1);
+    if(!records) { printf("Unable to read the trace into memory\n"); exit(0); }
+    size_t n = fread(records,CACHESIM_RECORD_SIZE,accesses,fin);
+    fclose(fin);
+
+    //one curve per line size covers every capacity in a single pass
+    unsigned bucket = 16;
+    shards* curves[MAX_LINE_SIZES];
+    unsigned curve_lines[MAX_LINE_SIZES];
+    unsigned n_curves = 0;
+    for(unsigned i = 0;i < lines.n && n_curves < MAX_LINE_SIZES;++i)
+    {
+        if(shards_index(curve_lines,n_curves,lines.v[i]) >= 0)
+            continue;
+        unsigned buckets = largest/lines.v[i]/bucket + 1;
+        curves[n_curves] = shards_create_fixed_rate(rate,log2(lines.v[i]),bucket,buckets);
+        if(!curves[n_curves])
+        {
+            printf("Invalid sampling parameters\n");
+            exit(0);
+        }
+        curve_lines[n_curves++] = lines.v[i];
+    }
+    for(size_t i = 0;i < n;++i)
+    {
+        uint32_t address;
+        memcpy(&address,records + i*CACHESIM_RECORD_SIZE,4);
+        for(unsigned k = 0;k < n_curves;++k)
+            shards_access(curves[k],address);
+    }
+    double* curve[MAX_LINE_SIZES];
+    size_t curve_size[MAX_LINE_SIZES];
+    for(unsigned k = 0;k < n_curves;++k)
+    {
+        curve_size[k] = largest/curve_lines[k]/bucket + 1;
+        curve[k] = malloc(curve_size[k]*sizeof(double));
+        if(!curve[k]) { printf("Unable to allocate miss ratio curves\n"); exit(0); }
+        shards_mrc(curves[k],curve[k],curve_size[k]);
+        shards_destroy(curves[k]);
+    }
+    for(size_t i = 0;i < n_candidates;++i)
+    {
+        candidate* c = &candidates[i];
+        int k = shards_index(curve_lines,n_curves,c->config.level[1].line_size);
+        size_t at = k < 0 ? 0 : (c->config.level[0].size + c->config.level[1].size)/curve_lines[k]/bucket;
+        //a line size without a curve is never skipped
+        c->estimate = k < 0 ? 0 : (at ? curve[k][(at > curve_size[k] ? curve_size[k] : at) - 1] : 1);
+    }
+    for(unsigned k = 0;k < n_curves;++k)
+        free(curve[k]);
+
+    /*
+     * cheapest first, a batch of jobs candidates at a time; best is the
+     * lowest simulated miss ratio so far, all of it at no greater cost
+     * than anything still waiting
+     */
+    qsort(candidates,n_candidates,sizeof(candidate),by_cost);
+    tune_work work;
+    work.records = records;
+    work.n = n;
+    work.batch = malloc(jobs*sizeof(candidate*));
+    for(unsigned i = 0;i < 3;++i)
+        work.latency[i] = latencies.v[i];
+    pthread_t* threads = malloc(jobs*sizeof(pthread_t));
+    if(!work.batch || !threads) { printf("Unable to allocate simulation jobs\n"); exit(0); }
+    double best = INFINITY;
+    size_t pruned = 0, simulated = 0;
+    for(size_t i = 0;i < n_candidates;)
+    {
+        work.batch_size = 0;
+        for(;i < n_candidates && work.batch_size < jobs;++i)
+        {
+            double bound = best < target_miss ? best : target_miss;
+            if(slack >= 0 && candidates[i].estimate > bound*(1 + slack))
+            {
+                ++pruned;
+                continue;
+            }
+            work.batch[work.batch_size++] = &candidates[i];
+        }
+        atomic_init(&work.next,0);
+        //workers pull candidates from next, so whatever threads did not start this one simulates
+        long started = 1;
+        for(;started < work.batch_size;++started)
+            if(pthread_create(&threads[started],NULL,simulate_main,&work))
+                break;
+        simulate_main(&work);
+        for(long t = 1;t < started;++t)
+            pthread_join(threads[t],NULL);
+        for(size_t b = 0;b < work.batch_size;++b)
+        {
+            if(!work.batch[b]->simulated)
+                continue;
+            ++simulated;
+            if(work.batch[b]->miss < best)
+                best = work.batch[b]->miss;
+        }
+    }
+
+    /*
+     * the front: the best candidate meeting the targets at each cost that
+     * beats every cheaper one; the other metric breaks ties
+     */
+    double front_best = INFINITY;
+    for(size_t i = 0;i < n_candidates;)
+    {
+        size_t j = i;
+        candidate* cost_best = NULL;
+        for(;j < n_candidates && candidates[j].cost == candidates[i].cost;++j)
+        {
+            candidate* c = &candidates[j];
+            if(!c->simulated || c->miss > target_miss || c->amat > target_amat)
+                continue;
+            double value = amat_objective ? c->amat : c->miss;
+            double other = amat_objective ? c->miss : c->amat;
+            if(!cost_best || value < (amat_objective ? cost_best->amat : cost_best->miss) ||
+               (value == (amat_objective ? cost_best->amat : cost_best->miss) &&
+                other < (amat_objective ? cost_best->miss : cost_best->amat)))
+                cost_best = c;
+        }
+        if(cost_best && (amat_objective ? cost_best->amat : cost_best->miss) < front_best)
+        {
+            cost_best->front = 1;
+            front_best = amat_objective ? cost_best->amat : cost_best->miss;
+        }
+        i = j;
+    }
+
+    printf("# %s: %zu accesses, %zu configurations, %zu within the constraints, %zu skipped on the estimate, "
+           "%zu simulated\n",benchmark,n,space,n_candidates,pruned,simulated);
+    printf("cost_bytes,l1_size,l1_assoc,l1_line,l1_victim,l2_size,l2_assoc,l2_line,l2_victim,estimate,miss_ratio,"
+           "amat,pareto\n");
+    for(size_t i = 0;i < n_candidates;++i)
+    {
+        candidate* c = &candidates[i];
+        if(!c->simulated || c->miss > target_miss || c->amat > target_amat)
+            continue;
+        const cachesim_level_config* l1 = &c->config.level[0];
+        const cachesim_level_config* l2 = &c->config.level[1];
+        printf("%llu,%u,%u,%u,%u,%u,%u,%u,%u,%.6f,%.6f,%.3f,%d\n",(unsigned long long)c->cost,l1->size,l1->assoc,
+                l1->line_size,l1->victim_size,l2->size,l2->assoc,l2->line_size,l2->victim_size,c->estimate,c->miss,
+                c->amat,c->front);
+    }
+
+    free(threads);
+    free(work.batch);
+    free(records);
+    free(candidates);
+    return 0;
+}